@@ -1607,6 +1607,182 @@ static void test_reg_unload_key(void)
     DeleteFileA("saved_key.LOG");
 }
 
+static void test_reg_save_key_latest_format(void)
+{
+    static const char data[] = "hive data";
+    char name[16], buffer[32];
+    DWORD ret, i, size, type, subkeys, values;
+    HKEY key, subkey;
+
+    if (!set_privileges(SE_BACKUP_NAME, TRUE) ||
+        !set_privileges(SE_RESTORE_NAME, TRUE))
+    {
+        win_skip("Failed to set SE_BACKUP_NAME and SE_RESTORE_NAME privileges, skipping tests\n");
+        return;
+    }
+
+    ret = RegCreateKeyA(hkey_main, "hive", &key);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ret = RegSetValueExA(key, "string", 0, REG_SZ, (const BYTE *)data, sizeof(data));
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    for (i = 0; i < 32; i++)
+    {
+        sprintf(name, "key%lu", i);
+        ret = RegCreateKeyA(key, name, &subkey);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+        RegCloseKey(subkey);
+    }
+
+    DeleteFileA("saved_hive");
+    ret = RegSaveKeyExA(key, "saved_hive", NULL, REG_LATEST_FORMAT);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    RegCloseKey(key);
+
+    ret = RegLoadKeyA(HKEY_LOCAL_MACHINE, "Test", "saved_hive");
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+
+    ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, "Test", &key);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ret = RegQueryInfoKeyA(key, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ok(subkeys == 32, "got %lu subkeys\n", subkeys);
+    ok(values == 1, "got %lu values\n", values);
+    size = sizeof(buffer);
+    ret = RegQueryValueExA(key, "string", NULL, &type, (BYTE *)buffer, &size);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ok(type == REG_SZ, "got type %lu\n", type);
+    ok(size == sizeof(data) && !strcmp(buffer, data), "got %s size %lu\n", debugstr_a(buffer), size);
+    ret = RegOpenKeyA(key, "key31", &subkey);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    RegCloseKey(subkey);
+    RegCloseKey(key);
+
+    ret = RegUnLoadKeyA(HKEY_LOCAL_MACHINE, "Test");
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+
+    set_privileges(SE_BACKUP_NAME, FALSE);
+    set_privileges(SE_RESTORE_NAME, FALSE);
+
+    DeleteFileA("saved_hive");
+    DeleteFileA("saved_hive.LOG1");
+    DeleteFileA("saved_hive.LOG2");
+}
+
+static void test_reg_load_server_hive(void)
+{
+    char dir[MAX_PATH], path[MAX_PATH], buffer[32];
+    DWORD ret, i, size;
+    HANDLE file;
+    HKEY key;
+
+    /* binary hives are only saved by the Wine server along with its own registry files */
+    if (!GetEnvironmentVariableA("WINECONFIGDIR", dir, sizeof(dir)))
+    {
+        skip("WINECONFIGDIR not set, skipping tests\n");
+        return;
+    }
+    sprintf(path, "%s\\user.reg.bin", dir);
+    if (!CopyFileA(path, "server_hive", FALSE))
+    {
+        skip("no binary hive saved by the server, skipping tests\n");
+        return;
+    }
+    if (!set_privileges(SE_RESTORE_NAME, TRUE))
+    {
+        win_skip("Failed to set SE_RESTORE_NAME privileges, skipping tests\n");
+        goto done;
+    }
+
+    ret = RegLoadKeyA(HKEY_LOCAL_MACHINE, "Test", "server_hive");
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, "Test\\Software", &key);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    if (!ret) RegCloseKey(key);
+    ret = RegUnLoadKeyA(HKEY_LOCAL_MACHINE, "Test");
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+
+    /* corrupt the middle of the file, nothing must be loaded from it */
+    file = CreateFileA("server_hive", GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed, error %lu\n", GetLastError());
+    SetFilePointer(file, GetFileSize(file, NULL) / 2, NULL, FILE_BEGIN);
+    memset(buffer, 0xff, sizeof(buffer));
+    for (i = 0; i < 4; i++) WriteFile(file, buffer, sizeof(buffer), &size, NULL);
+    CloseHandle(file);
+
+    ret = RegLoadKeyA(HKEY_LOCAL_MACHINE, "Test", "server_hive");
+    ok(ret == ERROR_BADDB, "expected ERROR_BADDB, got %ld\n", ret);
+    ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, "Test\\Software", &key);
+    ok(ret == ERROR_FILE_NOT_FOUND, "expected ERROR_FILE_NOT_FOUND, got %ld\n", ret);
+    if (!ret) RegCloseKey(key);
+    RegUnLoadKeyA(HKEY_LOCAL_MACHINE, "Test");
+
+    set_privileges(SE_RESTORE_NAME, FALSE);
+done:
+    DeleteFileA("server_hive");
+}
+
+static void test_reg_load_key_journal(void)
+{
+    static const char data[] = "journal data";
+    char buffer[32];
+    DWORD ret, size, type;
+    HANDLE file;
+    HKEY key;
+
+    if (!set_privileges(SE_BACKUP_NAME, TRUE) ||
+        !set_privileges(SE_RESTORE_NAME, TRUE))
+    {
+        win_skip("Failed to set SE_BACKUP_NAME/SE_RESTORE_NAME privileges, skipping tests\n");
+        return;
+    }
+
+    ret = RegCreateKeyA(hkey_main, "journal", &key);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ret = RegSetValueExA(key, "value", 0, REG_SZ, (const BYTE *)data, sizeof(data));
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ret = RegFlushKey(key);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    DeleteFileA("journal_test.reg");
+    ret = RegSaveKeyA(key, "journal_test.reg", NULL);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    RegCloseKey(key);
+
+    /* a file that happens to be named like a journal is not part of the loaded file */
+    file = CreateFileA("journal_test.reg.log", GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed, error %lu\n", GetLastError());
+    memset(buffer, 0xcc, sizeof(buffer));
+    WriteFile(file, buffer, sizeof(buffer), &size, NULL);
+    CloseHandle(file);
+
+    ret = RegLoadKeyA(HKEY_LOCAL_MACHINE, "Test", "journal_test.reg");
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, "Test", &key);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+    if (!ret)
+    {
+        size = sizeof(buffer);
+        ret = RegQueryValueExA(key, "value", NULL, &type, (BYTE *)buffer, &size);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+        ok(type == REG_SZ, "got type %lu\n", type);
+        ok(size == sizeof(data) && !strcmp(buffer, data), "got %s size %lu\n", debugstr_a(buffer), size);
+        RegCloseKey(key);
+    }
+    ret = RegUnLoadKeyA(HKEY_LOCAL_MACHINE, "Test");
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", ret);
+
+    /* the file is left as it was */
+    file = CreateFileA("journal_test.reg.log", GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed, error %lu\n", GetLastError());
+    ok(GetFileSize(file, NULL) == sizeof(buffer), "got size %lu\n", GetFileSize(file, NULL));
+    CloseHandle(file);
+
+    set_privileges(SE_BACKUP_NAME, FALSE);
+    set_privileges(SE_RESTORE_NAME, FALSE);
+    RegDeleteKeyA(hkey_main, "journal");
+    DeleteFileA("journal_test.reg");
+    DeleteFileA("journal_test.reg.log");
+}
+
 /* Helper function to wait for a file blocked by the registry to be available */
 static void wait_file_available(char *path)
 {
@@ -4541,6 +4717,65 @@ static void test_RegRenameKey(void)
     RegCloseKey(key);
 }
 
+static void test_many_subkeys(void)
+{
+    char name[32], prev[32], buffer[32];
+    DWORD i, len, count, values, dw;
+    HKEY key, subkey;
+    LSTATUS ret;
+
+    ret = RegCreateKeyExA(hkey_main, "ManySubkeys", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL);
+    ok(!ret, "RegCreateKeyExA failed: %ld\n", ret);
+
+    /* create them in reverse order, with mixed case */
+    for (i = 300; i > 0; i--)
+    {
+        sprintf(name, i % 2 ? "Sub%04lu" : "sub%04lu", i);
+        ret = RegCreateKeyExA(key, name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL);
+        ok(!ret, "RegCreateKeyExA %s failed: %ld\n", name, ret);
+        RegCloseKey(subkey);
+        ret = RegSetValueExA(key, name, 0, REG_DWORD, (BYTE *)&i, sizeof(i));
+        ok(!ret, "RegSetValueExA %s failed: %ld\n", name, ret);
+    }
+
+    ret = RegOpenKeyExA(key, "SUB0123", 0, KEY_READ, &subkey);
+    ok(!ret, "RegOpenKeyExA failed: %ld\n", ret);
+    RegCloseKey(subkey);
+    len = sizeof(dw);
+    ret = RegQueryValueExA(key, "SUB0124", NULL, NULL, (BYTE *)&dw, &len);
+    ok(!ret, "RegQueryValueExA failed: %ld\n", ret);
+    ok(dw == 124, "got %lu\n", dw);
+
+    ret = RegRenameKey(key, L"sub0200", L"Sub0000");
+    ok(!ret, "RegRenameKey failed: %ld\n", ret);
+    ret = RegDeleteKeyA(key, "SUB0150");
+    ok(!ret, "RegDeleteKeyA failed: %ld\n", ret);
+    ret = RegDeleteValueA(key, "SUB0150");
+    ok(!ret, "RegDeleteValueA failed: %ld\n", ret);
+
+    ret = RegQueryInfoKeyA(key, NULL, NULL, NULL, &count, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(!ret, "RegQueryInfoKeyA failed: %ld\n", ret);
+    ok(count == 299, "got %lu subkeys\n", count);
+    ok(values == 299, "got %lu values\n", values);
+
+    /* subkeys are enumerated in sorted order */
+    prev[0] = 0;
+    for (i = 0; i < count; i++)
+    {
+        len = sizeof(buffer);
+        ret = RegEnumKeyExA(key, i, buffer, &len, NULL, NULL, NULL, NULL);
+        ok(!ret, "RegEnumKeyExA %lu failed: %ld\n", i, ret);
+        ok(lstrcmpiA(prev, buffer) < 0, "%s enumerated after %s\n", buffer, prev);
+        strcpy(prev, buffer);
+    }
+    len = sizeof(buffer);
+    ret = RegEnumKeyExA(key, 0, buffer, &len, NULL, NULL, NULL, NULL);
+    ok(!ret && !strcmp(buffer, "Sub0000"), "got %ld %s\n", ret, buffer);
+
+    delete_key(key);
+    RegCloseKey(key);
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -4568,6 +4803,9 @@ START_TEST(registry)
     test_reg_save_key();
     test_reg_load_key();
     test_reg_unload_key();
+    test_reg_save_key_latest_format();
+    test_reg_load_server_hive();
+    test_reg_load_key_journal();
     test_reg_load_app_key();
     test_reg_copy_tree();
     test_reg_delete_tree();
@@ -4582,6 +4820,7 @@ START_TEST(registry)
     test_EnumDynamicTimeZoneInformation();
     test_perflib_key();
     test_RegRenameKey();
+    test_many_subkeys();
 
     /* cleanup */
     delete_key( hkey_main );
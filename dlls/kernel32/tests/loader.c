@@ -1585,6 +1585,21 @@ static void test_filenames(void)
         FreeLibrary( mod );
         DeleteFileA( dll_name );
     }
+
+    /* a file created after a failed load must be found */
+    strcpy( dll_name, long_path );
+    strcpy( strrchr( dll_name, '\\' ), "\\this-is-a-new-name.dll" );
+    SetLastError( 0xdeadbeef );
+    mod = LoadLibraryA( dll_name );
+    ok( !mod, "loading succeeded\n" );
+    ok( GetLastError() == ERROR_MOD_NOT_FOUND, "wrong error %lu\n", GetLastError() );
+    ret = CopyFileA( long_path, dll_name, FALSE );
+    ok( ret, "CopyFileA failed err %lu\n", GetLastError() );
+    mod = LoadLibraryA( dll_name );
+    ok( mod != NULL, "loading failed err %lu\n", GetLastError() );
+    FreeLibrary( mod );
+    DeleteFileA( dll_name );
+
     DeleteFileA( long_path );
 }
 
@@ -3972,6 +3987,69 @@ static void test_wow64_redirection(void)
     ok(pWow64RevertWow64FsRedirection(OldValue), "Re-enabling FS redirection failed\n");
 }
 
+static void test_relocated_image( const char *name )
+{
+    HMODULE module = GetModuleHandleA( name );
+    IMAGE_NT_HEADERS *nt;
+    char path[MAX_PATH];
+    HANDLE file, mapping;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+    void *ptr;
+    SIZE_T size;
+
+    GetModuleFileNameA( module, path, MAX_PATH );
+    file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "can't open '%s': %lu\n", path, GetLastError() );
+    mapping = CreateFileMappingA( file, NULL, PAGE_READONLY | SEC_IMAGE, 0, 0, NULL );
+    ok( mapping != NULL, "%s: CreateFileMappingW failed err %lu\n", name, GetLastError() );
+    CloseHandle( file );
+
+    /* the module is already loaded at its preferred base, so the view has to be relocated */
+    ptr = NULL;
+    size = 0;
+    offset.QuadPart = 0;
+    status = pNtMapViewOfSection( mapping, GetCurrentProcess(), &ptr, 0, 0, &offset,
+                                  &size, 1 /* ViewShare */, 0, PAGE_READONLY );
+    ok( status == STATUS_IMAGE_NOT_AT_BASE, "%s: got %lx\n", name, status );
+    ok( ptr != module, "%s: mapped at module address %p\n", name, ptr );
+    nt = pRtlImageNtHeader( ptr );
+    ok( nt != NULL, "%s: invalid header\n", name );
+    ok( nt->OptionalHeader.ImageBase == (ULONG_PTR)ptr, "%s: wrong ImageBase %p / %p\n",
+        name, (void *)nt->OptionalHeader.ImageBase, ptr );
+    ok( pRtlImageNtHeader( module )->OptionalHeader.ImageBase == (ULONG_PTR)module,
+        "%s: loaded module ImageBase changed\n", name );
+
+    pNtUnmapViewOfSection( GetCurrentProcess(), ptr );
+    CloseHandle( mapping );
+}
+
+static void test_export_names( const char *name )
+{
+    HMODULE module = GetModuleHandleA( name );
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *names;
+    const WORD *ordinals;
+    ULONG size;
+    DWORD i;
+
+    exports = pRtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+    ok( exports != NULL, "%s: no exports\n", name );
+    if (!exports) return;
+    names = (const DWORD *)((char *)module + exports->AddressOfNames);
+    ordinals = (const WORD *)((char *)module + exports->AddressOfNameOrdinals);
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        const char *export_name = (char *)module + names[i];
+        FARPROC by_name = GetProcAddress( module, export_name );
+        FARPROC by_ordinal = GetProcAddress( module, MAKEINTRESOURCEA( ordinals[i] + exports->Base ));
+
+        ok( by_name == by_ordinal, "%s: %s got %p / %p\n", name, export_name, by_name, by_ordinal );
+    }
+    ok( !GetProcAddress( module, "NotAnExportedFunction" ), "%s: found bogus name\n", name );
+}
+
 static void test_dll_file( const char *name )
 {
     HMODULE module = GetModuleHandleA( name );
@@ -4207,6 +4285,9 @@ START_TEST(loader)
     test_dll_file( "kernel32.dll" );
     test_dll_file( "advapi32.dll" );
     test_dll_file( "user32.dll" );
+    test_relocated_image( "kernel32.dll" );
+    test_export_names( "kernel32.dll" );
+    test_export_names( "ntdll.dll" );
     test_Wow64Transition();
     /* loader test must be last, it can corrupt the internal loader state on Windows */
     test_Loader();
@@ -94,6 +94,7 @@ C_ASSERT( sizeof(struct block) == 8 );
 #define BLOCK_FLAG_PREV_FREE   0x02
 #define BLOCK_FLAG_FREE_LINK   0x03
 #define BLOCK_FLAG_LARGE       0x04
+#define BLOCK_FLAG_LFH         0x08 /* block is handled by the LFH frontend */
 #define BLOCK_FLAG_USER_INFO   0x10 /* user flags up to 0xf0 */
 #define BLOCK_FLAG_USER_MASK   0xf0
 
@@ -168,6 +169,51 @@ static const SIZE_T free_list_sizes[] =
 };
 #define HEAP_NB_FREE_LISTS (ARRAY_SIZE(free_list_sizes) + HEAP_NB_SMALL_FREE_LISTS)
 
+/* LFH block size bins: 16 bins of 0x10 bytes up to 0x100, then 16 bins for every power of two */
+#define BIN_COUNT_PER_TIER     16
+#define BIN_SIZE_STEP_0        0x10
+#define BIN_SIZE_STEP( tier )  (BIN_SIZE_STEP_0 << ((tier) ? (tier) - 1 : 0))
+#define BIN_SIZE_MIN( tier )   ((tier) ? BIN_COUNT_PER_TIER * BIN_SIZE_STEP( tier ) : 0)
+#define BIN_MAX_TIER           4
+
+/* largest block size handled by the LFH frontend */
+#define BIN_MAX_BLOCK_SIZE     (BIN_SIZE_MIN( BIN_MAX_TIER ) + BIN_COUNT_PER_TIER * BIN_SIZE_STEP( BIN_MAX_TIER ))
+#define BIN_COUNT              ((BIN_MAX_TIER + 1) * BIN_COUNT_PER_TIER)
+
+C_ASSERT( BIN_MAX_BLOCK_SIZE == 0x1000 );
+/* bin granularity and all possible block overhead must fit into block tail_size */
+C_ASSERT( BIN_SIZE_STEP( BIN_MAX_TIER ) + 4 * BLOCK_ALIGN <= FIELD_MAX( struct block, tail_size ) );
+
+/* number of per-thread affinity slots for each bin */
+#define HEAP_AFFINITY_COUNT    32
+
+/* a group of equally sized LFH blocks, allocated as a single block from the heap */
+struct group
+{
+    SLIST_ENTRY entry;      /* entry in the bin free groups list */
+    LONG        free_bits;  /* bitmap of free blocks, GROUP_FLAG_FREE if the group is full and detached */
+};
+
+#define GROUP_FLAG_FREE        0x80000000
+#define GROUP_MAX_BLOCK_COUNT  31
+#define GROUP_TARGET_SIZE      0x10000
+/* blocks are laid out after the group header, with the same data alignment as heap blocks */
+#define GROUP_BLOCKS_OFFSET    (ROUND_SIZE( sizeof(struct group) + sizeof(struct block), BLOCK_ALIGN - 1 ) - sizeof(struct block))
+
+C_ASSERT( GROUP_MAX_BLOCK_COUNT < sizeof(((struct group *)0)->free_bits) * 8 );
+
+/* a bin, tracking LFH blocks of a given size */
+struct bin
+{
+    SLIST_HEADER groups;    /* groups with free blocks, not owned by any thread */
+    LONG count_alloc;       /* counters for LFH activation */
+    LONG count_freed;
+    LONG enabled;
+};
+
+#define HEAP_STD  0
+#define HEAP_LFH  2
+
 typedef struct DECLSPEC_ALIGN(BLOCK_ALIGN) tagSUBHEAP
 {
     SIZE_T __pad[sizeof(SIZE_T) / sizeof(DWORD)];
@@ -202,6 +248,9 @@ struct heap
     DWORD            magic;         /* Magic number */
     DWORD            pending_pos;   /* Position in pending free requests ring */
     struct block   **pending_free;  /* Ring buffer for pending free requests */
+    LONG             compat_info;   /* HeapCompatibilityInformation value */
+    struct bin      *bins;          /* LFH bins, NULL if LFH isn't supported by the heap */
+    struct group   **affinity_groups; /* LFH groups reserved for each thread affinity and bin */
     RTL_CRITICAL_SECTION cs;
     struct entry     free_lists[HEAP_NB_FREE_LISTS];
     SUBHEAP          subheap;
@@ -229,6 +278,8 @@ C_ASSERT( offsetof(struct heap, subheap) <= REGION_ALIGN - 1 );
 
 static struct heap *process_heap;  /* main process heap */
 
+static LONG next_thread_affinity;
+
 /* check if memory range a contains memory range b */
 static inline BOOL contains( const void *a, SIZE_T a_size, const void *b, SIZE_T b_size )
 {
@@ -294,6 +345,39 @@ static inline void block_set_flags( struct block *block, BYTE clear, BYTE set )
     block_set_size( block, block_size );
 }
 
+static inline struct group *block_get_group( const struct block *block )
+{
+    const char *blocks = (char *)block - block->base_offset * block_get_size( block );
+    return (struct group *)(blocks - GROUP_BLOCKS_OFFSET);
+}
+
+static inline struct block *group_get_block( const struct group *group, SIZE_T block_size, UINT index )
+{
+    return (struct block *)((char *)group + GROUP_BLOCKS_OFFSET + index * block_size);
+}
+
+static inline UINT group_block_count( SIZE_T block_size )
+{
+    return min( GROUP_MAX_BLOCK_COUNT, max( 4, GROUP_TARGET_SIZE / block_size ) );
+}
+
+/* return the bin index of a block size, which must not be larger than BIN_MAX_BLOCK_SIZE */
+static inline UINT block_size_bin( SIZE_T block_size )
+{
+    SIZE_T size = block_size - 1;
+    UINT tier = 0;
+
+    while (tier < BIN_MAX_TIER && size >= BIN_SIZE_MIN( tier + 1 )) tier++;
+    return tier * BIN_COUNT_PER_TIER + (size - BIN_SIZE_MIN( tier )) / BIN_SIZE_STEP( tier );
+}
+
+/* return the block size of the blocks of a bin */
+static inline SIZE_T bin_block_size( UINT bin )
+{
+    UINT tier = bin / BIN_COUNT_PER_TIER;
+    return BIN_SIZE_MIN( tier ) + (bin % BIN_COUNT_PER_TIER + 1) * BIN_SIZE_STEP( tier );
+}
+
 static inline void *subheap_base( const SUBHEAP *subheap )
 {
     return ROUND_ADDR( subheap, REGION_ALIGN - 1 );
@@ -1122,11 +1206,45 @@ static BOOL validate_used_block( const struct heap *heap, const SUBHEAP *subheap
 }
 
 
+static BOOL validate_lfh_block( const struct heap *heap, const SUBHEAP *subheap, const struct block *block )
+{
+    const struct block *group_block = (struct block *)block_get_group( block ) - 1;
+    SIZE_T block_size = block_get_size( block );
+    const char *err = NULL;
+
+    if ((ULONG_PTR)(block + 1) % BLOCK_ALIGN)
+        err = "invalid block BLOCK_ALIGN";
+    else if (!heap->bins || block_size > BIN_MAX_BLOCK_SIZE || block_size != bin_block_size( block_size_bin( block_size ) ))
+        err = "invalid block size";
+    else if (block->base_offset >= group_block_count( block_size ))
+        err = "invalid block index";
+    else if (block_get_type( block ) != BLOCK_TYPE_USED || (block_get_flags( block ) & BLOCK_FLAG_FREE))
+        err = "invalid block header";
+    else if (block->tail_size > block_size - sizeof(*block))
+        err = "invalid block unused size";
+    else if (!validate_used_block( heap, subheap, group_block ))
+        err = "invalid group block";
+    else if (!contains( group_block, block_get_size( group_block ), block, block_size ))
+        err = "invalid group block size";
+
+    if (err)
+    {
+        ERR( "heap %p, block %p: %s\n", heap, block, err );
+        if (TRACE_ON(heap)) heap_dump( heap );
+    }
+
+    return !err;
+}
+
 static BOOL heap_validate_ptr( const struct heap *heap, const void *ptr )
 {
     const struct block *block = (struct block *)ptr - 1;
     const SUBHEAP *subheap;
 
+    if ((block_get_flags( block ) & BLOCK_FLAG_LFH) &&
+        (subheap = find_subheap( heap, (struct block *)block_get_group( block ) - 1, FALSE )))
+        return validate_lfh_block( heap, subheap, block );
+
     if (!(subheap = find_subheap( heap, block, FALSE )))
     {
         if (!find_large_block( heap, block ))
@@ -1191,6 +1309,23 @@ static inline struct block *unsafe_block_from_ptr( struct heap *heap, ULONG flag
 
     if ((ULONG_PTR)ptr % BLOCK_ALIGN)
         err = "invalid ptr alignment";
+    else if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+    {
+        /* LFH blocks base offset is their index in their group, check the group block instead */
+        const struct block *group_block = (struct block *)block_get_group( block ) - 1;
+
+        if (block_get_type( block ) == BLOCK_TYPE_FREE)
+            err = "already freed block";
+        else if (block_get_type( block ) != BLOCK_TYPE_USED)
+            err = "invalid block type";
+        else if (!heap->bins || block_get_size( block ) > BIN_MAX_BLOCK_SIZE)
+            err = "invalid LFH block";
+        else if (block_get_type( group_block ) != BLOCK_TYPE_USED ||
+                 (subheap = block_get_subheap( heap, group_block )) >= (SUBHEAP *)group_block)
+            err = "invalid LFH group";
+        else if (subheap->user_value != heap)
+            err = "mismatching heap";
+    }
     else if ((subheap = block_get_subheap( heap, block )) >= (SUBHEAP *)block)
         err = "invalid base offset";
     else if (block_get_type( block ) == BLOCK_TYPE_USED)
@@ -1386,6 +1521,21 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, void *addr, SIZE_T total_size, SIZE_T
 
     heap_set_debug_flags( heap );
 
+    if ((heap->flags & HEAP_GROWABLE) && !(heap->flags & HEAP_NO_SERIALIZE) && !heap->pending_free &&
+        !(heap->flags & (HEAP_VALIDATE | HEAP_VALIDATE_ALL | HEAP_VALIDATE_PARAMS | HEAP_CHECKING_ENABLED |
+                         HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED | HEAP_PAGE_ALLOCS)))
+    {
+        SIZE_T size = BIN_COUNT * sizeof(*heap->bins) + HEAP_AFFINITY_COUNT * BIN_COUNT * sizeof(*heap->affinity_groups);
+        void *bins = NULL;
+
+        if (!NtAllocateVirtualMemory( NtCurrentProcess(), &bins, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+        {
+            heap->bins = bins;
+            heap->affinity_groups = (struct group **)(heap->bins + BIN_COUNT);
+            for (i = 0; i < BIN_COUNT; i++) RtlInitializeSListHead( &heap->bins[i].groups );
+        }
+    }
+
     /* link it into the per-process heap list */
     if (process_heap)
     {
@@ -1454,6 +1604,13 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE handle )
     heap->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &heap->cs );
 
+    if (heap->bins)
+    {
+        size = 0;
+        addr = heap->bins;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
+
     LIST_FOR_EACH_ENTRY_SAFE( arena, arena_next, &heap->large_list, ARENA_LARGE, entry )
     {
         list_remove( &arena->entry );
@@ -1528,6 +1685,199 @@ static NTSTATUS heap_allocate_block( struct heap *heap, ULONG flags, SIZE_T bloc
     return STATUS_SUCCESS;
 }
 
+static inline UINT heap_current_thread_affinity(void)
+{
+    ULONG affinity;
+
+    if (!(affinity = NtCurrentTeb()->HeapVirtualAffinity))
+    {
+        affinity = InterlockedIncrement( &next_thread_affinity ) % HEAP_AFFINITY_COUNT + 1;
+        NtCurrentTeb()->HeapVirtualAffinity = affinity;
+    }
+
+    return affinity - 1;
+}
+
+/* affinity groups of the same thread are kept together, to avoid sharing cache lines between threads */
+static inline struct group **heap_get_affinity_group( const struct heap *heap, const struct bin *bin, UINT affinity )
+{
+    return heap->affinity_groups + affinity * BIN_COUNT + (bin - heap->bins);
+}
+
+/* allocate a new group from the heap, with all its blocks free */
+static struct group *heap_allocate_group( struct heap *heap, ULONG flags, SIZE_T block_size )
+{
+    UINT i, count = group_block_count( block_size );
+    SIZE_T group_size = GROUP_BLOCKS_OFFSET + count * block_size;
+    struct group *group;
+    struct block *block;
+    NTSTATUS status;
+
+    flags &= ~(HEAP_ZERO_MEMORY | HEAP_USER_FLAGS_MASK);
+
+    heap_lock( heap, flags );
+    status = heap_allocate_block( heap, flags, heap_get_block_size( heap, flags, group_size ),
+                                  group_size, (void **)&group );
+    heap_unlock( heap, flags );
+    if (status) return NULL;
+
+    for (i = 0; i < count; i++)
+    {
+        block = group_get_block( group, block_size, i );
+        block_set_type( block, BLOCK_TYPE_FREE );
+        block_set_flags( block, ~0, BLOCK_FLAG_LFH | BLOCK_FLAG_FREE );
+        block_set_size( block, block_size );
+        block->base_offset = i;
+        mark_block_free( block + 1, block_size - sizeof(*block), flags );
+    }
+
+    group->free_bits = (1u << count) - 1;
+    return group;
+}
+
+/* find a group with free blocks for the current thread, which becomes its exclusive owner */
+static struct group *heap_acquire_bin_group( struct heap *heap, ULONG flags, struct bin *bin, SIZE_T block_size )
+{
+    struct group *group;
+    SLIST_ENTRY *entry;
+    UINT i;
+
+    if ((entry = RtlInterlockedPopEntrySList( &bin->groups )))
+        return CONTAINING_RECORD( entry, struct group, entry );
+
+    /* take over a group reserved by another thread before growing the heap */
+    for (i = 0; i < HEAP_AFFINITY_COUNT; i++)
+    {
+        struct group **slot = heap_get_affinity_group( heap, bin, i );
+        if (*slot && (group = InterlockedExchangePointer( (void **)slot, NULL )))
+            return group;
+    }
+
+    return heap_allocate_group( heap, flags, block_size );
+}
+
+/* give an owned group back, keeping it reserved for the current thread affinity */
+static void heap_release_bin_group( struct heap *heap, struct bin *bin, struct group **slot, struct group *group )
+{
+    if ((group = InterlockedExchangePointer( (void **)slot, group )))
+        RtlInterlockedPushEntrySList( &bin->groups, &group->entry );
+}
+
+static struct block *find_free_bin_block( struct heap *heap, ULONG flags, struct bin *bin, SIZE_T block_size )
+{
+    struct group **slot = heap_get_affinity_group( heap, bin, heap_current_thread_affinity() );
+    struct group *group;
+    LONG bits, prev;
+    DWORD index;
+
+    if (!(group = InterlockedExchangePointer( (void **)slot, NULL )) &&
+        !(group = heap_acquire_bin_group( heap, flags, bin, block_size )))
+        return NULL;
+
+    /* we own the group now: other threads may only set free bits, when freeing blocks */
+    for (;;)
+    {
+        if (!(bits = ReadNoFence( &group->free_bits )))
+        {
+            /* the group is full, detach it so that the next freed block puts it back in the bin */
+            if (InterlockedCompareExchange( &group->free_bits, GROUP_FLAG_FREE, 0 )) continue;
+            if (!(group = heap_acquire_bin_group( heap, flags, bin, block_size ))) return NULL;
+            continue;
+        }
+
+        BitScanForward( &index, bits );
+        prev = InterlockedCompareExchange( &group->free_bits, bits & ~(1u << index), bits );
+        if (prev == bits) break;
+    }
+
+    heap_release_bin_group( heap, bin, slot, group );
+    return group_get_block( group, block_size, index );
+}
+
+static NTSTATUS heap_allocate_block_lfh( struct heap *heap, ULONG flags, SIZE_T block_size,
+                                         SIZE_T size, void **ret )
+{
+    struct block *block;
+    struct bin *bin;
+
+    if (!heap->bins || block_size > BIN_MAX_BLOCK_SIZE) return STATUS_UNSUCCESSFUL;
+    bin = heap->bins + block_size_bin( block_size );
+    if (!ReadNoFence( &bin->enabled )) return STATUS_UNSUCCESSFUL;
+
+    /* blocks are allocated with the size of their bin */
+    block_size = bin_block_size( bin - heap->bins );
+    if (!(block = find_free_bin_block( heap, flags, bin, block_size ))) return STATUS_NO_MEMORY;
+
+    block_set_type( block, BLOCK_TYPE_USED );
+    block_set_flags( block, ~BLOCK_FLAG_LFH, BLOCK_USER_FLAGS( flags ) );
+    block->tail_size = block_size - sizeof(*block) - size;
+    initialize_block( block, 0, size, flags );
+    mark_block_tail( block, flags );
+
+    *ret = block + 1;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS heap_free_block_lfh( struct heap *heap, ULONG flags, struct block *block )
+{
+    struct group *group = block_get_group( block );
+    SIZE_T block_size = block_get_size( block );
+    struct bin *bin = heap->bins + block_size_bin( block_size );
+    LONG bits, prev;
+
+    block_set_type( block, BLOCK_TYPE_FREE );
+    block_set_flags( block, ~BLOCK_FLAG_LFH, BLOCK_FLAG_FREE );
+    mark_block_free( block + 1, block_size - sizeof(*block), flags );
+
+    /* serialize with find_free_bin_block: if the group was detached, we are responsible for putting it back */
+    do
+    {
+        prev = ReadNoFence( &group->free_bits );
+        bits = (prev | (1u << block->base_offset)) & ~GROUP_FLAG_FREE;
+    }
+    while (InterlockedCompareExchange( &group->free_bits, bits, prev ) != prev);
+
+    if (prev & GROUP_FLAG_FREE) RtlInterlockedPushEntrySList( &bin->groups, &group->entry );
+    return STATUS_SUCCESS;
+}
+
+/* enable LFH for a bin once its allocation pattern makes it worthwhile */
+static void bin_try_enable( struct heap *heap, struct bin *bin )
+{
+    ULONG alloc = ReadNoFence( &bin->count_alloc ), freed = ReadNoFence( &bin->count_freed );
+    SIZE_T block_size = bin_block_size( bin - heap->bins );
+    BOOL enable = FALSE;
+
+    if (bin - heap->bins < 0x30 && alloc > 0x800) enable = TRUE;
+    else if (bin - heap->bins < 0x30 && alloc - freed > 0x10) enable = TRUE;
+    else if (alloc - freed > 0x400000 / block_size) enable = TRUE;
+    if (!enable) return;
+
+    if (ReadNoFence( &heap->compat_info ) != HEAP_LFH)
+    {
+        ULONG info = HEAP_LFH;
+        RtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    }
+
+    WriteNoFence( &bin->enabled, TRUE );
+}
+
+static void heap_update_bin_counts( struct heap *heap, const struct block *block, BOOL freed )
+{
+    SIZE_T block_size = block_get_size( block );
+    struct bin *bin;
+
+    if (!heap->bins || block_size > BIN_MAX_BLOCK_SIZE) return;
+    bin = heap->bins + block_size_bin( block_size );
+
+    if (freed) InterlockedIncrement( &bin->count_freed );
+    else
+    {
+        InterlockedIncrement( &bin->count_alloc );
+        if (!ReadNoFence( &bin->enabled )) bin_try_enable( heap, bin );
+    }
+}
+
 /***********************************************************************
  *           RtlAllocateHeap   (NTDLL.@)
  */
@@ -1545,10 +1895,13 @@ void *WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE handle, ULONG flags, SIZE
         status = STATUS_NO_MEMORY;
     else if (block_size >= HEAP_MIN_LARGE_BLOCK_SIZE)
         status = heap_allocate_large( heap, heap_flags, block_size, size, &ptr );
+    else if (!heap_allocate_block_lfh( heap, heap_flags, block_size, size, &ptr ))
+        status = STATUS_SUCCESS;
     else
     {
         heap_lock( heap, heap_flags );
         status = heap_allocate_block( heap, heap_flags, block_size, size, &ptr );
+        if (!status) heap_update_bin_counts( heap, (struct block *)ptr - 1, FALSE );
         heap_unlock( heap, heap_flags );
     }
 
@@ -1580,11 +1933,14 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE handle, ULONG flags, void *
         status = STATUS_INVALID_PARAMETER;
     else if (block_get_flags( block ) & BLOCK_FLAG_LARGE)
         status = heap_free_large( heap, heap_flags, block );
+    else if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+        status = heap_free_block_lfh( heap, heap_flags, block );
     else if (!(block = heap_delay_free( heap, heap_flags, block )))
         status = STATUS_SUCCESS;
     else
     {
         heap_lock( heap, heap_flags );
+        heap_update_bin_counts( heap, block, TRUE );
         status = heap_free_block( heap, heap_flags, block );
         heap_unlock( heap, heap_flags );
     }
@@ -1628,6 +1984,22 @@ static NTSTATUS heap_resize_block( struct heap *heap, ULONG flags, struct block
 
     if (block_size >= HEAP_MIN_LARGE_BLOCK_SIZE) return STATUS_NO_MEMORY;  /* growing small block to large block */
 
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+    {
+        /* LFH blocks can only be resized within their bin */
+        if (block_size > old_block_size) return STATUS_NO_MEMORY;
+        if (block_size_bin( block_size ) != block_size_bin( old_block_size )) return STATUS_NO_MEMORY;
+
+        valgrind_notify_resize( block + 1, *old_size, size );
+        block_set_flags( block, BLOCK_FLAG_USER_MASK & ~BLOCK_FLAG_USER_INFO, BLOCK_USER_FLAGS( flags ) );
+        block->tail_size = old_block_size - sizeof(*block) - size;
+        initialize_block( block, *old_size, size, flags );
+        mark_block_tail( block, flags );
+
+        *ret = block + 1;
+        return STATUS_SUCCESS;
+    }
+
     heap_lock( heap, flags );
 
     if (block_size > old_block_size)
@@ -2006,15 +2378,18 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class,
                                          void *info, SIZE_T size_in, PSIZE_T size_out )
 {
+    struct heap *heap;
+    ULONG flags;
+
+    TRACE( "handle %p, info_class %u, info %p, size_in %Iu, size_out %p.\n", handle, info_class, info, size_in, size_out );
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
+        if (!(heap = unsafe_heap_from_handle( handle, 0, &flags ))) return STATUS_ACCESS_VIOLATION;
         if (size_out) *size_out = sizeof(ULONG);
-
-        if (size_in < sizeof(ULONG))
-            return STATUS_BUFFER_TOO_SMALL;
-
-        *(ULONG *)info = 0; /* standard heap */
+        if (size_in < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        *(ULONG *)info = ReadNoFence( &heap->compat_info );
         return STATUS_SUCCESS;
 
     default:
@@ -2028,8 +2403,41 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS i
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class, void *info, SIZE_T size )
 {
-    FIXME( "handle %p, info_class %d, info %p, size %Id stub!\n", handle, info_class, info, size );
-    return STATUS_SUCCESS;
+    struct heap *heap;
+    ULONG flags;
+
+    TRACE( "handle %p, info_class %u, info %p, size %Iu.\n", handle, info_class, info, size );
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+    {
+        ULONG compat_info;
+
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heap = unsafe_heap_from_handle( handle, 0, &flags ))) return STATUS_INVALID_HANDLE;
+        if (heap->flags & HEAP_NO_SERIALIZE) return STATUS_INVALID_PARAMETER;
+
+        compat_info = *(ULONG *)info;
+        if (compat_info != HEAP_STD && compat_info != HEAP_LFH)
+        {
+            FIXME( "HeapCompatibilityInformation %lu not implemented!\n", compat_info );
+            return STATUS_UNSUCCESSFUL;
+        }
+        if (compat_info == HEAP_LFH && !heap->bins)
+        {
+            WARN( "LFH is not supported on heap %p with flags %#lx\n", heap, heap->flags );
+            return STATUS_UNSUCCESSFUL;
+        }
+        if (InterlockedCompareExchange( &heap->compat_info, compat_info, HEAP_STD ) != HEAP_STD)
+            return STATUS_UNSUCCESSFUL;
+        return STATUS_SUCCESS;
+    }
+
+    default:
+        FIXME( "handle %p, info_class %d, info %p, size %Id stub!\n", handle, info_class, info, size );
+        return STATUS_SUCCESS;
+    }
 }
 
 /***********************************************************************
@@ -144,8 +144,14 @@ typedef struct _wine_modref
     struct file_id        id;
     ULONG                 CheckSum;
     BOOL                  system;
+    DWORD                 export_hash_size;  /* size of the export name hash table, a power of 2 */
+    DWORD                *export_hash;       /* export name indices hashed by name, or -1 */
 } WINE_MODREF;
 
+/* modules with fewer names than this are searched directly */
+#define EXPORT_HASH_MIN_NAMES 16
+#define EXPORT_HASH_MAX_NAMES 0x100000  /* larger tables are left to the binary search */
+
 static UINT tls_module_count;      /* number of modules with TLS directory */
 static IMAGE_TLS_DIRECTORY *tls_dirs;  /* array of TLS directories */
 LIST_ENTRY tls_links = { &tls_links, &tls_links };
@@ -1015,6 +1021,77 @@ static int find_name_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *e
 }
 
 
+/*************************************************************************
+ *		hash_export_name
+ */
+static DWORD hash_export_name( const char *name )
+{
+    DWORD hash = 2166136261u;
+
+    while (*name) hash = (hash ^ (unsigned char)*name++) * 16777619;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		build_export_hash
+ *
+ * Build the export name hash table of a module.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL build_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( wm->ldr.DllBase, exports->AddressOfNames );
+    DWORD i, pos, size = 2 * EXPORT_HASH_MIN_NAMES;
+
+    if (exports->NumberOfNames > EXPORT_HASH_MAX_NAMES) return FALSE;
+    while (size < 2 * exports->NumberOfNames) size *= 2;
+    if (!(wm->export_hash = RtlAllocateHeap( GetProcessHeap(), 0, size * sizeof(*wm->export_hash) )))
+        return FALSE;
+    memset( wm->export_hash, 0xff, size * sizeof(*wm->export_hash) );
+    wm->export_hash_size = size;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( wm->ldr.DllBase, names[i] )) & (size - 1);
+        while (wm->export_hash[pos] != ~0u) pos = (pos + 1) & (size - 1);
+        wm->export_hash[pos] = i;
+    }
+    TRACE( "%s: hashed %lu names in %lu buckets\n", debugstr_w(wm->ldr.BaseDllName.Buffer),
+           exports->NumberOfNames, size );
+    return TRUE;
+}
+
+
+/*************************************************************************
+ *		find_name_in_export_hash
+ *
+ * Helper for find_named_export. Falls back to a binary search for small export tables.
+ * The loader_section must be locked while calling this function.
+ */
+static int find_name_in_export_hash( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports, const char *name )
+{
+    const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
+    const DWORD *names = get_rva( module, exports->AddressOfNames );
+    WINE_MODREF *wm;
+    DWORD pos;
+
+    if (exports->NumberOfNames < EXPORT_HASH_MIN_NAMES || !(wm = get_modref( module )))
+        return find_name_in_exports( module, exports, name );
+    if (!wm->export_hash && !build_export_hash( wm, exports ))
+        return find_name_in_exports( module, exports, name );
+
+    pos = hash_export_name( name ) & (wm->export_hash_size - 1);
+    while (wm->export_hash[pos] != ~0u)
+    {
+        if (!strcmp( get_rva( module, names[wm->export_hash[pos]] ), name ))
+            return ordinals[wm->export_hash[pos]];
+        pos = (pos + 1) & (wm->export_hash_size - 1);
+    }
+    return -1;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
@@ -1036,8 +1113,8 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
-    if ((ordinal = find_name_in_exports( module, exports, name )) == -1) return NULL;
+    /* then look it up in the hash table */
+    if ((ordinal = find_name_in_export_hash( module, exports, name )) == -1) return NULL;
     return find_ordinal_export( module, exports, exp_size, ordinal, load_path );
 
 }
@@ -2635,6 +2712,159 @@ static NTSTATUS get_dll_load_path_search_flags( LPCWSTR module, DWORD flags, WCH
 }
 
 
+/* cache of dll file names known not to exist, validated against the directory write time */
+struct missing_dll_dir
+{
+    struct list   entry;
+    LARGE_INTEGER write_time;     /* directory write time when the names were cached */
+    ULONG         serial;         /* search serial at which the write time was last checked */
+    unsigned int  count;          /* number of missing names in this directory */
+    USHORT        len;            /* length of the directory name in chars, including the backslash */
+    WCHAR         name[1];
+};
+
+struct missing_dll_file
+{
+    struct list             entry;
+    struct missing_dll_dir *dir;
+    ULONG                   hash;
+    USHORT                  len;  /* length of the full name in chars */
+    WCHAR                   name[1];
+};
+
+#define MISSING_DLL_HASH_SIZE 64
+#define MISSING_DLL_MAX_FILES 4096
+#define MISSING_DLL_MIN_AGE   (2 * (ULONGLONG)10000000)  /* 2 seconds, covers coarse file system timestamps */
+static struct list missing_dll_dirs = LIST_INIT( missing_dll_dirs );
+static struct list missing_dll_files[MISSING_DLL_HASH_SIZE];
+static unsigned int missing_dll_count;
+static ULONG dll_search_serial;
+
+static ULONG hash_dll_file_name( const UNICODE_STRING *nt_name )
+{
+    ULONG i, hash = 0;
+
+    for (i = 0; i < nt_name->Length / sizeof(WCHAR); i++) hash = hash * 65599 + towupper( nt_name->Buffer[i] );
+    return hash;
+}
+
+static BOOL get_dll_dir_write_time( const WCHAR *name, USHORT len, LARGE_INTEGER *time )
+{
+    FILE_BASIC_INFORMATION info;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+
+    str.Buffer = (WCHAR *)name;
+    str.Length = str.MaximumLength = (len - 1) * sizeof(WCHAR);  /* without the trailing backslash */
+    InitializeObjectAttributes( &attr, &str, OBJ_CASE_INSENSITIVE, 0, NULL );
+    if (NtQueryAttributesFile( &attr, &info )) return FALSE;
+    *time = info.LastWriteTime;
+    return TRUE;
+}
+
+static void free_missing_dll_dir( struct missing_dll_dir *dir )
+{
+    struct missing_dll_file *file, *next;
+    unsigned int i;
+
+    for (i = 0; i < MISSING_DLL_HASH_SIZE && dir->count; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( file, next, &missing_dll_files[i], struct missing_dll_file, entry )
+        {
+            if (file->dir != dir) continue;
+            list_remove( &file->entry );
+            RtlFreeHeap( GetProcessHeap(), 0, file );
+            missing_dll_count--;
+            dir->count--;
+        }
+    }
+    list_remove( &dir->entry );
+    RtlFreeHeap( GetProcessHeap(), 0, dir );
+}
+
+/***********************************************************************
+ *	is_missing_dll_file
+ *
+ * Check if a dll file is known not to exist. Helper for open_dll_file.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL is_missing_dll_file( const UNICODE_STRING *nt_name )
+{
+    ULONG hash = hash_dll_file_name( nt_name );
+    struct missing_dll_file *file;
+    struct missing_dll_dir *dir;
+    LARGE_INTEGER time;
+
+    LIST_FOR_EACH_ENTRY( file, &missing_dll_files[hash % MISSING_DLL_HASH_SIZE], struct missing_dll_file, entry )
+    {
+        if (file->hash != hash || file->len != nt_name->Length / sizeof(WCHAR)) continue;
+        if (wcsnicmp( file->name, nt_name->Buffer, file->len )) continue;
+
+        dir = file->dir;
+        if (dir->serial == dll_search_serial) return TRUE;
+        if (get_dll_dir_write_time( dir->name, dir->len, &time ) && time.QuadPart == dir->write_time.QuadPart)
+        {
+            dir->serial = dll_search_serial;
+            return TRUE;
+        }
+        TRACE( "%s changed, flushing cached names\n", debugstr_wn( dir->name, dir->len ));
+        free_missing_dll_dir( dir );
+        return FALSE;
+    }
+    return FALSE;
+}
+
+/***********************************************************************
+ *	add_missing_dll_file
+ *
+ * Remember that a dll file doesn't exist. Helper for open_dll_file.
+ * The loader_section must be locked while calling this function.
+ */
+static void add_missing_dll_file( const UNICODE_STRING *nt_name )
+{
+    USHORT dir_len, len = nt_name->Length / sizeof(WCHAR);
+    struct missing_dll_file *file;
+    struct missing_dll_dir *dir;
+    LARGE_INTEGER time, now;
+    ULONG hash;
+
+    if (missing_dll_count >= MISSING_DLL_MAX_FILES) return;
+    for (dir_len = len; dir_len; dir_len--) if (nt_name->Buffer[dir_len - 1] == '\\') break;
+    if (dir_len < 2) return;
+
+    LIST_FOR_EACH_ENTRY( dir, &missing_dll_dirs, struct missing_dll_dir, entry )
+    {
+        if (dir->len == dir_len && !wcsnicmp( dir->name, nt_name->Buffer, dir_len )) break;
+    }
+    if (&dir->entry == &missing_dll_dirs)
+    {
+        if (!get_dll_dir_write_time( nt_name->Buffer, dir_len, &time )) return;
+        /* a file created within the timestamp granularity may not change the write time */
+        NtQuerySystemTime( &now );
+        if (now.QuadPart - time.QuadPart < MISSING_DLL_MIN_AGE) return;
+        if (!(dir = RtlAllocateHeap( GetProcessHeap(), 0, offsetof( struct missing_dll_dir, name[dir_len] ))))
+            return;
+        dir->write_time = time;
+        dir->serial = dll_search_serial;
+        dir->count = 0;
+        dir->len = dir_len;
+        memcpy( dir->name, nt_name->Buffer, dir_len * sizeof(WCHAR) );
+        list_add_head( &missing_dll_dirs, &dir->entry );
+    }
+
+    if (!(file = RtlAllocateHeap( GetProcessHeap(), 0, offsetof( struct missing_dll_file, name[len] ))))
+        return;
+    hash = hash_dll_file_name( nt_name );
+    file->dir = dir;
+    file->hash = hash;
+    file->len = len;
+    memcpy( file->name, nt_name->Buffer, len * sizeof(WCHAR) );
+    missing_dll_count++;
+    list_add_head( &missing_dll_files[hash % MISSING_DLL_HASH_SIZE], &file->entry );
+    dir->count++;
+}
+
+
 /***********************************************************************
  *	open_dll_file
  *
@@ -2652,6 +2882,7 @@ static NTSTATUS open_dll_file( UNICODE_STRING *nt_name, WINE_MODREF **pwm, HANDL
     HANDLE handle;
 
     if ((*pwm = find_fullname_module( nt_name ))) return STATUS_SUCCESS;
+    if (is_missing_dll_file( nt_name )) return STATUS_DLL_NOT_FOUND;
 
     attr.Length = sizeof(attr);
     attr.RootDirectory = 0;
@@ -2670,6 +2901,7 @@ static NTSTATUS open_dll_file( UNICODE_STRING *nt_name, WINE_MODREF **pwm, HANDL
             /* if the file exists but failed to open, report the error */
             return status;
         }
+        if (status == STATUS_OBJECT_NAME_NOT_FOUND) add_missing_dll_file( nt_name );
         /* otherwise continue searching */
         return STATUS_DLL_NOT_FOUND;
     }
@@ -3364,6 +3596,8 @@ NTSTATUS WINAPI DECLSPEC_HOTPATCH LdrLoadDll(LPCWSTR path_name, DWORD flags,
 
     RtlEnterCriticalSection( &loader_section );
 
+    /* directories may have changed since the last load, recheck the cached missing files */
+    dll_search_serial++;
     nts = load_dll( path_name, dllname ? dllname : libname->Buffer, flags, &wm, FALSE );
 
     if (nts == STATUS_SUCCESS && !(wm->ldr.Flags & LDR_DONT_RESOLVE_REFS))
@@ -3936,6 +4170,7 @@ static void free_modref( WINE_MODREF *wm )
     NtUnmapViewOfSection( NtCurrentProcess(), wm->ldr.DllBase );
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -4295,6 +4530,8 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
         /* initialize hash table */
         for (i = 0; i < HASH_MAP_SIZE; i++)
             InitializeListHead( &hash_table[i] );
+        for (i = 0; i < MISSING_DLL_HASH_SIZE; i++)
+            list_init( &missing_dll_files[i] );
 
         init_user_process_params();
         load_global_options();
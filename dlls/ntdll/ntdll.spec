@@ -366,7 +366,7 @@
 @ stdcall -syscall NtResumeProcess(long)
 @ stdcall -syscall NtResumeThread(long ptr)
 @ stdcall -syscall NtSaveKey(long long)
-# @ stub NtSaveKeyEx
+@ stdcall -syscall NtSaveKeyEx(long long long)
 # @ stub NtSaveMergedKeys
 @ stdcall -syscall NtSecureConnectPort(ptr ptr ptr ptr ptr ptr ptr ptr ptr)
 # @ stub NtSetBootEntryOrder
@@ -1397,7 +1397,7 @@
 @ stdcall -private -syscall ZwResumeProcess(long) NtResumeProcess
 @ stdcall -private -syscall ZwResumeThread(long ptr) NtResumeThread
 @ stdcall -private -syscall ZwSaveKey(long long) NtSaveKey
-# @ stub ZwSaveKeyEx
+@ stdcall -private -syscall ZwSaveKeyEx(long long long) NtSaveKeyEx
 # @ stub ZwSaveMergedKeys
 @ stdcall -private -syscall ZwSecureConnectPort(ptr ptr ptr ptr ptr ptr ptr ptr ptr) NtSecureConnectPort
 # @ stub ZwSetBootEntryOrder
@@ -1686,6 +1686,7 @@
 
 # Server interface
 @ cdecl -syscall -norelay wine_server_call(ptr)
+@ cdecl -syscall -norelay wine_server_call_batch(ptr long)
 @ cdecl -syscall wine_server_fd_to_handle(long long long ptr)
 @ cdecl -syscall wine_server_handle_to_fd(long long ptr ptr)
 
@@ -4133,6 +4133,83 @@ static void test_dotfile_file_attributes(void)
     CloseHandle( h );
 }
 
+/* make a directory look unmodified for a while, so that its contents can be cached */
+static void age_directory( const char *dir )
+{
+    FILETIME ft;
+    HANDLE h;
+    BOOL ret;
+
+    h = CreateFileA( dir, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                     NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0 );
+    ok( h != INVALID_HANDLE_VALUE, "failed to open %s, error %lu\n", dir, GetLastError() );
+    GetSystemTimeAsFileTime( &ft );
+    ft.dwHighDateTime -= 10;  /* about 72 minutes earlier */
+    ret = SetFileTime( h, NULL, NULL, &ft );
+    ok( ret, "SetFileTime failed, error %lu\n", GetLastError() );
+    CloseHandle( h );
+}
+
+static void test_case_insensitive_lookup(void)
+{
+    char temppath[MAX_PATH], dir[MAX_PATH], name[MAX_PATH], name2[MAX_PATH];
+    unsigned int i;
+    DWORD attrs;
+    HANDLE h;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, temppath );
+    GetTempFileNameA( temppath, "dir", 0, dir );
+    DeleteFileA( dir );
+    ret = CreateDirectoryA( dir, NULL );
+    ok( ret, "CreateDirectory failed, error %lu\n", GetLastError() );
+
+    for (i = 0; i < 16; i++)
+    {
+        sprintf( name, "%s\\MixedCase%u.Txt", dir, i );
+        h = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+        ok( h != INVALID_HANDLE_VALUE, "failed to create %s, error %lu\n", name, GetLastError() );
+        CloseHandle( h );
+    }
+
+    /* repeated lookups must keep working while the directory changes */
+    age_directory( dir );
+    for (i = 0; i < 3; i++)
+    {
+        sprintf( name, "%s\\MIXEDCASE7.TXT", dir );
+        attrs = GetFileAttributesA( name );
+        ok( attrs != INVALID_FILE_ATTRIBUTES, "%u: lookup failed, error %lu\n", i, GetLastError() );
+
+        sprintf( name, "%s\\mixedcase7.txt", dir );
+        sprintf( name2, "%s\\Renamed.Txt", dir );
+        ret = MoveFileA( name, name2 );
+        ok( ret, "%u: MoveFile failed, error %lu\n", i, GetLastError() );
+
+        sprintf( name, "%s\\mixedcase7.TXT", dir );
+        attrs = GetFileAttributesA( name );
+        ok( attrs == INVALID_FILE_ATTRIBUTES, "%u: file still found\n", i );
+        ok( GetLastError() == ERROR_FILE_NOT_FOUND, "%u: got error %lu\n", i, GetLastError() );
+
+        sprintf( name, "%s\\RENAMED.txt", dir );
+        attrs = GetFileAttributesA( name );
+        ok( attrs != INVALID_FILE_ATTRIBUTES, "%u: renamed file not found, error %lu\n", i, GetLastError() );
+
+        sprintf( name, "%s\\MixedCase7.Txt", dir );
+        ret = MoveFileA( name2, name );
+        ok( ret, "%u: MoveFile failed, error %lu\n", i, GetLastError() );
+        if (i == 1) age_directory( dir );
+    }
+
+    for (i = 0; i < 16; i++)
+    {
+        sprintf( name, "%s\\mixedcase%u.txt", dir, i );
+        ret = DeleteFileA( name );
+        ok( ret, "failed to delete %s, error %lu\n", name, GetLastError() );
+    }
+    ret = RemoveDirectoryA( dir );
+    ok( ret, "RemoveDirectory failed, error %lu\n", GetLastError() );
+}
+
 static void test_file_mode(void)
 {
     UNICODE_STRING file_name, pipe_dev_name, mountmgr_dev_name, mailslot_dev_name;
@@ -6185,6 +6262,7 @@ START_TEST(file)
     test_file_access_information();
     test_file_attribute_tag_information();
     test_dotfile_file_attributes();
+    test_case_insensitive_lookup();
     test_file_mode();
     test_file_readonly_access();
     test_query_volume_information_file();
@@ -2192,7 +2192,9 @@ static void test_query_process_handlecount(void)
     ULONG ReturnLength;
     DWORD handlecount;
     BYTE buffer[2 * sizeof(DWORD)];
-    HANDLE process;
+    PROCESS_HANDLE_INFORMATION info;
+    HANDLE process, handles[16];
+    unsigned int i;
 
     status = NtQueryInformationProcess(NULL, ProcessHandleCount, NULL, sizeof(handlecount), NULL);
     ok( status == STATUS_ACCESS_VIOLATION || status == STATUS_INVALID_HANDLE,
@@ -2221,14 +2223,34 @@ static void test_query_process_handlecount(void)
     status = NtQueryInformationProcess( GetCurrentProcess(), ProcessHandleCount, buffer, sizeof(buffer), &ReturnLength);
     ok( status == STATUS_INFO_LENGTH_MISMATCH || status == STATUS_SUCCESS,
         "Expected STATUS_INFO_LENGTH_MISMATCH or STATUS_SUCCESS, got %08lx\n", status);
-    ok( sizeof(handlecount) == ReturnLength, "Inconsistent length %ld\n", ReturnLength);
+    ok( sizeof(handlecount) == ReturnLength || sizeof(buffer) == ReturnLength,
+        "Inconsistent length %ld\n", ReturnLength);
 
     /* Check if we have some return values */
     if (winetest_debug > 1) trace("HandleCount : %ld\n", handlecount);
-    todo_wine
+    ok( handlecount > 0, "Expected some handles, got 0\n");
+
+    /* the high-water mark is only returned by newer Windows versions */
+    memset( &info, 0, sizeof(info) );
+    status = NtQueryInformationProcess( GetCurrentProcess(), ProcessHandleCount, &info, sizeof(info), &ReturnLength );
+    if (status == STATUS_INFO_LENGTH_MISMATCH)
     {
-        ok( handlecount > 0, "Expected some handles, got 0\n");
+        win_skip( "PROCESS_HANDLE_INFORMATION not supported\n" );
+        return;
     }
+    ok( status == STATUS_SUCCESS, "Expected STATUS_SUCCESS, got %08lx\n", status );
+    ok( ReturnLength == sizeof(info), "Inconsistent length %ld\n", ReturnLength );
+    ok( info.HandleCount > 0, "Expected some handles, got 0\n" );
+    ok( info.HandleCountHighWatermark >= info.HandleCount, "got high-water mark %lu for %lu handles\n",
+        info.HandleCountHighWatermark, info.HandleCount );
+
+    /* the mark stays put when the handles are closed again */
+    for (i = 0; i < ARRAY_SIZE(handles); i++) handles[i] = CreateEventA( NULL, FALSE, FALSE, NULL );
+    for (i = 0; i < ARRAY_SIZE(handles); i++) CloseHandle( handles[i] );
+    status = NtQueryInformationProcess( GetCurrentProcess(), ProcessHandleCount, &info, sizeof(info), &ReturnLength );
+    ok( status == STATUS_SUCCESS, "Expected STATUS_SUCCESS, got %08lx\n", status );
+    ok( info.HandleCountHighWatermark >= info.HandleCount + ARRAY_SIZE(handles),
+        "got high-water mark %lu for %lu handles\n", info.HandleCountHighWatermark, info.HandleCount );
 }
 
 static void test_query_process_image_file_name(void)
@@ -3063,6 +3085,53 @@ static void test_affinity(void)
         "Unexpected thread affinity\n" );
 }
 
+static void test_current_thread_info(void)
+{
+    THREAD_BASIC_INFORMATION tbi, tbi2;
+    PROCESS_PRIORITY_CLASS priority;
+    ULONG suspend_count;
+    NTSTATUS status;
+    HANDLE thread;
+    BOOL ret;
+
+    /* queries on the pseudo handle must see updates done through a real handle */
+    ret = DuplicateHandle( GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread,
+                           0, FALSE, DUPLICATE_SAME_ACCESS );
+    ok( ret, "DuplicateHandle failed, error %lu\n", GetLastError() );
+
+    ret = SetThreadPriority( thread, THREAD_PRIORITY_BELOW_NORMAL );
+    ok( ret, "SetThreadPriority failed, error %lu\n", GetLastError() );
+    status = pNtQueryInformationThread( GetCurrentThread(), ThreadBasicInformation, &tbi, sizeof(tbi), NULL );
+    ok( !status, "got %#lx\n", status );
+    status = pNtQueryInformationThread( thread, ThreadBasicInformation, &tbi2, sizeof(tbi2), NULL );
+    ok( !status, "got %#lx\n", status );
+    ok( tbi.Priority == tbi2.Priority, "got priority %ld / %ld\n", tbi.Priority, tbi2.Priority );
+    ok( tbi.AffinityMask == tbi2.AffinityMask, "got affinity %#Ix / %#Ix\n", tbi.AffinityMask, tbi2.AffinityMask );
+    ok( tbi.ExitStatus == STATUS_PENDING, "got exit status %#lx\n", tbi.ExitStatus );
+    ok( tbi.TebBaseAddress == tbi2.TebBaseAddress, "got teb %p / %p\n", tbi.TebBaseAddress, tbi2.TebBaseAddress );
+    ok( tbi.ClientId.UniqueThread == ULongToHandle( GetCurrentThreadId() ), "got tid %p\n", tbi.ClientId.UniqueThread );
+    SetThreadPriority( thread, THREAD_PRIORITY_NORMAL );
+    status = pNtQueryInformationThread( GetCurrentThread(), ThreadBasicInformation, &tbi, sizeof(tbi), NULL );
+    ok( !status, "got %#lx\n", status );
+    ok( tbi.Priority == tbi2.Priority + 1, "got priority %ld\n", tbi.Priority );
+
+    status = pNtQueryInformationThread( GetCurrentThread(), ThreadSuspendCount, &suspend_count,
+                                        sizeof(suspend_count), NULL );
+    ok( !status || broken(status == STATUS_INVALID_INFO_CLASS) /* before win8.1 */, "got %#lx\n", status );
+    if (!status) ok( !suspend_count, "got suspend count %lu\n", suspend_count );
+    CloseHandle( thread );
+
+    ret = SetPriorityClass( GetCurrentProcess(), BELOW_NORMAL_PRIORITY_CLASS );
+    ok( ret, "SetPriorityClass failed, error %lu\n", GetLastError() );
+    status = NtQueryInformationProcess( GetCurrentProcess(), ProcessPriorityClass, &priority, sizeof(priority), NULL );
+    ok( !status, "got %#lx\n", status );
+    ok( priority.PriorityClass == PROCESS_PRIOCLASS_BELOW_NORMAL, "got class %u\n", priority.PriorityClass );
+    SetPriorityClass( GetCurrentProcess(), NORMAL_PRIORITY_CLASS );
+    status = NtQueryInformationProcess( GetCurrentProcess(), ProcessPriorityClass, &priority, sizeof(priority), NULL );
+    ok( !status, "got %#lx\n", status );
+    ok( priority.PriorityClass == PROCESS_PRIOCLASS_NORMAL, "got class %u\n", priority.PriorityClass );
+}
+
 static DWORD WINAPI hide_from_debugger_thread(void *arg)
 {
     HANDLE stop_event = arg;
@@ -3637,6 +3706,7 @@ START_TEST(info)
     test_thread_ideal_processor();
 
     test_affinity();
+    test_current_thread_info();
     test_debug_object();
 
     /* belongs to its own file */
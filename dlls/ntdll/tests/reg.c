@@ -884,6 +884,105 @@ static void test_NtQueryValueKey(void)
     pNtClose(key);
 }
 
+static void test_NtQueryValueKey_changes(void)
+{
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    HANDLE key, key2;
+    char buffer[64];
+    NTSTATUS status;
+    DWORD len, data;
+    int i;
+
+    info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+    status = pNtOpenKey(&key2, KEY_READ|KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+
+    pRtlCreateUnicodeStringFromAsciiz(&name, "changetest");
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, info, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08lx\n", status);
+
+    /* values changed through another handle must be seen by repeated queries */
+    for (i = 0; i < 3; i++)
+    {
+        data = i;
+        status = pNtSetValueKey(key2, &name, 0, REG_DWORD, &data, sizeof(data));
+        ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+        status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, info, sizeof(buffer), &len);
+        ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+        ok(*(DWORD *)info->Data == i, "got %lu, expected %u\n", *(DWORD *)info->Data, i);
+        status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, info, sizeof(buffer), &len);
+        ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+        ok(*(DWORD *)info->Data == i, "got %lu, expected %u\n", *(DWORD *)info->Data, i);
+    }
+
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, info, FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data), &len);
+    ok(status == STATUS_BUFFER_OVERFLOW, "got 0x%08lx\n", status);
+    ok(len == FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[sizeof(DWORD)]), "got len %lu\n", len);
+
+    status = pNtDeleteValueKey(key2, &name);
+    ok(status == STATUS_SUCCESS, "NtDeleteValueKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, info, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08lx\n", status);
+
+    pRtlFreeUnicodeString(&name);
+    pNtClose(key2);
+    pNtClose(key);
+}
+
+static void test_NtQueryValueKey_reused_handle(void)
+{
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name, subkey_name;
+    HANDLE key, subkey, handle;
+    char buffer[64];
+    NTSTATUS status;
+    DWORD len, data;
+    int i;
+
+    info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_ALL_ACCESS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+
+    pRtlCreateUnicodeStringFromAsciiz(&subkey_name, "reusetest");
+    InitializeObjectAttributes(&attr, &subkey_name, 0, key, 0);
+    status = pNtCreateKey(&subkey, KEY_ALL_ACCESS, &attr, 0, 0, 0, 0);
+    ok(status == STATUS_SUCCESS, "NtCreateKey failed: 0x%08lx\n", status);
+
+    pRtlCreateUnicodeStringFromAsciiz(&name, "reusevalue");
+    data = 1;
+    status = pNtSetValueKey(key, &name, 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+    data = 2;
+    status = pNtSetValueKey(subkey, &name, 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+
+    /* the same handle value refers to each key in turn; values must come from the right one */
+    for (i = 0; i < 4; i++)
+    {
+        InitializeObjectAttributes(&attr, i % 2 ? &subkey_name : &winetestpath, 0, i % 2 ? key : 0, 0);
+        status = pNtOpenKey(&handle, KEY_READ, &attr);
+        ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+        status = pNtQueryValueKey(handle, &name, KeyValuePartialInformation, info, sizeof(buffer), &len);
+        ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+        ok(*(DWORD *)info->Data == 1 + i % 2, "%u: got %lu\n", i, *(DWORD *)info->Data);
+        pNtClose(handle);
+    }
+
+    pNtDeleteValueKey(key, &name);
+    pNtDeleteKey(subkey);
+    pRtlFreeUnicodeString(&name);
+    pRtlFreeUnicodeString(&subkey_name);
+    pNtClose(subkey);
+    pNtClose(key);
+}
+
 static void test_NtDeleteKey(void)
 {
     UNICODE_STRING string;
@@ -2637,6 +2736,8 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_NtQueryValueKey_changes();
+    test_NtQueryValueKey_reused_handle();
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
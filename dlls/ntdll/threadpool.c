@@ -107,18 +107,38 @@ struct threadpool
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
-    struct list             pools[3];
-    RTL_CONDITION_VARIABLE  update_event;
+    /* Objects submitted to the pool and not yet picked by a worker, order matches
+     * TP_CALLBACK_PRIORITY - high, normal, low. */
+    SLIST_HEADER            pending[3];
+    /* Number of queued objects for each priority, either pending or in a worker queue. */
+    LONG                    num_queued[3];
+    /* worker thread queues, locked via .workers_lock */
+    RTL_SRWLOCK             workers_lock;
+    struct list             workers;
+    /* idle worker threads wait for wake_count to change */
+    LONG                    wake_count;
+    LONG                    num_idle_workers;
     /* information about worker threads, locked via .cs */
     int                     max_workers;
     int                     min_workers;
-    int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_workers;
+    /* number of queued objects and running callbacks, updated atomically */
+    LONG                    num_busy_workers;
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
 };
 
+/* internal worker thread representation */
+struct threadpool_worker
+{
+    struct list             entry;
+    RTL_SRWLOCK             lock;
+    /* Objects owned by the worker, locked via .lock, other workers may steal
+     * them. Order matches TP_CALLBACK_PRIORITY - high, normal, low. */
+    struct list             queues[3];
+    LONG                    count[3];
+};
+
 enum threadpool_objtype
 {
     TP_OBJECT_TYPE_SIMPLE,
@@ -153,7 +173,10 @@ struct threadpool_object
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the callbacks, locked via .lock */
+    RTL_SRWLOCK             lock;
+    BOOL                    queued;
+    SLIST_ENTRY             pending_entry;
     struct list             pool_entry;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
@@ -200,7 +223,7 @@ struct threadpool_object
         struct
         {
             PTP_IO_CALLBACK callback;
-            /* locked via .pool->cs */
+            /* locked via .lock */
             unsigned int    pending_count, skipped_count, completion_count, completion_max;
             BOOL            shutting_down;
             struct io_completion *completions;
@@ -363,6 +386,8 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static BOOL tp_object_add_pending( struct threadpool_object *object, BOOL signaled );
+static void tp_object_queue( struct threadpool_object *object );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread );
 static void tp_object_prepare_shutdown( struct threadpool_object *object );
@@ -1276,10 +1301,10 @@ static void CALLBACK waitqueue_thread_proc( void *param )
                 if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
                 {
                     InterlockedIncrement( &wait->refcount );
+                    RtlAcquireSRWLockExclusive( &wait->lock );
                     wait->num_pending_callbacks++;
-                    RtlEnterCriticalSection( &wait->pool->cs );
                     tp_object_execute( wait, TRUE );
-                    RtlLeaveCriticalSection( &wait->pool->cs );
+                    RtlReleaseSRWLockExclusive( &wait->lock );
                     tp_object_release( wait );
                 }
                 else tp_object_submit( wait, FALSE );
@@ -1332,11 +1357,11 @@ static void CALLBACK waitqueue_thread_proc( void *param )
                     }
                     if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
                     {
+                        RtlAcquireSRWLockExclusive( &wait->lock );
                         wait->u.wait.signaled++;
                         wait->num_pending_callbacks++;
-                        RtlEnterCriticalSection( &wait->pool->cs );
                         tp_object_execute( wait, TRUE );
-                        RtlLeaveCriticalSection( &wait->pool->cs );
+                        RtlReleaseSRWLockExclusive( &wait->lock );
                     }
                     else tp_object_submit( wait, TRUE );
                 }
@@ -1518,7 +1543,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
     struct threadpool_object *io;
     IO_STATUS_BLOCK iosb;
     ULONG_PTR key, value;
-    BOOL destroy, skip;
+    BOOL destroy, skip, queue;
     NTSTATUS status;
 
     TRACE( "starting I/O completion thread\n" );
@@ -1540,7 +1565,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
 
         if (io && (io->shutdown || io->u.io.shutting_down))
         {
-            RtlEnterCriticalSection( &io->pool->cs );
+            RtlAcquireSRWLockExclusive( &io->lock );
             if (!io->u.io.pending_count)
             {
                 if (io->u.io.skipped_count)
@@ -1551,7 +1576,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                 else
                     destroy = TRUE;
             }
-            RtlLeaveCriticalSection( &io->pool->cs );
+            RtlReleaseSRWLockExclusive( &io->lock );
             if (skip) continue;
         }
 
@@ -1564,7 +1589,8 @@ static void CALLBACK ioqueue_thread_proc( void *param )
         }
         else if (io)
         {
-            RtlEnterCriticalSection( &io->pool->cs );
+            queue = FALSE;
+            RtlAcquireSRWLockExclusive( &io->lock );
 
             TRACE( "pending_count %u.\n", io->u.io.pending_count );
 
@@ -1575,7 +1601,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                         io->u.io.completion_count + 1, sizeof(*io->u.io.completions)))
                 {
                     ERR( "Failed to allocate memory.\n" );
-                    RtlLeaveCriticalSection( &io->pool->cs );
+                    RtlReleaseSRWLockExclusive( &io->lock );
                     continue;
                 }
 
@@ -1583,9 +1609,11 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                 completion->iosb = iosb;
                 completion->cvalue = value;
 
-                tp_object_submit( io, FALSE );
+                queue = tp_object_add_pending( io, FALSE );
             }
-            RtlLeaveCriticalSection( &io->pool->cs );
+            RtlReleaseSRWLockExclusive( &io->lock );
+
+            if (queue) tp_object_queue( io );
         }
 
         if (!ioqueue.objcount)
@@ -1678,9 +1706,15 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     RtlInitializeCriticalSection( &pool->cs );
     pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
-        list_init( &pool->pools[i] );
-    RtlInitializeConditionVariable( &pool->update_event );
+    for (i = 0; i < ARRAY_SIZE(pool->pending); ++i)
+    {
+        RtlInitializeSListHead( &pool->pending[i] );
+        pool->num_queued[i] = 0;
+    }
+    RtlInitializeSRWLock( &pool->workers_lock );
+    list_init( &pool->workers );
+    pool->wake_count            = 0;
+    pool->num_idle_workers      = 0;
 
     pool->max_workers             = 500;
     pool->min_workers             = 0;
@@ -1707,7 +1741,8 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
     assert( pool != default_threadpool );
 
     pool->shutdown = TRUE;
-    RtlWakeAllConditionVariable( &pool->update_event );
+    InterlockedIncrement( &pool->wake_count );
+    RtlWakeAddressAll( &pool->wake_count );
 }
 
 /***********************************************************************
@@ -1726,8 +1761,9 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
 
     assert( pool->shutdown );
     assert( !pool->objcount );
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
-        assert( list_empty( &pool->pools[i] ) );
+    assert( list_empty( &pool->workers ) );
+    for (i = 0; i < ARRAY_SIZE(pool->pending); ++i)
+        assert( !RtlFirstEntrySList( &pool->pending[i] ) );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1907,6 +1943,9 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     memset( &object->group_entry, 0, sizeof(object->group_entry) );
     object->is_group_member         = FALSE;
 
+    RtlInitializeSRWLock( &object->lock );
+    object->queued                  = FALSE;
+    memset( &object->pending_entry, 0, sizeof(object->pending_entry) );
     memset( &object->pool_entry, 0, sizeof(object->pool_entry) );
     RtlInitializeConditionVariable( &object->finished_event );
     RtlInitializeConditionVariable( &object->group_finished_event );
@@ -1930,7 +1969,7 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
             TP_CALLBACK_ENVIRON_V3 *environment_v3 = (TP_CALLBACK_ENVIRON_V3 *)environment;
 
             object->priority = environment_v3->CallbackPriority;
-            assert( object->priority < ARRAY_SIZE(pool->pools) );
+            assert( object->priority < ARRAY_SIZE(pool->pending) );
         }
 
         if (environment->ActivationContext)
@@ -1967,50 +2006,118 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
         tp_object_release( object );
 }
 
-static void tp_object_prio_queue( struct threadpool_object *object )
+/***********************************************************************
+ *           tp_threadpool_wake    (internal)
+ *
+ * Wakes up an idle worker thread, if any, after new objects were queued.
+ */
+static void tp_threadpool_wake( struct threadpool *pool )
 {
-    ++object->pool->num_busy_workers;
-    list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
+    InterlockedIncrement( &pool->wake_count );
+    if (ReadNoFence( &pool->num_idle_workers ))
+        RtlWakeAddressSingle( &pool->wake_count );
 }
 
 /***********************************************************************
- *           tp_object_submit    (internal)
+ *           tp_object_push    (internal)
  *
- * Submits a threadpool object to the associated threadpool. This
- * function has to be VOID because TpPostWork can never fail on Windows.
+ * Queues an object to the queue of the given worker, or to the pending
+ * lists of the pool when no worker is given. The object has to be marked
+ * as queued by the caller.
  */
-static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+static void tp_object_push( struct threadpool_object *object, struct threadpool_worker *worker )
 {
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
 
-    assert( !object->shutdown );
-    assert( !pool->shutdown );
+    InterlockedIncrement( &pool->num_busy_workers );
+    InterlockedIncrement( &pool->num_queued[object->priority] );
 
-    enter_critical_section( &pool->cs );
+    if (worker)
+    {
+        RtlAcquireSRWLockExclusive( &worker->lock );
+        list_add_tail( &worker->queues[object->priority], &object->pool_entry );
+        worker->count[object->priority]++;
+        RtlReleaseSRWLockExclusive( &worker->lock );
+    }
+    else
+    {
+        RtlInterlockedPushEntrySList( &pool->pending[object->priority], &object->pending_entry );
+    }
+}
 
-    /* Start new worker threads if required. */
-    if (pool->num_busy_workers >= pool->num_workers &&
-        pool->num_workers < pool->max_workers)
-        status = tp_new_worker_thread( pool );
+/***********************************************************************
+ *           tp_object_add_pending    (internal)
+ *
+ * Adds a pending callback to an object, object->lock has to be held.
+ * Returns TRUE if the object has to be queued with tp_object_queue.
+ */
+static BOOL tp_object_add_pending( struct threadpool_object *object, BOOL signaled )
+{
+    assert( !object->shutdown );
+    assert( !object->pool->shutdown );
 
-    /* Queue work item and increment refcount. */
+    /* Increment refcount for the pending callback. */
     InterlockedIncrement( &object->refcount );
-    if (!object->num_pending_callbacks++)
-        tp_object_prio_queue( object );
+    object->num_pending_callbacks++;
 
     /* Count how often the object was signaled. */
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
         object->u.wait.signaled++;
 
+    /* Objects are queued only once, workers requeue them while callbacks are pending.
+     * Queued objects keep a reference, as they may stay queued after being cancelled. */
+    if (object->queued) return FALSE;
+    InterlockedIncrement( &object->refcount );
+    object->queued = TRUE;
+    return TRUE;
+}
+
+/***********************************************************************
+ *           tp_object_queue    (internal)
+ *
+ * Queues an object to its threadpool, without taking any pool lock
+ * unless a new worker thread has to be started.
+ */
+static void tp_object_queue( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+    NTSTATUS status = STATUS_UNSUCCESSFUL;
+
+    tp_object_push( object, NULL );
+
+    /* Start new worker threads if required. */
+    if (ReadNoFence( &pool->num_busy_workers ) > ReadNoFence( &pool->num_workers ) &&
+        ReadNoFence( &pool->num_workers ) < pool->max_workers)
+    {
+        enter_critical_section( &pool->cs );
+        if (pool->num_busy_workers > pool->num_workers && pool->num_workers < pool->max_workers)
+            status = tp_new_worker_thread( pool );
+        leave_critical_section( &pool->cs );
+    }
+
     /* No new thread started - wake up one existing thread. */
     if (status != STATUS_SUCCESS)
     {
         assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
+        tp_threadpool_wake( pool );
     }
+}
 
-    leave_critical_section( &pool->cs );
+/***********************************************************************
+ *           tp_object_submit    (internal)
+ *
+ * Submits a threadpool object to the associated threadpool. This
+ * function has to be VOID because TpPostWork can never fail on Windows.
+ */
+static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+{
+    BOOL queue;
+
+    RtlAcquireSRWLockExclusive( &object->lock );
+    queue = tp_object_add_pending( object, signaled );
+    RtlReleaseSRWLockExclusive( &object->lock );
+
+    if (queue) tp_object_queue( object );
 }
 
 /***********************************************************************
@@ -2020,15 +2127,15 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
  */
 static void tp_object_cancel( struct threadpool_object *object )
 {
-    struct threadpool *pool = object->pool;
     LONG pending_callbacks = 0;
 
-    enter_critical_section( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
     if (object->num_pending_callbacks)
     {
+        /* The object stays queued, workers will drop it when they find
+         * that no callbacks are pending anymore. */
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
@@ -2038,7 +2145,7 @@ static void tp_object_cancel( struct threadpool_object *object )
         object->u.io.skipped_count += object->u.io.pending_count;
         object->u.io.pending_count = 0;
     }
-    leave_critical_section( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
 
     while (pending_callbacks--)
         tp_object_release( object );
@@ -2065,17 +2172,15 @@ static BOOL object_is_finished( struct threadpool_object *object, BOOL group )
  */
 static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
 {
-    struct threadpool *pool = object->pool;
-
-    enter_critical_section( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
     while (!object_is_finished( object, group_wait ))
     {
         if (group_wait)
-            RtlSleepConditionVariableCS( &object->group_finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableSRW( &object->group_finished_event, &object->lock, NULL, 0 );
         else
-            RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableSRW( &object->finished_event, &object->lock, NULL, 0 );
     }
-    leave_critical_section( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
 }
 
 static void tp_ioqueue_unlock( struct threadpool_object *io )
@@ -2120,6 +2225,7 @@ static BOOL tp_object_release( struct threadpool_object *object )
     TRACE( "destroying object %p of type %u\n", object, object->type );
 
     assert( object->shutdown );
+    assert( !object->queued );
     assert( !object->num_pending_callbacks );
     assert( !object->num_running_callbacks );
     assert( !object->num_associated_callbacks );
@@ -2152,32 +2258,151 @@ static BOOL tp_object_release( struct threadpool_object *object )
     return TRUE;
 }
 
-static struct list *threadpool_get_next_item( const struct threadpool *pool )
+/***********************************************************************
+ *           tp_worker_pop    (internal)
+ *
+ * Removes the first object of the given priority from a worker queue.
+ */
+static struct threadpool_object *tp_worker_pop( struct threadpool_worker *worker, unsigned int priority )
 {
     struct list *ptr;
+
+    RtlAcquireSRWLockExclusive( &worker->lock );
+    if ((ptr = list_head( &worker->queues[priority] )))
+    {
+        list_remove( ptr );
+        worker->count[priority]--;
+    }
+    RtlReleaseSRWLockExclusive( &worker->lock );
+
+    return ptr ? LIST_ENTRY( ptr, struct threadpool_object, pool_entry ) : NULL;
+}
+
+/***********************************************************************
+ *           tp_worker_pull_pending    (internal)
+ *
+ * Moves all the pending objects of the given priority to a worker queue.
+ */
+static BOOL tp_worker_pull_pending( struct threadpool *pool, struct threadpool_worker *worker,
+                                    unsigned int priority )
+{
+    struct list objects = LIST_INIT( objects );
+    struct threadpool_object *object;
+    SLIST_ENTRY *entry, *next;
+    LONG count = 0;
+
+    if (!(entry = RtlInterlockedFlushSList( &pool->pending[priority] )))
+        return FALSE;
+
+    /* The pending list is in reverse submission order. */
+    for (; entry; entry = next)
+    {
+        next = entry->Next;
+        object = CONTAINING_RECORD( entry, struct threadpool_object, pending_entry );
+        list_add_head( &objects, &object->pool_entry );
+        count++;
+    }
+
+    RtlAcquireSRWLockExclusive( &worker->lock );
+    list_move_tail( &worker->queues[priority], &objects );
+    worker->count[priority] += count;
+    RtlReleaseSRWLockExclusive( &worker->lock );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           tp_worker_steal    (internal)
+ *
+ * Moves half of the objects of the given priority from the queue of
+ * another worker to the queue of the current worker. Busy queues are
+ * skipped, instead of waiting for their owner.
+ */
+static BOOL tp_worker_steal( struct threadpool *pool, struct threadpool_worker *worker,
+                             unsigned int priority )
+{
+    struct list objects = LIST_INIT( objects );
+    struct threadpool_worker *victim;
+    LONG i, count = 0;
+
+    RtlAcquireSRWLockShared( &pool->workers_lock );
+    LIST_FOR_EACH_ENTRY( victim, &pool->workers, struct threadpool_worker, entry )
+    {
+        if (victim == worker || !ReadNoFence( &victim->count[priority] )) continue;
+        if (!RtlTryAcquireSRWLockExclusive( &victim->lock )) continue;
+
+        count = (victim->count[priority] + 1) / 2;
+        for (i = 0; i < count; ++i)
+        {
+            struct list *ptr = list_tail( &victim->queues[priority] );
+            list_remove( ptr );
+            list_add_head( &objects, ptr );
+        }
+        victim->count[priority] -= count;
+
+        RtlReleaseSRWLockExclusive( &victim->lock );
+        if (count) break;
+    }
+    RtlReleaseSRWLockShared( &pool->workers_lock );
+
+    if (!count) return FALSE;
+
+    RtlAcquireSRWLockExclusive( &worker->lock );
+    list_move_tail( &worker->queues[priority], &objects );
+    worker->count[priority] += count;
+    RtlReleaseSRWLockExclusive( &worker->lock );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           tp_worker_get_next_object    (internal)
+ *
+ * Returns the next queued object a worker should process, looking at its
+ * own queue first, then at the pending objects of the pool, and finally
+ * stealing objects from other workers. Higher priority objects are always
+ * returned first.
+ */
+static struct threadpool_object *tp_worker_get_next_object( struct threadpool *pool,
+                                                            struct threadpool_worker *worker )
+{
+    struct threadpool_object *object;
     unsigned int i;
 
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
+    for (i = 0; i < ARRAY_SIZE(worker->queues); ++i)
     {
-        if ((ptr = list_head( &pool->pools[i] )))
-            break;
+        if (!ReadNoFence( &pool->num_queued[i] )) continue;
+
+        if ((object = tp_worker_pop( worker, i )) ||
+            ((tp_worker_pull_pending( pool, worker, i ) || tp_worker_steal( pool, worker, i )) &&
+             (object = tp_worker_pop( worker, i ))))
+        {
+            InterlockedDecrement( &pool->num_queued[i] );
+            return object;
+        }
     }
 
-    return ptr;
+    return NULL;
+}
+
+static BOOL threadpool_has_queued_objects( struct threadpool *pool )
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(pool->num_queued); ++i)
+        if (ReadNoFence( &pool->num_queued[i] )) return TRUE;
+
+    return FALSE;
 }
 
 /***********************************************************************
  *           tp_object_execute    (internal)
  *
- * Executes a threadpool object callback, object->pool->cs has to be
- * held.
+ * Executes a threadpool object callback, object->lock has to be held.
  */
 static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread )
 {
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
     struct io_completion completion;
-    struct threadpool *pool = object->pool;
     TP_WAIT_RESULT wait_result = 0;
     NTSTATUS status;
 
@@ -2195,10 +2420,10 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
         completion = object->u.io.completions[--object->u.io.completion_count];
     }
 
-    /* Leave critical section and do the actual callback. */
+    /* Release the object lock and do the actual callback. */
     object->num_associated_callbacks++;
     object->num_running_callbacks++;
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
     if (wait_thread) RtlLeaveCriticalSection( &waitqueue.cs );
 
     /* Initialize threadpool instance struct. */
@@ -2304,7 +2529,7 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
 
 skip_cleanup:
     if (wait_thread) RtlEnterCriticalSection( &waitqueue.cs );
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
 
     /* Simple callbacks are automatically shutdown after execution. */
     if (object->type == TP_OBJECT_TYPE_SIMPLE)
@@ -2325,60 +2550,139 @@ skip_cleanup:
     }
 }
 
+/***********************************************************************
+ *           tp_worker_process_object    (internal)
+ *
+ * Executes one pending callback of an object taken from a worker queue.
+ */
+static void tp_worker_process_object( struct threadpool_worker *worker, struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+    BOOL queued;
+
+    RtlAcquireSRWLockExclusive( &object->lock );
+    assert( object->queued );
+
+    /* Callbacks may have been cancelled while the object was queued. */
+    if (object->num_pending_callbacks)
+    {
+        /* If further pending callbacks are queued, move the object to the
+         * end of the worker queue, where other workers may steal it.
+         * Otherwise the queue reference is released below. */
+        if (!(queued = object->num_pending_callbacks > 1))
+            object->queued = FALSE;
+        else
+        {
+            tp_object_push( object, worker );
+            tp_threadpool_wake( pool );
+        }
+
+        tp_object_execute( object, FALSE );
+        RtlReleaseSRWLockExclusive( &object->lock );
+
+        tp_object_release( object );
+    }
+    else
+    {
+        queued = object->queued = FALSE;
+        RtlReleaseSRWLockExclusive( &object->lock );
+    }
+
+    assert( pool->num_busy_workers );
+    InterlockedDecrement( &pool->num_busy_workers );
+
+    if (!queued) tp_object_release( object );
+}
+
+/***********************************************************************
+ *           tp_worker_wait    (internal)
+ *
+ * Waits for new objects to be queued, returns FALSE if the timeout expired.
+ */
+static BOOL tp_worker_wait( struct threadpool *pool )
+{
+    LARGE_INTEGER timeout;
+    NTSTATUS status = STATUS_SUCCESS;
+    LONG wake_count;
+
+    /* Objects are queued before wake_count is incremented, and num_idle_workers
+     * is checked afterwards, so that no wake up can be missed. */
+    InterlockedIncrement( &pool->num_idle_workers );
+    wake_count = ReadNoFence( &pool->wake_count );
+    if (!threadpool_has_queued_objects( pool ) && !pool->shutdown)
+    {
+        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+        status = RtlWaitOnAddress( &pool->wake_count, &wake_count, sizeof(wake_count), &timeout );
+    }
+    InterlockedDecrement( &pool->num_idle_workers );
+
+    return status != STATUS_TIMEOUT;
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
 static void CALLBACK threadpool_worker_proc( void *param )
 {
     struct threadpool *pool = param;
-    LARGE_INTEGER timeout;
-    struct list *ptr;
+    struct threadpool_object *object;
+    struct threadpool_worker worker;
+    unsigned int i;
 
     TRACE( "starting worker thread for pool %p\n", pool );
     set_thread_name(L"wine_threadpool_worker");
 
-    enter_critical_section( &pool->cs );
-    for (;;)
+    RtlInitializeSRWLock( &worker.lock );
+    for (i = 0; i < ARRAY_SIZE(worker.queues); ++i)
     {
-        while ((ptr = threadpool_get_next_item( pool )))
-        {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
-
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (object->num_pending_callbacks > 1)
-                tp_object_prio_queue( object );
-
-            tp_object_execute( object, FALSE );
+        list_init( &worker.queues[i] );
+        worker.count[i] = 0;
+    }
 
-            assert(pool->num_busy_workers);
-            pool->num_busy_workers--;
+    RtlAcquireSRWLockExclusive( &pool->workers_lock );
+    list_add_tail( &pool->workers, &worker.entry );
+    RtlReleaseSRWLockExclusive( &pool->workers_lock );
 
-            tp_object_release( object );
-        }
+    for (;;)
+    {
+        while ((object = tp_worker_get_next_object( pool, &worker )))
+            tp_worker_process_object( &worker, object );
 
         /* Shutdown worker thread if requested. */
         if (pool->shutdown)
+        {
+            enter_critical_section( &pool->cs );
+            pool->num_workers--;
             break;
+        }
 
         /* Wait for new tasks or until the timeout expires. A thread only terminates
          * when no new tasks are available, and the number of threads can be
          * decreased without violating the min_workers limit. An exception is when
          * min_workers == 0, then objcount is used to detect if the last thread
          * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+        if (tp_worker_wait( pool )) continue;
+
+        enter_critical_section( &pool->cs );
+        if (!threadpool_has_queued_objects( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
-            break;
+            /* tp_object_queue() checks num_workers without holding the pool lock
+             * after queuing an object. Recheck once the decrement is visible, so
+             * that either it starts a new worker, or we process the object. */
+            InterlockedDecrement( &pool->num_workers );
+            if (!threadpool_has_queued_objects( pool )) break;
+            InterlockedIncrement( &pool->num_workers );
         }
+        leave_critical_section( &pool->cs );
     }
-    pool->num_workers--;
     leave_critical_section( &pool->cs );
 
+    /* Our queues are empty, and only this thread adds objects to them. */
+    RtlAcquireSRWLockExclusive( &pool->workers_lock );
+    list_remove( &worker.entry );
+    RtlReleaseSRWLockExclusive( &pool->workers_lock );
+
     TRACE( "terminating worker thread for pool %p\n", pool );
     tp_threadpool_release( pool );
     RtlExitUserThread( 0 );
@@ -2577,7 +2881,7 @@ void WINAPI TpCancelAsyncIoOperation( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlAcquireSRWLockExclusive( &this->lock );
 
     TRACE("pending_count %u.\n", this->u.io.pending_count);
 
@@ -2587,7 +2891,7 @@ void WINAPI TpCancelAsyncIoOperation( TP_IO *io )
     if (object_is_finished( this, FALSE ))
         RtlWakeAllConditionVariable( &this->finished_event );
 
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlReleaseSRWLockExclusive( &this->lock );
 }
 
 /***********************************************************************
@@ -2707,7 +3011,6 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
-    struct threadpool *pool;
 
     TRACE( "%p\n", instance );
 
@@ -2720,14 +3023,13 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     if (!this->associated)
         return;
 
-    pool = object->pool;
-    enter_critical_section( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
 
     object->num_associated_callbacks--;
     if (object_is_finished( object, FALSE ))
         RtlWakeAllConditionVariable( &object->finished_event );
 
-    leave_critical_section( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
     this->associated = FALSE;
 }
 
@@ -2851,10 +3153,10 @@ void WINAPI TpReleaseIoCompletion( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlAcquireSRWLockExclusive( &this->lock );
     this->u.io.shutting_down = TRUE;
     can_destroy = !this->u.io.pending_count && !this->u.io.skipped_count;
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlReleaseSRWLockExclusive( &this->lock );
 
     if (can_destroy)
     {
@@ -3132,11 +3434,11 @@ void WINAPI TpStartAsyncIoOperation( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlAcquireSRWLockExclusive( &this->lock );
 
     this->u.io.pending_count++;
 
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlReleaseSRWLockExclusive( &this->lock );
 }
 
 /***********************************************************************
@@ -3328,11 +3630,11 @@ NTSTATUS WINAPI RtlDeregisterWaitEx( HANDLE handle, HANDLE event )
         object->completed_event = event;
     }
 
-    RtlEnterCriticalSection( &object->pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
     if (object->num_pending_callbacks + object->num_running_callbacks
         + object->num_associated_callbacks) status = STATUS_PENDING;
     else status = STATUS_SUCCESS;
-    RtlLeaveCriticalSection( &object->pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
 
     TpReleaseWait( (TP_WAIT *)object );
     return status;
@@ -54,6 +54,8 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #ifdef HAVE_SYS_ATTR_H
 #include <sys/attr.h>
 #endif
@@ -86,6 +88,12 @@
 #ifdef HAVE_LINUX_IOCTL_H
 #include <linux/ioctl.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
@@ -2911,6 +2919,273 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/* Process-wide cache of directory contents used for case-insensitive lookups.
+ * Entries are indexed by directory identity, and validated against the
+ * directory modification time on every lookup. The names are stored in the
+ * same format as for NtQueryDirectoryFile. */
+
+struct dir_name_cache
+{
+    struct list           entry;       /* entry in LRU list */
+    struct list           hash_entry;  /* entry in identity hash table */
+    struct file_identity  id;          /* directory identity */
+    struct timespec       mtime;       /* directory modification time when it was read */
+    struct dir_data      *data;        /* directory names */
+    unsigned int          hash_mask;   /* size of the hash tables minus one */
+    unsigned int         *long_hash;   /* hash table of long names, index + 1 in data->names */
+    unsigned int         *short_hash;  /* hash table of short names, index + 1 in data->names */
+    BOOL                  short_names; /* whether short names were generated */
+};
+
+#define DIR_NAME_CACHE_HASH_SIZE 256
+
+static struct list dir_name_cache_lru = LIST_INIT( dir_name_cache_lru );
+static struct list dir_name_cache_hash[DIR_NAME_CACHE_HASH_SIZE];
+static unsigned int dir_name_cache_count;  /* number of cached directories */
+static unsigned int dir_name_cache_names;  /* total number of cached names */
+static const unsigned int dir_name_cache_max_count = 1024;
+static const unsigned int dir_name_cache_max_names = 1 << 20;
+static pthread_mutex_t dir_name_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int hash_name_nocase( const WCHAR *name, int length )
+{
+    unsigned int hash = 0;
+    while (length--) hash = hash * 31 + ntdll_towupper( *name++ );
+    return hash;
+}
+
+/* get the hash bucket for a directory; dir_name_cache_mutex must be held */
+static struct list *get_dir_name_cache_bucket( const struct stat *st )
+{
+    static BOOL initialized;
+
+    if (!initialized)
+    {
+        unsigned int i;
+        for (i = 0; i < DIR_NAME_CACHE_HASH_SIZE; i++) list_init( &dir_name_cache_hash[i] );
+        initialized = TRUE;
+    }
+    return &dir_name_cache_hash[(st->st_ino ^ st->st_dev) % DIR_NAME_CACHE_HASH_SIZE];
+}
+
+static void get_mtime_timespec( const struct stat *st, struct timespec *ts )
+{
+    ts->tv_sec = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    ts->tv_nsec = st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    ts->tv_nsec = st->st_mtimespec.tv_nsec;
+#else
+    ts->tv_nsec = 0;
+#endif
+}
+
+static void free_dir_name_cache( struct dir_name_cache *cache )
+{
+    free_dir_data( cache->data );
+    free( cache );
+}
+
+/* remove an entry from the cache; dir_name_cache_mutex must be held */
+static void remove_dir_name_cache( struct dir_name_cache *cache )
+{
+    list_remove( &cache->entry );
+    list_remove( &cache->hash_entry );
+    dir_name_cache_count--;
+    dir_name_cache_names -= cache->data->count;
+    free_dir_name_cache( cache );
+}
+
+static void insert_name_hash( unsigned int *table, unsigned int mask, const WCHAR *name, unsigned int index )
+{
+    unsigned int hash = hash_name_nocase( name, wcslen( name ));
+    while (table[hash & mask]) hash++;
+    table[hash & mask] = index + 1;
+}
+
+/* read the contents of a directory and build its name hash tables; short names
+ * are expensive to generate, so only do it when they may be needed */
+static struct dir_name_cache *create_dir_name_cache( const char *dirname, const struct stat *st,
+                                                     BOOL short_names )
+{
+    struct dir_name_cache *cache;
+    struct dir_data *data;
+    struct dirent *de;
+    unsigned int i, size;
+    DIR *dir;
+
+    if (!(data = calloc( 1, sizeof(*data) ))) return NULL;
+
+#ifdef VFAT_IOCTL_READDIR_BOTH
+    {
+        int fd = open( dirname, O_RDONLY | O_DIRECTORY );
+        NTSTATUS status = STATUS_NOT_SUPPORTED;
+
+        if (fd != -1)
+        {
+            status = read_directory_data_vfat( data, fd, NULL );
+            close( fd );
+        }
+        if (!status)
+        {
+            short_names = TRUE;
+            goto done;
+        }
+        if (status != STATUS_NOT_SUPPORTED) goto failed;
+    }
+#endif
+
+    if (!(dir = opendir( dirname ))) goto failed;
+    while ((de = readdir( dir )))
+    {
+        if (!append_entry( data, de->d_name, short_names ? NULL : "", NULL ))
+        {
+            closedir( dir );
+            goto failed;
+        }
+    }
+    closedir( dir );
+
+#ifdef VFAT_IOCTL_READDIR_BOTH
+done:
+#endif
+    for (size = 16; size < data->count * 2; size *= 2) ;
+    if (!(cache = calloc( 1, sizeof(*cache) + 2 * size * sizeof(unsigned int) ))) goto failed;
+    cache->id.dev     = st->st_dev;
+    cache->id.ino     = st->st_ino;
+    cache->data       = data;
+    cache->hash_mask  = size - 1;
+    cache->long_hash  = (unsigned int *)(cache + 1);
+    cache->short_hash = cache->long_hash + size;
+    cache->short_names = short_names;
+    get_mtime_timespec( st, &cache->mtime );
+
+    for (i = 0; i < data->count; i++)
+    {
+        insert_name_hash( cache->long_hash, cache->hash_mask, data->names[i].long_name, i );
+        if (data->names[i].short_name[0])
+            insert_name_hash( cache->short_hash, cache->hash_mask, data->names[i].short_name, i );
+    }
+    return cache;
+
+failed:
+    free_dir_data( data );
+    return NULL;
+}
+
+static const struct dir_data_names *find_name_hash( const struct dir_name_cache *cache, const unsigned int *table,
+                                                    BOOL short_name, const WCHAR *name, int length )
+{
+    const struct dir_data_names *names;
+    unsigned int index, hash = hash_name_nocase( name, length );
+
+    for (; (index = table[hash & cache->hash_mask]); hash++)
+    {
+        const WCHAR *str;
+
+        names = &cache->data->names[index - 1];
+        str = short_name ? names->short_name : names->long_name;
+        if (!wcsnicmp( str, name, length ) && !str[length]) return names;
+    }
+    return NULL;
+}
+
+/* look up a name in a cached directory; the file found is appended to unix_name at pos
+ * returns STATUS_NOT_SUPPORTED if short names are needed but were not generated */
+static NTSTATUS find_dir_name_cache( const struct dir_name_cache *cache, char *unix_name, int pos,
+                                     const WCHAR *name, int length, BOOLEAN check_short )
+{
+    const struct dir_data_names *names;
+
+    if (!(names = find_name_hash( cache, cache->long_hash, FALSE, name, length )) && check_short)
+    {
+        if (!cache->short_names) return STATUS_NOT_SUPPORTED;
+        names = find_name_hash( cache, cache->short_hash, TRUE, name, length );
+    }
+    if (!names) return STATUS_OBJECT_NAME_NOT_FOUND;
+
+    unix_name[pos - 1] = '/';
+    strcpy( unix_name + pos, names->unix_name );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           lookup_dir_name_cache
+ *
+ * Case-insensitive search of a name in a directory through the directory
+ * name cache. The directory name is in unix_name, terminated at pos - 1.
+ * Returns STATUS_NOT_SUPPORTED if the cache can't be used.
+ */
+static NTSTATUS lookup_dir_name_cache( char *unix_name, int pos, const WCHAR *name, int length,
+                                       BOOLEAN check_short )
+{
+    struct dir_name_cache *cache, *new_cache;
+    struct list *bucket;
+    struct timespec mtime;
+    struct stat st;
+    NTSTATUS status;
+
+    if (stat( unix_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return STATUS_NOT_SUPPORTED;
+    get_mtime_timespec( &st, &mtime );
+
+    mutex_lock( &dir_name_cache_mutex );
+    bucket = get_dir_name_cache_bucket( &st );
+    LIST_FOR_EACH_ENTRY( cache, bucket, struct dir_name_cache, hash_entry )
+    {
+        if (cache->id.dev != st.st_dev || cache->id.ino != st.st_ino) continue;
+        if (cache->mtime.tv_sec == mtime.tv_sec && cache->mtime.tv_nsec == mtime.tv_nsec)
+        {
+            list_remove( &cache->entry );
+            list_add_head( &dir_name_cache_lru, &cache->entry );
+            status = find_dir_name_cache( cache, unix_name, pos, name, length, check_short );
+            if (status != STATUS_NOT_SUPPORTED)
+            {
+                mutex_unlock( &dir_name_cache_mutex );
+                return status;
+            }
+            TRACE( "%s needs short names, reading it again\n", debugstr_a(unix_name) );
+        }
+        else TRACE( "%s changed, discarding cached names\n", debugstr_a(unix_name) );
+        remove_dir_name_cache( cache );
+        break;
+    }
+    mutex_unlock( &dir_name_cache_mutex );
+
+    /* a directory modified within the last second may be modified again without
+     * its timestamp changing; don't cache it until it's been stable for a while,
+     * and let the caller scan it directly instead of reading all of it */
+    if (time( NULL ) <= mtime.tv_sec + 1) return STATUS_NOT_SUPPORTED;
+
+    if (!(new_cache = create_dir_name_cache( unix_name, &st, check_short ))) return STATUS_NOT_SUPPORTED;
+    status = find_dir_name_cache( new_cache, unix_name, pos, name, length, check_short );
+
+    if (new_cache->data->count > dir_name_cache_max_names)
+    {
+        free_dir_name_cache( new_cache );
+        return status;
+    }
+
+    mutex_lock( &dir_name_cache_mutex );
+    LIST_FOR_EACH_ENTRY( cache, bucket, struct dir_name_cache, hash_entry )
+    {
+        if (cache->id.dev != st.st_dev || cache->id.ino != st.st_ino) continue;
+        /* someone else cached it in the meantime */
+        remove_dir_name_cache( cache );
+        break;
+    }
+    list_add_head( &dir_name_cache_lru, &new_cache->entry );
+    list_add_head( bucket, &new_cache->hash_entry );
+    dir_name_cache_count++;
+    dir_name_cache_names += new_cache->data->count;
+    while (dir_name_cache_count > dir_name_cache_max_count || dir_name_cache_names > dir_name_cache_max_names)
+        remove_dir_name_cache( LIST_ENTRY( list_tail( &dir_name_cache_lru ), struct dir_name_cache, entry ));
+    mutex_unlock( &dir_name_cache_mutex );
+
+    TRACE( "cached %u names for %s\n", new_cache->data->count, debugstr_a(unix_name) );
+    return status;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2951,6 +3226,18 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 
     if (!is_name_8_dot_3 && !get_dir_case_sensitivity( unix_name )) goto not_found;
 
+    /* try the directory name cache first */
+
+    switch (lookup_dir_name_cache( unix_name, pos, name, length, is_name_8_dot_3 ))
+    {
+    case STATUS_SUCCESS:
+        return STATUS_SUCCESS;
+    case STATUS_OBJECT_NAME_NOT_FOUND:
+        goto not_found;
+    default:
+        break;
+    }
+
     /* now look for it through the directory */
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
@@ -6377,11 +6664,31 @@ static unsigned int set_pending_write( HANDLE device )
     return status;
 }
 
+/* Overlapped reads on regular files are completed by helper threads, so that the
+ * caller never blocks on the disk. When the kernel supports io_uring, callers submit
+ * their reads directly to a ring and a single thread reaps the completions in batches;
+ * otherwise a small pool of worker threads performs the reads. In both cases the data
+ * is read straight into the caller's buffer. */
+
+#define ASYNC_FILE_READ_MAX_THREADS 8
+#define ASYNC_FILE_READ_BATCH       32
+#define ASYNC_FILE_READ_RING_SIZE   256
+
 static pthread_mutex_t async_file_read_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t async_file_read_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t async_file_read_done_cond = PTHREAD_COND_INITIALIZER;
+
+enum async_file_read_state
+{
+    ASYNC_READ_PENDING,    /* not yet started, can still be completed by a cancel */
+    ASYNC_READ_RUNNING,    /* read in progress into the caller's buffer */
+    ASYNC_READ_CANCELLED,  /* cancelled while running, to be completed with STATUS_CANCELLED */
+    ASYNC_READ_COMPLETED   /* completion claimed by the reader or the cancel */
+};
 
 struct async_file_read_job
 {
+    struct list entry;     /* entry in queue, running or free list */
     HANDLE handle;
     int unix_handle;
     int needs_close;
@@ -6391,14 +6698,15 @@ struct async_file_read_job
     ULONG length;
     LARGE_INTEGER offset;
     DWORD thread_id;
-    LONG  cancelled;
-    struct list queue_entry;
-    struct async_file_read_job *next;
+    LONG  state;
+    struct iovec iov;
 };
 
-
 static struct list async_file_read_queue = LIST_INIT( async_file_read_queue );
-static struct async_file_read_job *async_file_read_running, *async_file_read_free;
+static struct list async_file_read_running = LIST_INIT( async_file_read_running );
+static struct list async_file_read_free = LIST_INIT( async_file_read_free );
+static unsigned int async_file_read_queued;
+static unsigned int async_file_read_threads;
 
 static void async_file_complete_io( struct async_file_read_job *job, NTSTATUS status, ULONG total )
 {
@@ -6408,116 +6716,340 @@ static void async_file_complete_io( struct async_file_read_job *job, NTSTATUS st
     if (job->event) NtSetEvent( job->event, NULL );
 }
 
-static void *async_file_read_thread(void *dummy)
+static BOOL async_file_read_match( struct async_file_read_job *job, HANDLE handle, IO_STATUS_BLOCK *io,
+                                   DWORD thread_id )
+{
+    if (io) return job->io == io;
+    return job->handle == handle && job->thread_id == thread_id;
+}
+
+/* complete a job once its read has finished; result and err are the pread() return value and errno */
+static void async_file_read_finish( struct async_file_read_job *job, int result, int err )
 {
-    struct async_file_read_job *job, *ptr;
-    ULONG buffer_length = 0;
-    void *buffer = NULL;
-    struct list *entry;
     NTSTATUS status;
-    ULONG total;
+    ULONG total = 0;
+
+    if (result == -1 && (err == EFAULT || err == EAGAIN || err == EINTR)
+        && job->state == ASYNC_READ_RUNNING)
+    {
+        /* the buffer may be write-watched, retry through the virtual memory manager */
+        while ((result = virtual_locked_pread( job->unix_handle, job->buffer, job->length,
+                                               job->offset.QuadPart )) == -1 && errno == EINTR)
+            if (job->state != ASYNC_READ_RUNNING) break;
+        err = errno;
+    }
+    if (job->needs_close) close( job->unix_handle );
+
+    if (InterlockedCompareExchange( &job->state, ASYNC_READ_COMPLETED, ASYNC_READ_RUNNING ))
+    {
+        async_file_complete_io( job, STATUS_CANCELLED, 0 );
+        return;
+    }
+
+    if (result == -1) status = errno_to_status( err );
+    else
+    {
+        total = result;
+        status = (total || !job->length) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    async_file_complete_io( job, status, total );
+}
+
+/* move finished jobs back to the free list; must be called with the mutex held */
+static void async_file_read_release( struct async_file_read_job **jobs, unsigned int count )
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+    {
+        list_remove( &jobs[i]->entry );
+        list_add_head( &async_file_read_free, &jobs[i]->entry );
+    }
+    pthread_cond_broadcast( &async_file_read_done_cond );
+}
+
+static void *async_file_read_worker( void *arg )
+{
+    struct async_file_read_job *jobs[ASYNC_FILE_READ_BATCH];
+    unsigned int i, count, max_count;
+    struct list *entry;
     int result;
 
     pthread_mutex_lock( &async_file_read_mutex );
-    while (1)
+    for (;;)
     {
-        while (!(entry = list_head( &async_file_read_queue )))
-        {
+        while (list_empty( &async_file_read_queue ))
             pthread_cond_wait( &async_file_read_cond, &async_file_read_mutex );
-            continue;
-        }
-
-        job = LIST_ENTRY( entry, struct async_file_read_job, queue_entry );
-        list_remove( entry );
 
-        total = 0;
-
-        if ( job->cancelled )
+        /* take a fair share of the queue, so that the other workers get some too */
+        max_count = (async_file_read_queued + async_file_read_threads - 1) / async_file_read_threads;
+        max_count = min( max_count, ASYNC_FILE_READ_BATCH );
+        for (count = 0; count < max_count && (entry = list_head( &async_file_read_queue )); count++)
         {
-            pthread_mutex_unlock( &async_file_read_mutex );
-            status = STATUS_CANCELLED;
-            goto done;
+            jobs[count] = LIST_ENTRY( entry, struct async_file_read_job, entry );
+            list_remove( entry );
+            list_add_tail( &async_file_read_running, entry );
         }
-
-        job->next = async_file_read_running;
-        async_file_read_running = job;
+        async_file_read_queued -= count;
+        if (!list_empty( &async_file_read_queue )) pthread_cond_signal( &async_file_read_cond );
         pthread_mutex_unlock( &async_file_read_mutex );
 
-        if (!buffer_length)
+        for (i = 0; i < count; i++)
         {
-            buffer = malloc(job->length);
-            buffer_length = job->length;
-        }
-        else if (buffer_length < job->length)
-        {
-            buffer = realloc(buffer, job->length);
-            buffer_length = job->length;
+            struct async_file_read_job *job = jobs[i];
+
+            /* a job cancelled while waiting in the batch has already been completed */
+            if (InterlockedCompareExchange( &job->state, ASYNC_READ_RUNNING, ASYNC_READ_PENDING ))
+                continue;
+            while ((result = virtual_locked_pread( job->unix_handle, job->buffer, job->length,
+                                                   job->offset.QuadPart )) == -1 && errno == EINTR)
+                if (job->state != ASYNC_READ_RUNNING) break;
+            async_file_read_finish( job, result, errno );
         }
 
-        while ((result = pread( job->unix_handle, buffer, job->length, job->offset.QuadPart )) == -1)
+        pthread_mutex_lock( &async_file_read_mutex );
+        async_file_read_release( jobs, count );
+    }
+    return NULL;
+}
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+
+static struct
+{
+    int fd;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int sq_mask;
+    unsigned int sq_entries;
+    unsigned int *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int cq_mask;
+    unsigned int cq_entries;
+    struct io_uring_cqe *cqes;
+    unsigned int inflight;
+} async_file_read_ring = { -1 };
+
+static BOOL async_file_read_ring_init(void)
+{
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *sq_ptr, *cq_ptr;
+    void *sqes;
+    int fd;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = syscall( __NR_io_uring_setup, ASYNC_FILE_READ_RING_SIZE, &params )) == -1)
+    {
+        TRACE( "io_uring not available, errno %d\n", errno );
+        return FALSE;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) sq_size = cq_size = max( sq_size, cq_size );
+
+    sq_ptr = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if (sq_ptr == MAP_FAILED) goto failed;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) cq_ptr = sq_ptr;
+    else if ((cq_ptr = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_CQ_RING )) == MAP_FAILED)
+    {
+        munmap( sq_ptr, sq_size );
+        goto failed;
+    }
+    sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if (sqes == MAP_FAILED)
+    {
+        if (cq_ptr != sq_ptr) munmap( cq_ptr, cq_size );
+        munmap( sq_ptr, sq_size );
+        goto failed;
+    }
+
+    async_file_read_ring.fd         = fd;
+    async_file_read_ring.sq_head    = (unsigned int *)(sq_ptr + params.sq_off.head);
+    async_file_read_ring.sq_tail    = (unsigned int *)(sq_ptr + params.sq_off.tail);
+    async_file_read_ring.sq_mask    = *(unsigned int *)(sq_ptr + params.sq_off.ring_mask);
+    async_file_read_ring.sq_entries = params.sq_entries;
+    async_file_read_ring.sq_array   = (unsigned int *)(sq_ptr + params.sq_off.array);
+    async_file_read_ring.sqes       = sqes;
+    async_file_read_ring.cq_head    = (unsigned int *)(cq_ptr + params.cq_off.head);
+    async_file_read_ring.cq_tail    = (unsigned int *)(cq_ptr + params.cq_off.tail);
+    async_file_read_ring.cq_mask    = *(unsigned int *)(cq_ptr + params.cq_off.ring_mask);
+    async_file_read_ring.cq_entries = params.cq_entries;
+    async_file_read_ring.cqes       = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    return TRUE;
+
+failed:
+    WARN( "failed to map io_uring, errno %d\n", errno );
+    close( fd );
+    return FALSE;
+}
+
+/* complete the jobs that the kernel refused to consume with an error; must be called with the mutex held */
+static void async_file_read_ring_fail( unsigned int tail, int err )
+{
+    struct async_file_read_job *jobs[ASYNC_FILE_READ_BATCH];
+    unsigned int head = *async_file_read_ring.sq_head, count = 0;
+
+    WARN( "io_uring_enter failed, errno %d\n", err );
+
+    /* without SQPOLL the kernel only reads the ring in io_uring_enter, so the entries can be taken back */
+    __atomic_store_n( async_file_read_ring.sq_tail, head, __ATOMIC_RELEASE );
+    while (head != tail)
+    {
+        unsigned int index = async_file_read_ring.sq_array[head++ & async_file_read_ring.sq_mask];
+
+        jobs[count] = (struct async_file_read_job *)(ULONG_PTR)async_file_read_ring.sqes[index].user_data;
+        async_file_read_finish( jobs[count], -1, err );
+        if (++count == ASYNC_FILE_READ_BATCH || head == tail)
         {
-            if (errno != EINTR)
-            {
-                status = errno_to_status( errno );
-                goto done;
-            }
-            if (job->cancelled)
-                break;
+            async_file_read_ring.inflight -= count;
+            async_file_read_release( jobs, count );
+            count = 0;
         }
+    }
+}
 
-        total = result;
-        status = (total || !job->length) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
-done:
-        if (job->needs_close) close( job->unix_handle );
+/* move queued jobs to the submission ring; must be called with the mutex held */
+static void async_file_read_ring_submit(void)
+{
+    unsigned int tail = *async_file_read_ring.sq_tail, count = 0;
+    struct io_uring_sqe *sqe;
+    struct list *entry;
 
-        if (!InterlockedCompareExchange(&job->cancelled, 1, 0))
-        {
-            if (status == STATUS_SUCCESS)
-                memcpy( job->buffer, buffer, total );
+    while (async_file_read_ring.inflight + count < async_file_read_ring.cq_entries
+           && tail - __atomic_load_n( async_file_read_ring.sq_head, __ATOMIC_ACQUIRE ) < async_file_read_ring.sq_entries
+           && (entry = list_head( &async_file_read_queue )))
+    {
+        struct async_file_read_job *job = LIST_ENTRY( entry, struct async_file_read_job, entry );
+        unsigned int index = tail & async_file_read_ring.sq_mask;
 
-            async_file_complete_io( job, status, total );
+        list_remove( entry );
+        list_add_tail( &async_file_read_running, entry );
+
+        job->state = ASYNC_READ_RUNNING;  /* the kernel owns the buffer once submitted */
+        job->iov.iov_base = job->buffer;
+        job->iov.iov_len  = job->length;
+        sqe = &async_file_read_ring.sqes[index];
+        memset( sqe, 0, sizeof(*sqe) );
+        sqe->opcode    = IORING_OP_READV;
+        sqe->fd        = job->unix_handle;
+        sqe->off       = job->offset.QuadPart;
+        sqe->addr      = (ULONG_PTR)&job->iov;
+        sqe->len       = 1;
+        sqe->user_data = (ULONG_PTR)job;
+        async_file_read_ring.sq_array[index] = index;
+        tail++;
+        count++;
+    }
+    if (count)
+    {
+        async_file_read_queued -= count;
+        async_file_read_ring.inflight += count;
+        __atomic_store_n( async_file_read_ring.sq_tail, tail, __ATOMIC_RELEASE );
+    }
+
+    /* also submit the entries that previous calls failed to get consumed */
+    while ((count = tail - __atomic_load_n( async_file_read_ring.sq_head, __ATOMIC_ACQUIRE )))
+    {
+        if (syscall( __NR_io_uring_enter, async_file_read_ring.fd, count, 0, 0, NULL, 0 ) != -1) continue;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EBUSY)
+        {
+            /* the reaper submits them again when the reads in flight complete */
+            if (async_file_read_ring.inflight > count) return;
+            sched_yield();
+            continue;
         }
+        async_file_read_ring_fail( tail, errno );
+        return;
+    }
+}
 
-        pthread_mutex_lock( &async_file_read_mutex );
+static void *async_file_read_reaper( void *arg )
+{
+    struct async_file_read_job *jobs[ASYNC_FILE_READ_BATCH];
+    unsigned int head, tail, count;
+    struct io_uring_cqe *cqe;
 
-        if (status != STATUS_CANCELLED)
+    for (;;)
+    {
+        if (syscall( __NR_io_uring_enter, async_file_read_ring.fd, 0, 1,
+                     IORING_ENTER_GETEVENTS, NULL, 0 ) == -1 && errno != EINTR)
         {
-            ptr = async_file_read_running;
-            if (job == ptr)
+            ERR( "io_uring_enter failed, errno %d\n", errno );
+            usleep( 1000 );
+            continue;
+        }
+
+        head = *async_file_read_ring.cq_head;
+        tail = __atomic_load_n( async_file_read_ring.cq_tail, __ATOMIC_ACQUIRE );
+        while (head != tail)
+        {
+            for (count = 0; head != tail && count < ASYNC_FILE_READ_BATCH; head++, count++)
             {
-                async_file_read_running = job->next;
+                cqe = &async_file_read_ring.cqes[head & async_file_read_ring.cq_mask];
+                jobs[count] = (struct async_file_read_job *)(ULONG_PTR)cqe->user_data;
+                if (cqe->res < 0) async_file_read_finish( jobs[count], -1, -cqe->res );
+                else async_file_read_finish( jobs[count], cqe->res, 0 );
             }
-            else
-            {
-                while (ptr && ptr->next != job)
-                    ptr = ptr->next;
+            __atomic_store_n( async_file_read_ring.cq_head, head, __ATOMIC_RELEASE );
 
-                assert( ptr );
-                ptr->next = job->next;
-            }
-        }
+            pthread_mutex_lock( &async_file_read_mutex );
+            async_file_read_ring.inflight -= count;
+            async_file_read_release( jobs, count );
+            async_file_read_ring_submit();
+            pthread_mutex_unlock( &async_file_read_mutex );
 
-        job->next = async_file_read_free;
-        async_file_read_free = job;
+            tail = __atomic_load_n( async_file_read_ring.cq_tail, __ATOMIC_ACQUIRE );
+        }
     }
-
     return NULL;
 }
 
+#else
+
+static BOOL async_file_read_ring_init(void) { return FALSE; }
+static void async_file_read_ring_submit(void) { }
+static void *async_file_read_reaper( void *arg ) { return NULL; }
+
+#endif
+
+static BOOL async_file_read_use_ring;
 static pthread_once_t async_file_read_once = PTHREAD_ONCE_INIT;
 
 static void async_file_read_init(void)
 {
-    pthread_t async_file_read_thread_id;
+    pthread_t thread_id;
     pthread_attr_t pthread_attr;
-
-    ERR("HACK: AC Odyssey async read workaround.\n");
+    unsigned int i;
 
     pthread_attr_init( &pthread_attr );
     pthread_attr_setscope( &pthread_attr, PTHREAD_SCOPE_SYSTEM );
     pthread_attr_setdetachstate( &pthread_attr, PTHREAD_CREATE_DETACHED );
 
-    pthread_create( &async_file_read_thread_id, &pthread_attr, (void * (*)(void *))async_file_read_thread, NULL);
+    if ((async_file_read_use_ring = async_file_read_ring_init()))
+    {
+        if (!pthread_create( &thread_id, &pthread_attr, async_file_read_reaper, NULL ))
+        {
+            TRACE( "using io_uring for async file reads\n" );
+            pthread_attr_destroy( &pthread_attr );
+            return;
+        }
+        async_file_read_use_ring = FALSE;
+    }
+
+    async_file_read_threads = min( max( peb->NumberOfProcessors, 2 ), ASYNC_FILE_READ_MAX_THREADS );
+    for (i = 0; i < async_file_read_threads; i++)
+    {
+        if (pthread_create( &thread_id, &pthread_attr, async_file_read_worker, NULL )) break;
+    }
+    if (!(async_file_read_threads = i)) ERR( "failed to create async file read threads\n" );
+    TRACE( "using %u threads for async file reads\n", async_file_read_threads );
     pthread_attr_destroy( &pthread_attr );
 }
 
@@ -6525,25 +7057,24 @@ static NTSTATUS queue_async_file_read( HANDLE handle, int unix_handle, int needs
                             IO_STATUS_BLOCK *io, void *buffer, ULONG length, LARGE_INTEGER *offset )
 {
     struct async_file_read_job *job;
+    struct list *entry;
 
     pthread_once( &async_file_read_once, async_file_read_init );
+    if (!async_file_read_use_ring && !async_file_read_threads) return STATUS_NO_MEMORY;
 
     NtResetEvent( event, NULL );
 
     pthread_mutex_lock( &async_file_read_mutex );
 
-    if (async_file_read_free)
+    if ((entry = list_head( &async_file_read_free )))
     {
-        job = async_file_read_free;
-        async_file_read_free = async_file_read_free->next;
+        job = LIST_ENTRY( entry, struct async_file_read_job, entry );
+        list_remove( entry );
     }
-    else
+    else if (!(job = malloc( sizeof(*job) )))
     {
-        if (!(job = malloc( sizeof(*job) )))
-        {
-            pthread_mutex_unlock( &async_file_read_mutex );
-            return STATUS_NO_MEMORY;
-        }
+        pthread_mutex_unlock( &async_file_read_mutex );
+        return STATUS_NO_MEMORY;
     }
 
     job->handle = handle;
@@ -6555,11 +7086,13 @@ static NTSTATUS queue_async_file_read( HANDLE handle, int unix_handle, int needs
     job->length = length;
     job->offset = *offset;
     job->thread_id = GetCurrentThreadId();
-    job->cancelled = 0;
+    job->state = ASYNC_READ_PENDING;
 
-    list_add_tail( &async_file_read_queue, &job->queue_entry );
+    list_add_tail( &async_file_read_queue, &job->entry );
+    async_file_read_queued++;
 
-    pthread_cond_signal( &async_file_read_cond );
+    if (async_file_read_use_ring) async_file_read_ring_submit();
+    else pthread_cond_signal( &async_file_read_cond );
     pthread_mutex_unlock( &async_file_read_mutex );
 
     return STATUS_PENDING;
@@ -6568,35 +7101,52 @@ static NTSTATUS queue_async_file_read( HANDLE handle, int unix_handle, int needs
 static NTSTATUS cancel_async_file_read( HANDLE handle, IO_STATUS_BLOCK *io )
 {
     DWORD thread_id = GetCurrentThreadId();
-    struct async_file_read_job *job;
+    struct async_file_read_job *job, *next;
     unsigned int count = 0;
+    BOOL wait;
 
     TRACE( "handle %p, io %p.\n", handle, io );
 
     pthread_mutex_lock( &async_file_read_mutex );
-    job = async_file_read_running;
-    while (job)
+
+    LIST_FOR_EACH_ENTRY_SAFE( job, next, &async_file_read_queue, struct async_file_read_job, entry )
     {
-        if (((io && job->io == io)
-                || (!io && job->handle == handle && job->thread_id == thread_id))
-                && !InterlockedCompareExchange(&job->cancelled, 1, 0))
+        if (!async_file_read_match( job, handle, io, thread_id )) continue;
+        list_remove( &job->entry );
+        async_file_read_queued--;
+        if (job->needs_close) close( job->unix_handle );
+        async_file_complete_io( job, STATUS_CANCELLED, 0 );
+        list_add_head( &async_file_read_free, &job->entry );
+        ++count;
+    }
+
+    LIST_FOR_EACH_ENTRY( job, &async_file_read_running, struct async_file_read_job, entry )
+    {
+        if (!async_file_read_match( job, handle, io, thread_id )) continue;
+        if (!InterlockedCompareExchange( &job->state, ASYNC_READ_COMPLETED, ASYNC_READ_PENDING ))
         {
+            /* not started yet, the worker will skip it */
+            if (job->needs_close) close( job->unix_handle );
             async_file_complete_io( job, STATUS_CANCELLED, 0 );
             ++count;
         }
-        job = job->next;
+        else if (!InterlockedCompareExchange( &job->state, ASYNC_READ_CANCELLED, ASYNC_READ_RUNNING ))
+            ++count;
     }
 
-    LIST_FOR_EACH_ENTRY( job, &async_file_read_queue, struct async_file_read_job, queue_entry )
+    /* the reads are done in place, so wait until the buffers are no longer in use */
+    do
     {
-        if (((io && job->io == io)
-                || (!io && job->handle == handle && job->thread_id == thread_id))
-                && !InterlockedCompareExchange(&job->cancelled, 1, 0))
+        wait = FALSE;
+        LIST_FOR_EACH_ENTRY( job, &async_file_read_running, struct async_file_read_job, entry )
         {
-            async_file_complete_io( job, STATUS_CANCELLED, 0 );
-            ++count;
+            if (job->state != ASYNC_READ_CANCELLED || !async_file_read_match( job, handle, io, thread_id ))
+                continue;
+            wait = TRUE;
+            break;
         }
-    }
+        if (wait) pthread_cond_wait( &async_file_read_done_cond, &async_file_read_mutex );
+    } while (wait);
 
     pthread_mutex_unlock( &async_file_read_mutex );
     return count ? STATUS_SUCCESS : STATUS_NOT_FOUND;
@@ -6642,7 +7192,7 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
             goto done;
         }
 
-        if (ac_odyssey && async_read && length && event && !apc)
+        if (async_file_read && async_read && length && event && !apc)
         {
             status = queue_async_file_read( handle, unix_handle, needs_close, event, io, buffer, length, offset );
             needs_close = 0;
@@ -7474,7 +8024,7 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE handle, IO_STATUS_BLOCK *io_status )
 
     TRACE( "%p %p\n", handle, io_status );
 
-    if (ac_odyssey && !cancel_async_file_read( handle, NULL ))
+    if (async_file_read && !cancel_async_file_read( handle, NULL ))
         return (io_status->u.Status = STATUS_SUCCESS);
 
     SERVER_START_REQ( cancel_async )
@@ -7502,7 +8052,7 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE handle, IO_STATUS_BLOCK *io, IO_STATUS_
 
     TRACE( "%p %p %p\n", handle, io, io_status );
 
-    if (ac_odyssey && !cancel_async_file_read( handle, io ))
+    if (async_file_read && !cancel_async_file_read( handle, io ))
         return (io_status->u.Status = STATUS_SUCCESS);
 
     SERVER_START_REQ( cancel_async )
@@ -56,6 +56,7 @@
 #include "fsync.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(fsync);
+WINE_DECLARE_DEBUG_CHANNEL(fsync_cache);
 
 #include "pshpack4.h"
 #include "poppack.h"
@@ -167,8 +168,18 @@ struct fsync
 {
     enum fsync_type type;
     void *shm;              /* pointer to shm section */
+    unsigned int gen;       /* generation of the shm slot when the handle was cached */
 };
 
+/* common layout of all the shm slots, the first two fields depend on the type */
+struct fsync_slot
+{
+    int data[2];
+    int ref;                /* references held by the server object and by clients using it */
+    unsigned int gen;       /* generation, incremented every time the slot is reused */
+};
+C_ASSERT(sizeof(struct fsync_slot) == 16);
+
 struct semaphore
 {
     int count;
@@ -190,59 +201,136 @@ struct mutex
 };
 C_ASSERT(sizeof(struct mutex) == 8);
 
+/* Adaptive spinning, similar to glibc adaptive mutexes: before going to
+ * sleep, poll the futexes for a while in case they are about to change.
+ * The amount of spinning is tuned per object from how long it took to
+ * observe a change the previous times, and is capped by WINEFSYNC_SPINCOUNT.
+ * To avoid wasting CPU time when the system is oversubscribed, at most half
+ * of the CPUs may be spinning at any given time. */
+
+static unsigned int spin_count = 100;  /* maximum number of spin iterations */
+static int max_spinning_threads;
+static int spinning_threads;
+static short spin_hints[256];          /* per-object estimate of the needed spin iterations */
+
+static short *get_spin_hint( const void *shm )
+{
+    return &spin_hints[((UINT_PTR)shm / sizeof(struct fsync_slot)) % ARRAY_SIZE(spin_hints)];
+}
+
+/* spin until one of the futexes changes; returns FALSE if we should sleep instead */
+static BOOL spin_wait( const struct futex_waitv *futexes, int count, short *hint )
+{
+    unsigned int spin, max_spin;
+    int i;
+
+    if (!spin_count) return FALSE;
+
+    max_spin = min( spin_count, *hint * 2 + 10 );
+    if (__atomic_add_fetch( &spinning_threads, 1, __ATOMIC_RELAXED ) > max_spinning_threads)
+    {
+        __atomic_sub_fetch( &spinning_threads, 1, __ATOMIC_RELAXED );
+        return FALSE;
+    }
+
+    for (spin = 0; spin < max_spin; spin++)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (__atomic_load_n( (int *)u64_to_ptr( futexes[i].uaddr ), __ATOMIC_ACQUIRE ) != (int)futexes[i].val)
+                goto done;
+        }
+        YieldProcessor();
+    }
+
+done:
+    __atomic_sub_fetch( &spinning_threads, 1, __ATOMIC_RELAXED );
+    *hint += ((int)spin - *hint) / 8;
+    return spin < max_spin;
+}
+
 static char shm_name[29];
 static int shm_fd;
-static void **shm_addrs;
-static int shm_addrs_size;  /* length of the allocated shm_addrs array */
 static long pagesize;
 
-static pthread_mutex_t shm_addrs_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Both tables below are lock-free: blocks are allocated on demand and
+ * published with a compare-and-swap, and are never freed or moved, so that
+ * lookups only need atomic loads. */
 
-static void *get_shm( unsigned int idx )
+#define FSYNC_SHM_BLOCK_SIZE   1024   /* pages per block of the shm page table */
+#define FSYNC_SHM_BLOCKS       256
+
+static void **shm_addrs[FSYNC_SHM_BLOCKS];
+
+static void *alloc_table_block( void **block_ptr, size_t size )
 {
-    int entry  = (idx * 8) / pagesize;
-    int offset = (idx * 8) % pagesize;
-    void *ret;
+    void *block, *prev;
 
-    pthread_mutex_lock( &shm_addrs_mutex );
+    if ((block = __atomic_load_n( block_ptr, __ATOMIC_ACQUIRE ))) return block;
 
-    if (entry >= shm_addrs_size)
+    block = anon_mmap_alloc( size, PROT_READ | PROT_WRITE );
+    if (block == MAP_FAILED) return NULL;
+    if ((prev = __sync_val_compare_and_swap( block_ptr, NULL, block )))
     {
-        int new_size = max(shm_addrs_size * 2, entry + 1);
+        munmap( block, size ); /* someone beat us to it */
+        return prev;
+    }
+    return block;
+}
 
-        if (!(shm_addrs = realloc( shm_addrs, new_size * sizeof(shm_addrs[0]) )))
-            ERR("Failed to grow shm_addrs array to size %d.\n", shm_addrs_size);
-        memset( shm_addrs + shm_addrs_size, 0, (new_size - shm_addrs_size) * sizeof(shm_addrs[0]) );
-        shm_addrs_size = new_size;
+static void *get_shm( unsigned int idx )
+{
+    unsigned int entry  = (idx * sizeof(struct fsync_slot)) / pagesize;
+    unsigned int offset = (idx * sizeof(struct fsync_slot)) % pagesize;
+    void **block, *addr, *prev;
+
+    if (entry / FSYNC_SHM_BLOCK_SIZE >= FSYNC_SHM_BLOCKS)
+    {
+        ERR("Index %u is out of range.\n", idx);
+        return NULL;
     }
 
-    if (!shm_addrs[entry])
+    if (!(block = alloc_table_block( (void **)&shm_addrs[entry / FSYNC_SHM_BLOCK_SIZE],
+                                     FSYNC_SHM_BLOCK_SIZE * sizeof(void *) )))
     {
-        void *addr = mmap( NULL, pagesize, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, entry * pagesize );
-        if (addr == (void *)-1)
-            ERR("Failed to map page %d (offset %#lx).\n", entry, entry * pagesize);
+        ERR("Failed to allocate the page table for page %u.\n", entry);
+        return NULL;
+    }
+    block += entry % FSYNC_SHM_BLOCK_SIZE;
 
-        TRACE("Mapping page %d at %p.\n", entry, addr);
+    if (!(addr = __atomic_load_n( block, __ATOMIC_ACQUIRE )))
+    {
+        addr = mmap( NULL, pagesize, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, (off_t)entry * pagesize );
+        if (addr == MAP_FAILED)
+        {
+            ERR("Failed to map page %u (offset %#lx).\n", entry, entry * pagesize);
+            return NULL;
+        }
 
-        if (__sync_val_compare_and_swap( &shm_addrs[entry], 0, addr ))
+        TRACE("Mapping page %u at %p.\n", entry, addr);
+
+        if ((prev = __sync_val_compare_and_swap( block, NULL, addr )))
+        {
             munmap( addr, pagesize ); /* someone beat us to it */
+            addr = prev;
+        }
     }
 
-    ret = (void *)((unsigned long)shm_addrs[entry] + offset);
-
-    pthread_mutex_unlock( &shm_addrs_mutex );
-
-    return ret;
+    return (char *)addr + offset;
 }
 
-/* We'd like lookup to be fast. To that end, we use a static list indexed by handle.
- * This is copied and adapted from the fd cache code. */
+/* We'd like lookup to be fast. To that end, we use a static list indexed by
+ * handle. Each entry packs the type, shm index and generation in a single
+ * 64-bit value, so that it can be published and read atomically. */
 
-#define FSYNC_LIST_BLOCK_SIZE  (65536 / sizeof(struct fsync))
+#define FSYNC_LIST_BLOCK_SIZE  (65536 / sizeof(LONG64))
 #define FSYNC_LIST_ENTRIES     256
 
-static struct fsync *fsync_list[FSYNC_LIST_ENTRIES];
-static struct fsync fsync_list_initial_block[FSYNC_LIST_BLOCK_SIZE];
+static LONG64 *fsync_list[FSYNC_LIST_ENTRIES];
+static LONG64 fsync_list_initial_block[FSYNC_LIST_BLOCK_SIZE];
+
+/* cache statistics, only maintained when the fsync_cache channel is on */
+static LONG cache_hits, cache_misses;
 
 static inline UINT_PTR handle_to_index( HANDLE handle, UINT_PTR *entry )
 {
@@ -251,55 +339,145 @@ static inline UINT_PTR handle_to_index( HANDLE handle, UINT_PTR *entry )
     return idx % FSYNC_LIST_BLOCK_SIZE;
 }
 
-static struct fsync *add_to_list( HANDLE handle, enum fsync_type type, void *shm )
+static inline LONG64 pack_cache_entry( enum fsync_type type, unsigned int shm_idx, unsigned int gen )
+{
+    return ((ULONG64)gen << 32) | (shm_idx << 8) | type;
+}
+
+static void add_to_list( HANDLE handle, enum fsync_type type, unsigned int shm_idx, unsigned int gen )
 {
     UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    LONG64 *block;
 
     if (entry >= FSYNC_LIST_ENTRIES)
     {
         FIXME( "too many allocated handles, not caching %p\n", handle );
-        return FALSE;
+        return;
     }
-
-    if (!fsync_list[entry])  /* do we need to allocate a new block of entries? */
+    if (shm_idx >= (1 << 24))
     {
-        if (!entry) fsync_list[0] = fsync_list_initial_block;
-        else
-        {
-            void *ptr = anon_mmap_alloc( FSYNC_LIST_BLOCK_SIZE * sizeof(struct fsync),
-                                         PROT_READ | PROT_WRITE );
-            if (ptr == MAP_FAILED) return FALSE;
-            fsync_list[entry] = ptr;
-        }
+        FIXME( "shm index %u too large, not caching %p\n", shm_idx, handle );
+        return;
     }
 
-    if (!__sync_val_compare_and_swap((int *)&fsync_list[entry][idx].type, 0, type ))
-        fsync_list[entry][idx].shm = shm;
+    if (!entry) block = fsync_list_initial_block;
+    else if (!(block = alloc_table_block( (void **)&fsync_list[entry],
+                                          FSYNC_LIST_BLOCK_SIZE * sizeof(LONG64) )))
+        return;
+
+    __sync_val_compare_and_swap( &block[idx], 0, pack_cache_entry( type, shm_idx, gen ) );
+}
+
+static BOOL get_cached_object( HANDLE handle, struct fsync *obj, LONG64 *cached )
+{
+    UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    LONG64 *block;
+
+    if (entry >= FSYNC_LIST_ENTRIES) return FALSE;
+    if (!entry) block = fsync_list_initial_block;
+    else if (!(block = __atomic_load_n( &fsync_list[entry], __ATOMIC_ACQUIRE ))) return FALSE;
+    if (!(*cached = __atomic_load_n( &block[idx], __ATOMIC_ACQUIRE ))) return FALSE;
 
-    return &fsync_list[entry][idx];
+    obj->type = *cached & 0xff;
+    obj->shm  = get_shm( (ULONG64)*cached >> 8 & 0xffffff );
+    obj->gen  = (ULONG64)*cached >> 32;
+    return TRUE;
 }
 
-static struct fsync *get_cached_object( HANDLE handle )
+static void remove_cached_object( HANDLE handle, LONG64 cached )
 {
     UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    LONG64 *block = entry ? fsync_list[entry] : fsync_list_initial_block;
+
+    __sync_val_compare_and_swap( &block[idx], cached, 0 );
+}
+
+static void update_cache_stats( BOOL hit, HANDLE handle )
+{
+    LONG hits, misses;
+
+    if (hit)
+    {
+        hits = __atomic_add_fetch( &cache_hits, 1, __ATOMIC_RELAXED );
+        if (hits % 0x10000) return;
+        misses = __atomic_load_n( &cache_misses, __ATOMIC_RELAXED );
+    }
+    else
+    {
+        misses = __atomic_add_fetch( &cache_misses, 1, __ATOMIC_RELAXED );
+        hits = __atomic_load_n( &cache_hits, __ATOMIC_RELAXED );
+    }
+    TRACE_(fsync_cache)( "%s for handle %p, %d hits, %d misses.\n",
+                         hit ? "hit" : "miss", handle, hits, misses );
+}
+
+static unsigned int get_slot_gen( void *shm )
+{
+    struct fsync_slot *slot = shm;
+    return __atomic_load_n( &slot->gen, __ATOMIC_SEQ_CST );
+}
+
+/* Take a reference on a shm slot, so that the server doesn't reuse it while
+ * we're using it. Fails if the slot has already been freed. */
+static BOOL grab_slot( void *shm )
+{
+    struct fsync_slot *slot = shm;
+    int ref = __atomic_load_n( &slot->ref, __ATOMIC_SEQ_CST );
 
-    if (entry >= FSYNC_LIST_ENTRIES || !fsync_list[entry]) return NULL;
-    if (!fsync_list[entry][idx].type) return NULL;
+    do
+    {
+        if (!ref) return FALSE;
+    } while (!__atomic_compare_exchange_n( &slot->ref, &ref, ref + 1, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+
+    return TRUE;
+}
+
+static void put_object( struct fsync *obj )
+{
+    struct fsync_slot *slot = obj->shm;
+    __atomic_fetch_sub( &slot->ref, 1, __ATOMIC_SEQ_CST );
+}
 
-    return &fsync_list[entry][idx];
+/* Take a reference on the slot of a cached object, checking that it still
+ * belongs to the same object. */
+static BOOL grab_object( struct fsync *obj )
+{
+    if (!obj->shm || !grab_slot( obj->shm )) return FALSE;
+    if (get_slot_gen( obj->shm ) == obj->gen) return TRUE;
+    put_object( obj );
+    return FALSE;
 }
 
 /* Gets an object. This is either a proper fsync object (i.e. an event,
  * semaphore, etc. created using create_fsync) or a generic synchronizable
  * server-side object which the server will signal (e.g. a process, thread,
- * message queue, etc.) */
-static NTSTATUS get_object( HANDLE handle, struct fsync **obj )
+ * message queue, etc.)
+ *
+ * On success the shm slot is referenced and must be released with
+ * put_object(). */
+static NTSTATUS get_object( HANDLE handle, struct fsync *obj )
 {
     NTSTATUS ret = STATUS_SUCCESS;
     unsigned int shm_idx = 0;
     enum fsync_type type;
+    LONG64 cached;
 
-    if ((*obj = get_cached_object( handle ))) return STATUS_SUCCESS;
+    if (get_cached_object( handle, obj, &cached ))
+    {
+        if (grab_object( obj ))
+        {
+            if (TRACE_ON(fsync_cache)) update_cache_stats( TRUE, handle );
+            return STATUS_SUCCESS;
+        }
+
+        /* The object was destroyed and its slot possibly reused, which can
+         * happen if the handle was closed from another process. Ask the
+         * server again. */
+        WARN("Cached object for handle %p is stale.\n", handle);
+        remove_cached_object( handle, cached );
+    }
+
+    if (TRACE_ON(fsync_cache)) update_cache_stats( FALSE, handle );
 
     if ((INT_PTR)handle < 0)
     {
@@ -322,25 +500,34 @@ static NTSTATUS get_object( HANDLE handle, struct fsync **obj )
     if (ret)
     {
         WARN("Failed to retrieve shm index for handle %p, status %#x.\n", handle, ret);
-        *obj = NULL;
         return ret;
     }
 
     TRACE("Got shm index %d for handle %p.\n", shm_idx, handle);
 
-    *obj = add_to_list( handle, type, get_shm( shm_idx ) );
+    obj->type = type;
+    if (!(obj->shm = get_shm( shm_idx ))) return STATUS_NO_MEMORY;
+    /* the object can only be gone already if the handle was closed meanwhile */
+    if (!grab_slot( obj->shm )) return STATUS_INVALID_HANDLE;
+    obj->gen  = get_slot_gen( obj->shm );
+
+    add_to_list( handle, obj->type, shm_idx, obj->gen );
     return ret;
 }
 
 NTSTATUS fsync_close( HANDLE handle )
 {
     UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    LONG64 *block;
 
     TRACE("%p.\n", handle);
 
-    if (entry < FSYNC_LIST_ENTRIES && fsync_list[entry])
+    if (entry < FSYNC_LIST_ENTRIES)
     {
-        if (__atomic_exchange_n( &fsync_list[entry][idx].type, 0, __ATOMIC_SEQ_CST ))
+        if (!entry) block = fsync_list_initial_block;
+        else block = __atomic_load_n( &fsync_list[entry], __ATOMIC_ACQUIRE );
+
+        if (block && __atomic_exchange_n( &block[idx], 0, __ATOMIC_SEQ_CST ))
             return STATUS_SUCCESS;
     }
 
@@ -376,7 +563,9 @@ static NTSTATUS create_fsync( enum fsync_type type, HANDLE *handle,
 
     if (!ret || ret == STATUS_OBJECT_NAME_EXISTS)
     {
-        add_to_list( *handle, type, get_shm( shm_idx ));
+        void *shm = get_shm( shm_idx );
+
+        if (shm) add_to_list( *handle, type, shm_idx, get_slot_gen( shm ) );
         TRACE("-> handle %p, shm index %d.\n", *handle, shm_idx);
     }
 
@@ -409,8 +598,9 @@ static NTSTATUS open_fsync( enum fsync_type type, HANDLE *handle,
 
     if (!ret)
     {
-        add_to_list( *handle, type, get_shm( shm_idx ) );
+        void *shm = get_shm( shm_idx );
 
+        if (shm) add_to_list( *handle, type, shm_idx, get_slot_gen( shm ) );
         TRACE("-> handle %p, shm index %u.\n", *handle, shm_idx);
     }
     return ret;
@@ -419,6 +609,7 @@ static NTSTATUS open_fsync( enum fsync_type type, HANDLE *handle,
 void fsync_init(void)
 {
     struct stat st;
+    const char *env;
 
     if (!do_fsync())
     {
@@ -456,8 +647,10 @@ void fsync_init(void)
 
     pagesize = sysconf( _SC_PAGESIZE );
 
-    shm_addrs = calloc( 128, sizeof(shm_addrs[0]) );
-    shm_addrs_size = 128;
+    if ((env = getenv( "WINEFSYNC_SPINCOUNT" ))) spin_count = atoi( env );
+    max_spinning_threads = sysconf( _SC_NPROCESSORS_ONLN ) / 2;
+    if (max_spinning_threads < 1) spin_count = 0;
+    TRACE("spin count %u, at most %d spinning threads.\n", spin_count, max_spinning_threads);
 }
 
 NTSTATUS fsync_create_semaphore( HANDLE *handle, ACCESS_MASK access,
@@ -479,7 +672,7 @@ NTSTATUS fsync_open_semaphore( HANDLE *handle, ACCESS_MASK access,
 
 NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *prev )
 {
-    struct fsync *obj;
+    struct fsync obj;
     struct semaphore *semaphore;
     ULONG current;
     NTSTATUS ret;
@@ -487,25 +680,29 @@ NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *prev )
     TRACE("%p, %d, %p.\n", handle, count, prev);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    semaphore = obj->shm;
+    semaphore = obj.shm;
 
     do
     {
         current = semaphore->count;
         if (count + current > semaphore->max)
+        {
+            put_object( &obj );
             return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+        }
     } while (__sync_val_compare_and_swap( &semaphore->count, current, count + current ) != current);
 
     if (prev) *prev = current;
 
     futex_wake( &semaphore->count, INT_MAX );
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
 NTSTATUS fsync_query_semaphore( HANDLE handle, void *info, ULONG *ret_len )
 {
-    struct fsync *obj;
+    struct fsync obj;
     struct semaphore *semaphore;
     SEMAPHORE_BASIC_INFORMATION *out = info;
     NTSTATUS ret;
@@ -513,12 +710,13 @@ NTSTATUS fsync_query_semaphore( HANDLE handle, void *info, ULONG *ret_len )
     TRACE("handle %p, info %p, ret_len %p.\n", handle, info, ret_len);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    semaphore = obj->shm;
+    semaphore = obj.shm;
 
     out->CurrentCount = semaphore->count;
     out->MaximumCount = semaphore->max;
     if (ret_len) *ret_len = sizeof(*out);
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
@@ -545,56 +743,61 @@ NTSTATUS fsync_open_event( HANDLE *handle, ACCESS_MASK access,
 NTSTATUS fsync_set_event( HANDLE handle, LONG *prev )
 {
     struct event *event;
-    struct fsync *obj;
+    struct fsync obj;
     LONG current;
     NTSTATUS ret;
 
     TRACE("%p.\n", handle);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    event = obj->shm;
+    event = obj.shm;
 
-    if (obj->type != FSYNC_MANUAL_EVENT && obj->type != FSYNC_AUTO_EVENT)
+    if (obj.type != FSYNC_MANUAL_EVENT && obj.type != FSYNC_AUTO_EVENT)
+    {
+        put_object( &obj );
         return STATUS_OBJECT_TYPE_MISMATCH;
+    }
 
     if (!(current = __atomic_exchange_n( &event->signaled, 1, __ATOMIC_SEQ_CST )))
         futex_wake( &event->signaled, INT_MAX );
 
     if (prev) *prev = current;
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
 NTSTATUS fsync_reset_event( HANDLE handle, LONG *prev )
 {
     struct event *event;
-    struct fsync *obj;
+    struct fsync obj;
     LONG current;
     NTSTATUS ret;
 
     TRACE("%p.\n", handle);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    event = obj->shm;
+    event = obj.shm;
 
     current = __atomic_exchange_n( &event->signaled, 0, __ATOMIC_SEQ_CST );
 
     if (prev) *prev = current;
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
 NTSTATUS fsync_pulse_event( HANDLE handle, LONG *prev )
 {
     struct event *event;
-    struct fsync *obj;
+    struct fsync obj;
     LONG current;
     NTSTATUS ret;
 
     TRACE("%p.\n", handle);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    event = obj->shm;
+    event = obj.shm;
 
     /* This isn't really correct; an application could miss the write.
      * Unfortunately we can't really do much better. Fortunately this is rarely
@@ -610,25 +813,27 @@ NTSTATUS fsync_pulse_event( HANDLE handle, LONG *prev )
 
     if (prev) *prev = current;
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
 NTSTATUS fsync_query_event( HANDLE handle, void *info, ULONG *ret_len )
 {
     struct event *event;
-    struct fsync *obj;
+    struct fsync obj;
     EVENT_BASIC_INFORMATION *out = info;
     NTSTATUS ret;
 
     TRACE("handle %p, info %p, ret_len %p.\n", handle, info, ret_len);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    event = obj->shm;
+    event = obj.shm;
 
     out->EventState = event->signaled;
-    out->EventType = (obj->type == FSYNC_AUTO_EVENT ? SynchronizationEvent : NotificationEvent);
+    out->EventType = (obj.type == FSYNC_AUTO_EVENT ? SynchronizationEvent : NotificationEvent);
     if (ret_len) *ret_len = sizeof(*out);
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
@@ -653,15 +858,19 @@ NTSTATUS fsync_open_mutex( HANDLE *handle, ACCESS_MASK access,
 NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev )
 {
     struct mutex *mutex;
-    struct fsync *obj;
+    struct fsync obj;
     NTSTATUS ret;
 
     TRACE("%p, %p.\n", handle, prev);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    mutex = obj->shm;
+    mutex = obj.shm;
 
-    if (mutex->tid != GetCurrentThreadId()) return STATUS_MUTANT_NOT_OWNED;
+    if (mutex->tid != GetCurrentThreadId())
+    {
+        put_object( &obj );
+        return STATUS_MUTANT_NOT_OWNED;
+    }
 
     if (prev) *prev = mutex->count;
 
@@ -671,12 +880,13 @@ NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev )
         futex_wake( &mutex->tid, INT_MAX );
     }
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
 NTSTATUS fsync_query_mutex( HANDLE handle, void *info, ULONG *ret_len )
 {
-    struct fsync *obj;
+    struct fsync obj;
     struct mutex *mutex;
     MUTANT_BASIC_INFORMATION *out = info;
     NTSTATUS ret;
@@ -684,13 +894,14 @@ NTSTATUS fsync_query_mutex( HANDLE handle, void *info, ULONG *ret_len )
     TRACE("handle %p, info %p, ret_len %p.\n", handle, info, ret_len);
 
     if ((ret = get_object( handle, &obj ))) return ret;
-    mutex = obj->shm;
+    mutex = obj.shm;
 
     out->CurrentCount = 1 - mutex->count;
     out->OwnedByCaller = (mutex->tid == GetCurrentThreadId());
     out->AbandonedState = (mutex->tid == ~0);
     if (ret_len) *ret_len = sizeof(*out);
 
+    put_object( &obj );
     return STATUS_SUCCESS;
 }
 
@@ -728,15 +939,14 @@ static NTSTATUS do_single_wait( int *addr, int val, ULONGLONG *end, BOOLEAN aler
         return STATUS_PENDING;
 }
 
-static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
+static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles, struct fsync **objs,
     BOOLEAN wait_any, BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
     static const LARGE_INTEGER zero = {0};
 
     struct futex_waitv futexes[MAXIMUM_WAIT_OBJECTS + 1];
-    struct fsync *objs[MAXIMUM_WAIT_OBJECTS];
-    BOOL msgwait = FALSE, waited = FALSE;
-    int has_fsync = 0, has_server = 0;
+    BOOL msgwait = FALSE, waited = FALSE, spun = FALSE;
+    short *spin_hint = NULL;
     int dummy_futex = 0;
     LONGLONG timeleft;
     LARGE_INTEGER now;
@@ -758,7 +968,7 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
         if (idx)
         {
             struct event *apc_event = get_shm( idx );
-            ntdll_get_thread_data()->fsync_apc_futex = &apc_event->signaled;
+            if (apc_event) ntdll_get_thread_data()->fsync_apc_futex = &apc_event->signaled;
         }
     }
 
@@ -773,24 +983,19 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
             end = now.QuadPart - timeout->QuadPart;
     }
 
-    for (i = 0; i < count; i++)
-    {
-        ret = get_object( handles[i], &objs[i] );
-        if (ret == STATUS_SUCCESS)
-            has_fsync = 1;
-        else if (ret == STATUS_NOT_IMPLEMENTED)
-            has_server = 1;
-        else
-            return ret;
-    }
-
     if (count && objs[count - 1] && objs[count - 1]->type == FSYNC_QUEUE)
         msgwait = TRUE;
 
-    if (has_fsync && has_server)
-        FIXME("Can't wait on fsync and server objects at the same time!\n");
-    else if (has_server)
-        return STATUS_NOT_IMPLEMENTED;
+    /* message waits depend on the server, no point in spinning */
+    if (!msgwait)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (!objs[i]) continue;
+            spin_hint = get_spin_hint( objs[i]->shm );
+            break;
+        }
+    }
 
     if (TRACE_ON(fsync))
     {
@@ -833,13 +1038,6 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
 
                 if (obj)
                 {
-                    if (!obj->type) /* gcc complains if we put this in the switch */
-                    {
-                        /* Someone probably closed an object while waiting on it. */
-                        WARN("Handle %p has type 0; was it closed?\n", handles[i]);
-                        return STATUS_INVALID_HANDLE;
-                    }
-
                     switch (obj->type)
                     {
                     case FSYNC_SEMAPHORE:
@@ -957,6 +1155,14 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                 return STATUS_TIMEOUT;
             }
 
+            /* Only spin once, if the object didn't get grabbed in the meantime
+             * it's probably not going to be released soon. */
+            if (!spun && spin_hint)
+            {
+                spun = TRUE;
+                if (spin_wait( futexes, waitcount, spin_hint )) continue;
+            }
+
             ret = futex_wait_multiple( futexes, waitcount, timeout ? &end : NULL );
 
             /* FUTEX_WAIT_MULTIPLE can succeed or return -EINTR, -EAGAIN,
@@ -1205,39 +1411,76 @@ static void server_set_msgwait( int in_msgwait )
 }
 
 /* This is a very thin wrapper around the proper implementation above. The
- * purpose is to make sure the server knows when we are doing a message wait.
+ * purpose is to make sure the server knows when we are doing a message wait,
+ * and to hold references to the objects for the duration of the wait.
  * This is separated into a wrapper function since there are at least a dozen
  * exit paths from fsync_wait_objects(). */
 NTSTATUS fsync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
                              BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
+    struct fsync objs[MAXIMUM_WAIT_OBJECTS], *obj_ptrs[MAXIMUM_WAIT_OBJECTS];
+    int has_fsync = 0, has_server = 0;
     BOOL msgwait = FALSE;
-    struct fsync *obj;
     NTSTATUS ret;
+    DWORD i;
+
+    for (i = 0; i < count; i++)
+    {
+        ret = get_object( handles[i], &objs[i] );
+        if (ret == STATUS_SUCCESS)
+        {
+            obj_ptrs[i] = &objs[i];
+            has_fsync = 1;
+        }
+        else if (ret == STATUS_NOT_IMPLEMENTED)
+        {
+            obj_ptrs[i] = NULL;
+            has_server = 1;
+        }
+        else
+        {
+            count = i;
+            goto done;
+        }
+    }
 
-    if (count && !get_object( handles[count - 1], &obj ) && obj->type == FSYNC_QUEUE)
+    if (has_fsync && has_server)
+        FIXME("Can't wait on fsync and server objects at the same time!\n");
+    else if (has_server)
+    {
+        ret = STATUS_NOT_IMPLEMENTED;
+        goto done;
+    }
+
+    if (count && obj_ptrs[count - 1] && obj_ptrs[count - 1]->type == FSYNC_QUEUE)
     {
         msgwait = TRUE;
         server_set_msgwait( 1 );
     }
 
-    ret = __fsync_wait_objects( count, handles, wait_any, alertable, timeout );
+    ret = __fsync_wait_objects( count, handles, obj_ptrs, wait_any, alertable, timeout );
 
     if (msgwait)
         server_set_msgwait( 0 );
 
+done:
+    for (i = 0; i < count; i++)
+        if (obj_ptrs[i]) put_object( obj_ptrs[i] );
     return ret;
 }
 
 NTSTATUS fsync_signal_and_wait( HANDLE signal, HANDLE wait, BOOLEAN alertable,
     const LARGE_INTEGER *timeout )
 {
-    struct fsync *obj;
+    enum fsync_type type;
+    struct fsync obj;
     NTSTATUS ret;
 
     if ((ret = get_object( signal, &obj ))) return ret;
+    type = obj.type;
+    put_object( &obj );
 
-    switch (obj->type)
+    switch (type)
     {
     case FSYNC_SEMAPHORE:
         ret = fsync_release_semaphore( signal, 1, NULL );
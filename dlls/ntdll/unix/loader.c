@@ -300,6 +300,7 @@ static void * const syscalls[] =
     NtResumeProcess,
     NtResumeThread,
     NtSaveKey,
+    NtSaveKeyEx,
     NtSecureConnectPort,
     NtSetContextThread,
     NtSetDebugFilterState,
@@ -363,6 +364,7 @@ static void * const syscalls[] =
     __wine_unix_spawnvp,
     wine_nt_to_unix_file_name,
     wine_server_call,
+    wine_server_call_batch,
     wine_server_fd_to_handle,
     wine_server_handle_to_fd,
     wine_unix_to_nt_file_name,
@@ -1170,8 +1172,8 @@ static void load_ntdll_wow64_functions( HMODULE module )
 }
 
 /* reimplementation of LdrProcessRelocationBlock */
-static const IMAGE_BASE_RELOCATION *process_relocation_block( void *module, const IMAGE_BASE_RELOCATION *rel,
-                                                              INT_PTR delta )
+const IMAGE_BASE_RELOCATION *process_relocation_block( void *module, const IMAGE_BASE_RELOCATION *rel,
+                                                       INT_PTR delta )
 {
     char *page = get_rva( module, rel->VirtualAddress );
     UINT count = (rel->SizeOfBlock - sizeof(*rel)) / sizeof(USHORT);
@@ -1232,6 +1234,9 @@ static void relocate_ntdll( void *module )
 
     ERR( "ntdll could not be mapped at preferred address (%p), expect trouble\n", module );
 
+    /* already relocated when it was mapped */
+    if ((char *)module == (char *)nt->OptionalHeader.ImageBase) return;
+
     if (!(rel = get_module_data_dir( module, IMAGE_DIRECTORY_ENTRY_BASERELOC, &size ))) return;
 
     sec = (IMAGE_SECTION_HEADER *)((char *)&nt->OptionalHeader + nt->FileHeader.SizeOfOptionalHeader);
@@ -2220,6 +2225,7 @@ const unixlib_entry_t __wine_unix_call_funcs[] =
 };
 
 BOOL ac_odyssey;
+BOOL async_file_read;
 BOOL fsync_simulate_sched_quantum;
 
 static void hacks_init(void)
@@ -2228,10 +2234,15 @@ static void hacks_init(void)
     static const char ac_odyssey_exe[] = "ACOdyssey.exe";
     const char *env_str;
 
+    env_str = getenv("WINE_ASYNC_FILE_READ");
+    if (env_str)
+        async_file_read = !!atoi(env_str);
+
     if (main_argc > 1 && strstr(main_argv[1], ac_odyssey_exe))
     {
         ERR("HACK: AC Odyssey sync tweak on.\n");
         ac_odyssey = TRUE;
+        if (!env_str) async_file_read = TRUE;
         return;
     }
     env_str = getenv("WINE_FSYNC_SIMULATE_SCHED_QUANTUM");
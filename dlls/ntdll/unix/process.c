@@ -1066,6 +1066,7 @@ void fill_vm_counters( VM_COUNTERS_EX *pvmi, int unix_pid )
 NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class, void *info,
                                            ULONG size, ULONG *ret_len )
 {
+    process_snapshot_t snapshot;
     unsigned int ret = STATUS_SUCCESS;
     ULONG len = 0;
 
@@ -1100,6 +1101,26 @@ NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class
             if (size >= sizeof(PROCESS_BASIC_INFORMATION))
             {
                 if (!info) ret = STATUS_ACCESS_VIOLATION;
+                else if (handle == GetCurrentProcess() && get_process_snapshot( &snapshot ))
+                {
+                    pbi.ExitStatus = snapshot.exit_code;
+                    pbi.PebBaseAddress = wine_server_get_ptr( snapshot.peb );
+                    pbi.AffinityMask = snapshot.affinity & affinity_mask;
+                    pbi.BasePriority = snapshot.priority;
+                    pbi.UniqueProcessId = snapshot.pid;
+                    pbi.InheritedFromUniqueProcessId = snapshot.ppid;
+#ifndef _WIN64
+                    if (is_wow64)
+                    {
+                        if (snapshot.machine != native_machine)
+                            pbi.PebBaseAddress = (PEB *)((char *)pbi.PebBaseAddress + 0x1000);
+                        else
+                            pbi.PebBaseAddress = NULL;
+                    }
+#endif
+                    memcpy( info, &pbi, sizeof(PROCESS_BASIC_INFORMATION) );
+                    len = sizeof(PROCESS_BASIC_INFORMATION);
+                }
                 else
                 {
                     SERVER_START_REQ(get_process_info)
@@ -1262,16 +1283,21 @@ NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class
                         pti.KernelTime.QuadPart = (ULONGLONG)tms.tms_stime * 10000000 / ticks;
                     }
 
-                    SERVER_START_REQ(get_process_info)
+                    if (handle == GetCurrentProcess() && get_process_snapshot( &snapshot ))
+                        pti.CreateTime.QuadPart = snapshot.start_time;
+                    else
                     {
-                        req->handle = wine_server_obj_handle( handle );
-                        if ((ret = wine_server_call( req )) == STATUS_SUCCESS)
+                        SERVER_START_REQ(get_process_info)
                         {
-                            pti.CreateTime.QuadPart = reply->start_time;
-                            pti.ExitTime.QuadPart = reply->end_time;
+                            req->handle = wine_server_obj_handle( handle );
+                            if ((ret = wine_server_call( req )) == STATUS_SUCCESS)
+                            {
+                                pti.CreateTime.QuadPart = reply->start_time;
+                                pti.ExitTime.QuadPart = reply->end_time;
+                            }
                         }
+                        SERVER_END_REQ;
                     }
-                    SERVER_END_REQ;
 
                     memcpy(info, &pti, sizeof(KERNEL_USER_TIMES));
                     len = sizeof(KERNEL_USER_TIMES);
@@ -1373,10 +1399,21 @@ NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class
             else if (!handle) ret = STATUS_INVALID_HANDLE;
             else
             {
-                memset(info, 0, 4);
-                len = 4;
+                /* a PROCESS_HANDLE_INFORMATION also gets the high-water mark */
+                len = size >= sizeof(PROCESS_HANDLE_INFORMATION) ? sizeof(PROCESS_HANDLE_INFORMATION) : 4;
+                SERVER_START_REQ( get_process_handle_count )
+                {
+                    req->handle = wine_server_obj_handle( handle );
+                    if (!(ret = wine_server_call( req )))
+                    {
+                        PROCESS_HANDLE_INFORMATION *hinfo = info;
+                        hinfo->HandleCount = reply->count;
+                        if (len == sizeof(*hinfo)) hinfo->HandleCountHighWatermark = reply->max_count;
+                    }
+                }
+                SERVER_END_REQ;
             }
-            if (size > 4) ret = STATUS_INFO_LENGTH_MISMATCH;
+            if (size != 4 && size != sizeof(PROCESS_HANDLE_INFORMATION)) ret = STATUS_INFO_LENGTH_MISMATCH;
         }
         else
         {
@@ -1391,13 +1428,18 @@ NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class
         {
             const ULONG_PTR system_mask = get_system_affinity_mask();
 
-            SERVER_START_REQ(get_process_info)
+            if (handle == GetCurrentProcess() && get_process_snapshot( &snapshot ))
+                *(ULONG_PTR *)info = snapshot.affinity & system_mask;
+            else
             {
-                req->handle = wine_server_obj_handle( handle );
-                if (!(ret = wine_server_call( req )))
-                    *(ULONG_PTR *)info = reply->affinity & system_mask;
+                SERVER_START_REQ(get_process_info)
+                {
+                    req->handle = wine_server_obj_handle( handle );
+                    if (!(ret = wine_server_call( req )))
+                        *(ULONG_PTR *)info = reply->affinity & system_mask;
+                }
+                SERVER_END_REQ;
             }
-            SERVER_END_REQ;
         }
         else ret = STATUS_INFO_LENGTH_MISMATCH;
         break;
@@ -1406,13 +1448,18 @@ NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class
         len = sizeof(DWORD);
         if (size == len)
         {
-            SERVER_START_REQ(get_process_info)
+            if (handle == GetCurrentProcess() && get_process_snapshot( &snapshot ))
+                *(DWORD *)info = snapshot.session_id;
+            else
             {
-                req->handle = wine_server_obj_handle( handle );
-                if (!(ret = wine_server_call( req )))
-                    *(DWORD *)info = reply->session_id;
+                SERVER_START_REQ(get_process_info)
+                {
+                    req->handle = wine_server_obj_handle( handle );
+                    if (!(ret = wine_server_call( req )))
+                        *(DWORD *)info = reply->session_id;
+                }
+                SERVER_END_REQ;
             }
-            SERVER_END_REQ;
         }
         else ret = STATUS_INFO_LENGTH_MISMATCH;
         break;
@@ -1481,17 +1528,25 @@ NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class
             {
                 PROCESS_PRIORITY_CLASS *priority = info;
 
-                SERVER_START_REQ(get_process_info)
+                if (handle == GetCurrentProcess() && get_process_snapshot( &snapshot ))
                 {
-                    req->handle = wine_server_obj_handle( handle );
-                    if ((ret = wine_server_call( req )) == STATUS_SUCCESS)
+                    priority->PriorityClass = snapshot.priority;
+                    priority->Foreground = FALSE;
+                }
+                else
+                {
+                    SERVER_START_REQ(get_process_info)
                     {
-                        priority->PriorityClass = reply->priority;
-                        /* FIXME: Not yet supported by the wineserver */
-                        priority->Foreground = FALSE;
+                        req->handle = wine_server_obj_handle( handle );
+                        if ((ret = wine_server_call( req )) == STATUS_SUCCESS)
+                        {
+                            priority->PriorityClass = reply->priority;
+                            /* FIXME: Not yet supported by the wineserver */
+                            priority->Foreground = FALSE;
+                        }
                     }
+                    SERVER_END_REQ;
                 }
-                SERVER_END_REQ;
             }
         }
         else ret = STATUS_INFO_LENGTH_MISMATCH;
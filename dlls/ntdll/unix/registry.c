@@ -25,8 +25,12 @@
 #pragma makedep unix
 #endif
 
+#include <errno.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -39,6 +43,211 @@ WINE_DEFAULT_DEBUG_CHANNEL(reg);
 /* maximum length of a value name in bytes (without terminating null) */
 #define MAX_VALUE_LENGTH (16383 * sizeof(WCHAR))
 
+/* values read through NtQueryValueKey are cached along with the generation of their key,
+ * and served locally as long as the counter published by the server hasn't moved; entries
+ * are tied to the open that returned the handle, since the handle value can be reused */
+
+#define REG_CACHE_BUCKETS  64    /* number of hash buckets, indexed by key handle */
+#define REG_CACHE_ENTRIES  512   /* maximum number of cached values */
+#define REG_CACHE_MAX_DATA 1024  /* largest value data kept in the cache */
+
+struct reg_cache_entry
+{
+    struct list   bucket;   /* entry in the hash bucket of the handle */
+    struct list   lru;      /* entry in the LRU list */
+    HANDLE        handle;   /* key handle the value was read through */
+    unsigned int  serial;   /* serial of the open that returned the handle */
+    unsigned int  slot;     /* generation counter slot of the key */
+    unsigned int  gen;      /* generation of the key when the value was read */
+    unsigned int  status;   /* STATUS_SUCCESS, or STATUS_OBJECT_NAME_NOT_FOUND if missing */
+    ULONG         type;     /* value type */
+    ULONG         len;      /* data length */
+    USHORT        namelen;  /* name length in bytes */
+    WCHAR         name[1];  /* value name, followed by the data */
+};
+
+struct reg_cache_handle
+{
+    struct list   entry;    /* entry in the hash bucket of the handle */
+    HANDLE        handle;   /* key handle */
+    unsigned int  serial;   /* serial of the open that returned it */
+};
+
+static pthread_mutex_t reg_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t reg_cache_once = PTHREAD_ONCE_INIT;
+static const volatile unsigned int *reg_cache_gens;  /* generation counters mapped from the server */
+static struct list reg_cache_buckets[REG_CACHE_BUCKETS];
+static struct list reg_cache_handles[REG_CACHE_BUCKETS];
+static struct list reg_cache_lru = LIST_INIT( reg_cache_lru );
+static unsigned int reg_cache_count;
+static unsigned int reg_cache_serial;
+
+static inline struct list *reg_cache_bucket( HANDLE handle )
+{
+    return &reg_cache_buckets[((ULONG_PTR)handle >> 2) % REG_CACHE_BUCKETS];
+}
+
+static inline struct list *reg_cache_handle_bucket( HANDLE handle )
+{
+    return &reg_cache_handles[((ULONG_PTR)handle >> 2) % REG_CACHE_BUCKETS];
+}
+
+static inline void *reg_cache_data( struct reg_cache_entry *entry )
+{
+    return (char *)entry->name + entry->namelen;
+}
+
+/* map the generation counters; the cache stays disabled if that fails */
+static void reg_cache_init(void)
+{
+    HANDLE handle = 0;
+    int fd, needs_close;
+    unsigned int i;
+    void *ptr;
+
+    SERVER_START_REQ( get_registry_cache )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (!handle) return;
+
+    for (i = 0; i < REG_CACHE_BUCKETS; i++)
+    {
+        list_init( &reg_cache_buckets[i] );
+        list_init( &reg_cache_handles[i] );
+    }
+    if (!server_get_unix_fd( handle, 0, &fd, &needs_close, NULL, NULL ))
+    {
+        ptr = mmap( NULL, REGISTRY_CACHE_SLOTS * sizeof(*reg_cache_gens), PROT_READ, MAP_SHARED, fd, 0 );
+        if (ptr != MAP_FAILED) reg_cache_gens = ptr;
+        else WARN( "failed to map the registry generations: %s\n", strerror( errno ));
+        if (needs_close) close( fd );
+    }
+    NtClose( handle );
+}
+
+static void free_reg_cache_entry( struct reg_cache_entry *entry )
+{
+    list_remove( &entry->bucket );
+    list_remove( &entry->lru );
+    reg_cache_count--;
+    free( entry );
+}
+
+/* find the tracked open of a handle; must be called with the cache mutex held */
+static struct reg_cache_handle *find_cache_handle( HANDLE handle )
+{
+    struct reg_cache_handle *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, reg_cache_handle_bucket( handle ), struct reg_cache_handle, entry )
+        if (entry->handle == handle) return entry;
+    return NULL;
+}
+
+/* get the serial of the open that returned a handle, 0 if the handle isn't tracked */
+static unsigned int get_cache_serial( HANDLE handle )
+{
+    struct reg_cache_handle *entry;
+    unsigned int serial = 0;
+
+    mutex_lock( &reg_cache_mutex );
+    if ((entry = find_cache_handle( handle ))) serial = entry->serial;
+    mutex_unlock( &reg_cache_mutex );
+    return serial;
+}
+
+/* start tracking a key handle returned by a successful open */
+static void cache_open_handle( HANDLE handle )
+{
+    struct reg_cache_handle *entry;
+
+    pthread_once( &reg_cache_once, reg_cache_init );
+    if (!reg_cache_gens) return;
+
+    mutex_lock( &reg_cache_mutex );
+    if (!(entry = find_cache_handle( handle )) && (entry = malloc( sizeof(*entry) )))
+    {
+        entry->handle = handle;
+        list_add_head( reg_cache_handle_bucket( handle ), &entry->entry );
+    }
+    if (entry && !(entry->serial = ++reg_cache_serial)) entry->serial = ++reg_cache_serial;
+    mutex_unlock( &reg_cache_mutex );
+}
+
+/* find a cached value; must be called with the cache mutex held */
+static struct reg_cache_entry *find_cached_value( HANDLE handle, const UNICODE_STRING *name )
+{
+    struct reg_cache_entry *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, reg_cache_bucket( handle ), struct reg_cache_entry, bucket )
+    {
+        if (entry->handle != handle || entry->namelen != name->Length) continue;
+        if (memcmp( entry->name, name->Buffer, name->Length )) continue;
+        return entry;
+    }
+    return NULL;
+}
+
+/* add a value read from the server to the cache */
+static void cache_value( HANDLE handle, unsigned int serial, const UNICODE_STRING *name, unsigned int status,
+                         unsigned int slot, unsigned int gen, ULONG type, const void *data, ULONG len )
+{
+    struct reg_cache_handle *open;
+    struct reg_cache_entry *entry, *old;
+
+    if (!(entry = malloc( offsetof( struct reg_cache_entry, name[0] ) + name->Length + len ))) return;
+    entry->handle  = handle;
+    entry->serial  = serial;
+    entry->slot    = slot;
+    entry->gen     = gen;
+    entry->status  = status;
+    entry->type    = type;
+    entry->len     = len;
+    entry->namelen = name->Length;
+    memcpy( entry->name, name->Buffer, name->Length );
+    if (len) memcpy( reg_cache_data( entry ), data, len );
+
+    mutex_lock( &reg_cache_mutex );
+    /* the handle may have been closed and reused while the value was read */
+    if (!(open = find_cache_handle( handle )) || open->serial != serial)
+    {
+        mutex_unlock( &reg_cache_mutex );
+        free( entry );
+        return;
+    }
+    if ((old = find_cached_value( handle, name ))) free_reg_cache_entry( old );
+    if (reg_cache_count >= REG_CACHE_ENTRIES)
+        free_reg_cache_entry( LIST_ENTRY( list_tail( &reg_cache_lru ), struct reg_cache_entry, lru ));
+    list_add_head( reg_cache_bucket( handle ), &entry->bucket );
+    list_add_head( &reg_cache_lru, &entry->lru );
+    reg_cache_count++;
+    mutex_unlock( &reg_cache_mutex );
+}
+
+/***********************************************************************
+ *           registry_cache_close_handle
+ *
+ * Stop tracking a handle that is being closed, and drop the values cached for it.
+ */
+void registry_cache_close_handle( HANDLE handle )
+{
+    struct reg_cache_entry *entry, *next;
+    struct reg_cache_handle *open;
+
+    if (!reg_cache_gens) return;
+
+    mutex_lock( &reg_cache_mutex );
+    if ((open = find_cache_handle( handle )))
+    {
+        list_remove( &open->entry );
+        free( open );
+    }
+    LIST_FOR_EACH_ENTRY_SAFE( entry, next, reg_cache_bucket( handle ), struct reg_cache_entry, bucket )
+        if (entry->handle == handle) free_reg_cache_entry( entry );
+    mutex_unlock( &reg_cache_mutex );
+}
+
 
 NTSTATUS open_hkcu_key( const char *path, HANDLE *key )
 {
@@ -108,6 +317,7 @@ NTSTATUS WINAPI NtCreateKey( HANDLE *key, ACCESS_MASK access, const OBJECT_ATTRI
     {
         if (dispos) *dispos = REG_CREATED_NEW_KEY;
     }
+    if (!ret) cache_open_handle( *key );
 
     TRACE( "<- %p\n", *key );
     free( objattr );
@@ -156,6 +366,7 @@ NTSTATUS WINAPI NtOpenKeyEx( HANDLE *key, ACCESS_MASK access, const OBJECT_ATTRI
         *key = wine_server_ptr_handle( reply->hkey );
     }
     SERVER_END_REQ;
+    if (!ret) cache_open_handle( *key );
     TRACE("<- %p\n", *key);
     return ret;
 }
@@ -481,7 +692,8 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
                                  KEY_VALUE_INFORMATION_CLASS info_class,
                                  void *info, DWORD length, DWORD *result_len )
 {
-    unsigned int ret;
+    struct reg_cache_entry *entry;
+    unsigned int ret, type, total, slot, gen, size, serial = 0;
     UCHAR *data_ptr;
     unsigned int fixed_size, min_size;
 
@@ -524,21 +736,63 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
+    pthread_once( &reg_cache_once, reg_cache_init );
+    if (reg_cache_gens && (serial = get_cache_serial( handle )))
+    {
+        mutex_lock( &reg_cache_mutex );
+        if ((entry = find_cached_value( handle, name )))
+        {
+            if (entry->serial != serial || reg_cache_gens[entry->slot] != entry->gen)
+            {
+                free_reg_cache_entry( entry );
+                entry = NULL;
+            }
+            else
+            {
+                list_remove( &entry->lru );
+                list_add_head( &reg_cache_lru, &entry->lru );
+                type  = entry->type;
+                total = entry->len;
+                if (!(ret = entry->status) && length > fixed_size && data_ptr)
+                    memcpy( data_ptr, reg_cache_data( entry ), min( length - fixed_size, total ));
+            }
+        }
+        mutex_unlock( &reg_cache_mutex );
+        if (entry)
+        {
+            if (ret) return ret;
+            goto done;
+        }
+    }
+
     SERVER_START_REQ( get_key_value )
     {
         req->hkey = wine_server_obj_handle( handle );
         wine_server_add_data( req, name->Buffer, name->Length );
         if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
-        if (!(ret = wine_server_call( req )))
-        {
-            copy_key_value_info( info_class, info, length, reply->type,
-                                 name->Length, reply->total );
-            *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : reply->total);
-            if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
-            else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
-        }
+        ret = wine_server_call( req );
+        type  = reply->type;
+        total = reply->total;
+        slot  = reply->cache_slot;
+        gen   = reply->cache_gen;
+        size  = wine_server_reply_size( reply );
     }
     SERVER_END_REQ;
+
+    if (serial && slot)
+    {
+        if (ret == STATUS_OBJECT_NAME_NOT_FOUND)
+            cache_value( handle, serial, name, ret, slot, gen, 0, NULL, 0 );
+        else if (!ret && data_ptr && size == total && total <= REG_CACHE_MAX_DATA)
+            cache_value( handle, serial, name, ret, slot, gen, type, data_ptr, total );
+    }
+    if (ret) return ret;
+
+done:
+    copy_key_value_info( info_class, info, length, type, name->Length, total );
+    *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : total);
+    if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
+    else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
     return ret;
 }
 
@@ -775,11 +1029,24 @@ NTSTATUS WINAPI NtUnloadKey( OBJECT_ATTRIBUTES *attr )
  *              NtSaveKey  (NTDLL.@)
  */
 NTSTATUS WINAPI NtSaveKey( HANDLE key, HANDLE file )
+{
+    return NtSaveKeyEx( key, file, REG_STANDARD_FORMAT );
+}
+
+
+/******************************************************************************
+ *              NtSaveKeyEx  (NTDLL.@)
+ */
+NTSTATUS WINAPI NtSaveKeyEx( HANDLE key, HANDLE file, ULONG format )
 {
     unsigned int ret;
 
-    TRACE( "(%p,%p)\n", key, file );
+    TRACE( "(%p,%p,%u)\n", key, file, (int)format );
+
+    if (format != REG_STANDARD_FORMAT && format != REG_LATEST_FORMAT && format != REG_NO_COMPRESSION)
+        return STATUS_INVALID_PARAMETER;
 
+    /* all the formats are saved in the standard format */
     SERVER_START_REQ( save_registry )
     {
         req->hkey = wine_server_obj_handle( key );
@@ -128,6 +128,7 @@ sigset_t server_block_set;  /* signals to block during server calls */
 static int fd_socket = -1;  /* socket to exchange file descriptors with the server */
 static int initial_cwd = -1;
 static pid_t server_pid;
+static volatile process_shm_t *process_shm;  /* process and thread state snapshots */
 pthread_mutex_t fd_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* atomically exchange a 64-bit value */
@@ -316,6 +317,96 @@ unsigned int CDECL wine_server_call( void *req_ptr )
 }
 
 
+/***********************************************************************
+ *           wine_server_call_batch
+ *
+ * Perform several independent server calls with a single round trip.
+ * The return value is the status of the batch itself, the status of
+ * each request is returned in its reply header.
+ */
+unsigned int CDECL wine_server_call_batch( struct __server_request_info *reqs, unsigned int count )
+{
+    static const char padding[8];
+    struct iovec vec[1 + __SERVER_MAX_BATCH * (__SERVER_MAX_DATA + 2)];
+    data_size_t reply_max[__SERVER_MAX_BATCH];
+    struct __server_request_info req;
+    data_size_t size = 0, reply_size = 0, pad;
+    unsigned int i, j, done, ret, nb_vec = 1;
+    sigset_t old_set;
+    char *replies, *ptr;
+    int res;
+
+    if (count > __SERVER_MAX_BATCH) return STATUS_INVALID_PARAMETER;
+
+    for (i = 0; i < count; i++)
+    {
+        const struct request_header *header = &reqs[i].u.req.request_header;
+
+        /* trigger write watches, otherwise read() might return EFAULT */
+        if (header->reply_size && !virtual_check_buffer_for_write( reqs[i].reply_data, header->reply_size ))
+            return STATUS_ACCESS_VIOLATION;
+
+        vec[nb_vec].iov_base = (void *)&reqs[i].u.req;
+        vec[nb_vec++].iov_len = sizeof(reqs[i].u.req);
+        for (j = 0; j < reqs[i].data_count; j++)
+        {
+            vec[nb_vec].iov_base = (void *)reqs[i].data[j].ptr;
+            vec[nb_vec++].iov_len = reqs[i].data[j].size;
+        }
+        if ((pad = BATCH_ALIGN( header->request_size ) - header->request_size))
+        {
+            vec[nb_vec].iov_base = (void *)padding;
+            vec[nb_vec++].iov_len = pad;
+        }
+        size += sizeof(reqs[i].u.req) + BATCH_ALIGN( header->request_size );
+        reply_max[i] = header->reply_size;
+        reply_size += sizeof(reqs[i].u.reply) + BATCH_ALIGN( header->reply_size );
+    }
+
+    if (!(replies = malloc( reply_size ))) return STATUS_NO_MEMORY;
+
+    memset( &req.u.req, 0, sizeof(req.u.req) );
+    req.u.req.request_header.req = REQ_batch_requests;
+    req.u.req.request_header.request_size = size;
+    req.u.req.request_header.reply_size = reply_size;
+    req.u.req.batch_requests_request.count = count;
+    req.reply_data = replies;
+    vec[0].iov_base = &req.u.req;
+    vec[0].iov_len = sizeof(req.u.req);
+
+    pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+    if ((res = writev( ntdll_get_thread_data()->request_fd, vec, nb_vec )) != sizeof(req.u.req) + size)
+    {
+        pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+        free( replies );
+        if (res >= 0) server_protocol_error( "partial write %d\n", res );
+        if (errno == EPIPE) abort_thread(0);
+        if (errno == EFAULT) return STATUS_ACCESS_VIOLATION;
+        server_protocol_perror( "write" );
+    }
+    ret = wait_reply( &req );
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+
+    done = req.u.reply.batch_requests_reply.count;
+    for (i = 0, ptr = replies; i < count; i++)
+    {
+        struct reply_header *header = &reqs[i].u.reply.reply_header;
+
+        if (i >= done)
+        {
+            memset( &reqs[i].u.reply, 0, sizeof(reqs[i].u.reply) );
+            header->error = ret ? ret : STATUS_INTERNAL_ERROR;
+            continue;
+        }
+        memcpy( &reqs[i].u.reply, ptr, sizeof(reqs[i].u.reply) );
+        if (header->reply_size) memcpy( reqs[i].reply_data, ptr + sizeof(reqs[i].u.reply), header->reply_size );
+        ptr += sizeof(reqs[i].u.reply) + BATCH_ALIGN( reply_max[i] );
+    }
+    free( replies );
+    return ret;
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -1492,6 +1583,92 @@ void process_exit_wrapper( int status )
 }
 
 
+/***********************************************************************
+ *           map_process_shm
+ *
+ * Map the process state snapshots published by the server.
+ */
+static void map_process_shm( HANDLE handle )
+{
+    int fd, needs_close;
+    void *ptr;
+
+    if (!handle) return;
+    if (!server_get_unix_fd( handle, 0, &fd, &needs_close, NULL, NULL ))
+    {
+        ptr = mmap( NULL, sizeof(*process_shm), PROT_READ, MAP_SHARED, fd, 0 );
+        if (ptr != MAP_FAILED) process_shm = ptr;
+        else WARN( "failed to map the process snapshots: %s\n", strerror( errno ));
+        if (needs_close) close( fd );
+    }
+    NtClose( handle );
+}
+
+
+/***********************************************************************
+ *           set_thread_shm_slot
+ */
+static void set_thread_shm_slot( unsigned int slot )
+{
+    if (process_shm && slot < MAX_SNAPSHOT_THREADS)
+        ntdll_get_thread_data()->shm = &process_shm->threads[slot];
+}
+
+
+/***********************************************************************
+ *           read_snapshot
+ *
+ * Copy a snapshot while no server update is in progress.
+ */
+static BOOL read_snapshot( const volatile unsigned int *seq, void *dst, const void *src, size_t size )
+{
+    unsigned int i, start;
+
+    for (i = 0; i < 16; i++)
+    {
+        start = __atomic_load_n( seq, __ATOMIC_ACQUIRE );
+        if (start & 1) continue;
+        memcpy( dst, src, size );
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        if (__atomic_load_n( seq, __ATOMIC_RELAXED ) == start) return start != 0;
+    }
+    return FALSE;
+}
+
+
+/***********************************************************************
+ *           get_process_snapshot
+ *
+ * Retrieve the current process state without a server call.
+ * Returns FALSE if no consistent snapshot is available; the caller must then use a request.
+ */
+BOOL get_process_snapshot( process_snapshot_t *snapshot )
+{
+    volatile process_snapshot_t *shm;
+
+    if (!process_shm) return FALSE;
+    shm = &process_shm->process;
+    if (!read_snapshot( &shm->seq, snapshot, (const void *)shm, sizeof(*snapshot) )) return FALSE;
+    return snapshot->pid == HandleToULong( NtCurrentTeb()->ClientId.UniqueProcess );
+}
+
+
+/***********************************************************************
+ *           get_thread_snapshot
+ *
+ * Retrieve the current thread state without a server call.
+ * Returns FALSE if no consistent snapshot is available; the caller must then use a request.
+ */
+BOOL get_thread_snapshot( thread_snapshot_t *snapshot )
+{
+    volatile thread_snapshot_t *shm = ntdll_get_thread_data()->shm;
+
+    if (!shm) return FALSE;
+    if (!read_snapshot( &shm->seq, snapshot, (const void *)shm, sizeof(*snapshot) )) return FALSE;
+    return snapshot->tid == HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+}
+
+
 /***********************************************************************
  *           server_init_process
  *
@@ -1507,6 +1684,8 @@ size_t server_init_process(void)
     struct sigaction sig_act;
     size_t info_size;
     DWORD pid, tid;
+    obj_handle_t shm_handle;
+    unsigned int shm_slot;
 
     server_pid = -1;
     if (env_socket)
@@ -1582,6 +1761,8 @@ size_t server_init_process(void)
         peb->SessionId    = reply->session_id;
         info_size         = reply->info_size;
         server_start_time = reply->server_start;
+        shm_handle        = reply->shm_handle;
+        shm_slot          = reply->shm_slot;
         supported_machines_count = wine_server_reply_size( reply ) / sizeof(*supported_machines);
     }
     SERVER_END_REQ;
@@ -1614,6 +1795,8 @@ size_t server_init_process(void)
     }
 
     set_thread_id( NtCurrentTeb(), pid, tid );
+    map_process_shm( wine_server_ptr_handle( shm_handle ));
+    set_thread_shm_slot( shm_slot );
 
     for (i = 0; i < supported_machines_count; i++)
         if (supported_machines[i] == current_machine) return info_size;
@@ -1692,7 +1875,7 @@ void server_init_thread( void *entry_point, BOOL *suspend )
         req->entry     = wine_server_client_ptr( entry_point );
         req->reply_fd  = reply_pipe;
         req->wait_fd   = ntdll_get_thread_data()->wait_fd[1];
-        wine_server_call( req );
+        if (!wine_server_call( req )) set_thread_shm_slot( reply->shm_slot );
         *suspend = reply->suspend;
     }
     SERVER_END_REQ;
@@ -1738,7 +1921,10 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        registry_cache_close_handle( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1799,6 +1985,7 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    registry_cache_close_handle( handle );
 
     if (do_fsync())
         fsync_close( handle );
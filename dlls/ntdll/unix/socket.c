@@ -737,8 +737,12 @@ static NTSTATUS try_recv( int fd, struct async_recv_ioctl *async, ULONG_PTR *siz
     hdr.msg_iov = async->iov;
     hdr.msg_iovlen = async->count;
 #ifndef HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS
-    hdr.msg_control = control_buffer;
-    hdr.msg_controllen = sizeof(control_buffer);
+    /* don't make the kernel build control headers that nobody asked for */
+    if (async->control || async->icmp_over_dgram)
+    {
+        hdr.msg_control = control_buffer;
+        hdr.msg_controllen = sizeof(control_buffer);
+    }
 #endif
     while ((ret = virtual_locked_recvmsg( fd, &hdr, async->unix_flags )) < 0 && errno == EINTR);
 
@@ -855,6 +859,7 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
     HANDLE wait_handle;
     BOOL nonblocking;
     unsigned int i, status;
+    ULONG_PTR information;
     ULONG options;
 
     for (i = 0; i < async->count; ++i)
@@ -866,25 +871,40 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         }
     }
 
-    SERVER_START_REQ( recv_socket )
+    for (;;)
     {
-        req->force_async = force_async;
-        req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
-        req->oob    = !!(async->unix_flags & MSG_OOB);
-        status = wine_server_call( req );
-        wait_handle = wine_server_ptr_handle( reply->wait );
-        options     = reply->options;
-        nonblocking = reply->nonblocking;
-    }
-    SERVER_END_REQ;
+        SERVER_START_REQ( recv_socket )
+        {
+            req->force_async = force_async;
+            req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
+            req->oob    = !!(async->unix_flags & MSG_OOB);
+            status = wine_server_call( req );
+            wait_handle = wine_server_ptr_handle( reply->wait );
+            options     = reply->options;
+            nonblocking = reply->nonblocking;
+        }
+        SERVER_END_REQ;
 
-    /* the server currently will never succeed immediately */
-    assert(status == STATUS_ALERTED || status == STATUS_PENDING || NT_ERROR(status));
+        /* the server currently will never succeed immediately */
+        assert(status == STATUS_ALERTED || status == STATUS_PENDING || NT_ERROR(status));
+
+        /* without a wait handle, the server didn't queue an async and the result
+         * of a synchronous receive doesn't need to be reported back */
+        if (status != STATUS_ALERTED || wait_handle) break;
+
+        status = try_recv( fd, async, &information );
+        if (status == STATUS_DEVICE_NOT_READY && !nonblocking) continue;
+        if (!NT_ERROR(status))
+        {
+            io->Status = status;
+            io->Information = information;
+        }
+        release_fileio( &async->io );
+        return status;
+    }
 
     if (status == STATUS_ALERTED)
     {
-        ULONG_PTR information;
-
         status = try_recv( fd, async, &information );
         if (status == STATUS_DEVICE_NOT_READY && (force_async || !nonblocking))
             status = STATUS_PENDING;
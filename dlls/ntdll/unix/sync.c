@@ -2042,20 +2042,31 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORM
     {
         while (i < count)
         {
-            SERVER_START_REQ( remove_completion )
+            /* dequeue several completions per server round trip, the
+             * requests after the last queued entry fail with STATUS_PENDING */
+            struct __server_request_info reqs[16];
+            ULONG j, batch = min( count - i, ARRAY_SIZE(reqs) );
+
+            for (j = 0; j < batch; j++)
             {
+                struct remove_completion_request *req = SERVER_BATCH_REQ( &reqs[j], remove_completion );
                 req->handle = wine_server_obj_handle( handle );
-                if (!(status = wine_server_call( req )))
+            }
+            if (!(status = wine_server_call_batch( reqs, batch )))
+            {
+                for (j = 0; j < batch; j++)
                 {
+                    const struct remove_completion_reply *reply = SERVER_BATCH_REPLY( &reqs[j], remove_completion );
+
+                    if ((status = reqs[j].u.reply.reply_header.error)) break;
                     info[i].CompletionKey             = reply->ckey;
                     info[i].CompletionValue           = reply->cvalue;
                     info[i].IoStatusBlock.Information = reply->information;
                     info[i].IoStatusBlock.u.Status    = reply->status;
+                    ++i;
                 }
             }
-            SERVER_END_REQ;
             if (status != STATUS_SUCCESS) break;
-            ++i;
         }
         if (i || status != STATUS_PENDING)
         {
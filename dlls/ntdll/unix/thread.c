@@ -1973,6 +1973,7 @@ static BOOL is_process_wow64( const CLIENT_ID *id )
 NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
                                           void *data, ULONG length, ULONG *ret_len )
 {
+    thread_snapshot_t snapshot;
     unsigned int status;
 
     TRACE("(%p,%d,%p,%x,%p)\n", handle, class, data, (int)length, ret_len);
@@ -1984,21 +1985,37 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
         THREAD_BASIC_INFORMATION info;
         const ULONG_PTR affinity_mask = get_system_affinity_mask();
 
-        SERVER_START_REQ( get_thread_info )
+        if (handle == GetCurrentThread() && get_thread_snapshot( &snapshot ))
         {
-            req->handle = wine_server_obj_handle( handle );
-            if (!(status = wine_server_call( req )))
+            void *teb = NtCurrentTeb64();
+
+            if (!teb) teb = NtCurrentTeb();
+            info.ExitStatus             = STATUS_PENDING;
+            info.TebBaseAddress         = teb;
+            info.ClientId               = NtCurrentTeb()->ClientId;
+            info.AffinityMask           = snapshot.affinity & affinity_mask;
+            info.Priority               = snapshot.priority;
+            info.BasePriority           = snapshot.priority;  /* FIXME */
+            status = STATUS_SUCCESS;
+        }
+        else
+        {
+            SERVER_START_REQ( get_thread_info )
             {
-                info.ExitStatus             = reply->exit_code;
-                info.TebBaseAddress         = wine_server_get_ptr( reply->teb );
-                info.ClientId.UniqueProcess = ULongToHandle(reply->pid);
-                info.ClientId.UniqueThread  = ULongToHandle(reply->tid);
-                info.AffinityMask           = reply->affinity & affinity_mask;
-                info.Priority               = reply->priority;
-                info.BasePriority           = reply->priority;  /* FIXME */
+                req->handle = wine_server_obj_handle( handle );
+                if (!(status = wine_server_call( req )))
+                {
+                    info.ExitStatus             = reply->exit_code;
+                    info.TebBaseAddress         = wine_server_get_ptr( reply->teb );
+                    info.ClientId.UniqueProcess = ULongToHandle(reply->pid);
+                    info.ClientId.UniqueThread  = ULongToHandle(reply->tid);
+                    info.AffinityMask           = reply->affinity & affinity_mask;
+                    info.Priority               = reply->priority;
+                    info.BasePriority           = reply->priority;  /* FIXME */
+                }
             }
+            SERVER_END_REQ;
         }
-        SERVER_END_REQ;
         if (status == STATUS_SUCCESS)
         {
 #ifndef _WIN64
@@ -2021,13 +2038,21 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
         const ULONG_PTR affinity_mask = get_system_affinity_mask();
         ULONG_PTR affinity = 0;
 
-        SERVER_START_REQ( get_thread_info )
+        if (handle == GetCurrentThread() && get_thread_snapshot( &snapshot ))
         {
-            req->handle = wine_server_obj_handle( handle );
-            req->access = THREAD_QUERY_INFORMATION;
-            if (!(status = wine_server_call( req ))) affinity = reply->affinity & affinity_mask;
+            affinity = snapshot.affinity & affinity_mask;
+            status = STATUS_SUCCESS;
+        }
+        else
+        {
+            SERVER_START_REQ( get_thread_info )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                req->access = THREAD_QUERY_INFORMATION;
+                if (!(status = wine_server_call( req ))) affinity = reply->affinity & affinity_mask;
+            }
+            SERVER_END_REQ;
         }
-        SERVER_END_REQ;
         if (status == STATUS_SUCCESS)
         {
             if (data) memcpy( data, &affinity, min( length, sizeof(affinity) ));
@@ -2041,19 +2066,30 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
         KERNEL_USER_TIMES kusrt;
         int unix_pid, unix_tid;
 
-        SERVER_START_REQ( get_thread_times )
+        if (handle == GetCurrentThread() && get_thread_snapshot( &snapshot ))
         {
-            req->handle = wine_server_obj_handle( handle );
-            status = wine_server_call( req );
-            if (status == STATUS_SUCCESS)
+            kusrt.CreateTime.QuadPart = snapshot.creation_time;
+            kusrt.ExitTime.QuadPart = 0;
+            unix_pid = getpid();
+            unix_tid = snapshot.unix_tid;
+            status = STATUS_SUCCESS;
+        }
+        else
+        {
+            SERVER_START_REQ( get_thread_times )
             {
-                kusrt.CreateTime.QuadPart = reply->creation_time;
-                kusrt.ExitTime.QuadPart = reply->exit_time;
-                unix_pid = reply->unix_pid;
-                unix_tid = reply->unix_tid;
+                req->handle = wine_server_obj_handle( handle );
+                status = wine_server_call( req );
+                if (status == STATUS_SUCCESS)
+                {
+                    kusrt.CreateTime.QuadPart = reply->creation_time;
+                    kusrt.ExitTime.QuadPart = reply->exit_time;
+                    unix_pid = reply->unix_pid;
+                    unix_tid = reply->unix_tid;
+                }
             }
+            SERVER_END_REQ;
         }
-        SERVER_END_REQ;
         if (status == STATUS_SUCCESS)
         {
             BOOL ret = FALSE;
@@ -2082,7 +2118,16 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
 
     case ThreadAmILastThread:
     {
+        process_snapshot_t process;
+
         if (length != sizeof(ULONG)) return STATUS_INFO_LENGTH_MISMATCH;
+        if (handle == GetCurrentThread() && get_process_snapshot( &process ))
+        {
+            ULONG last = process.running_threads == 1;
+            if (data) memcpy( data, &last, sizeof(last) );
+            if (ret_len) *ret_len = sizeof(last);
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( get_thread_info )
         {
             req->handle = wine_server_obj_handle( handle );
@@ -2100,6 +2145,13 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
 
     case ThreadQuerySetWin32StartAddress:
     {
+        if (handle == GetCurrentThread() && get_thread_snapshot( &snapshot ))
+        {
+            PRTL_THREAD_START_ROUTINE entry = wine_server_get_ptr( snapshot.entry_point );
+            if (data) memcpy( data, &entry, min( length, sizeof(entry) ) );
+            if (ret_len) *ret_len = min( length, sizeof(entry) );
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( get_thread_info )
         {
             req->handle = wine_server_obj_handle( handle );
@@ -2124,12 +2176,20 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
         memset( &affinity, 0, sizeof(affinity) );
         affinity.Group = 0; /* Wine only supports max 64 processors */
 
-        SERVER_START_REQ( get_thread_info )
+        if (handle == GetCurrentThread() && get_thread_snapshot( &snapshot ))
         {
-            req->handle = wine_server_obj_handle( handle );
-            if (!(status = wine_server_call( req ))) affinity.Mask = reply->affinity & affinity_mask;
+            affinity.Mask = snapshot.affinity & affinity_mask;
+            status = STATUS_SUCCESS;
+        }
+        else
+        {
+            SERVER_START_REQ( get_thread_info )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                if (!(status = wine_server_call( req ))) affinity.Mask = reply->affinity & affinity_mask;
+            }
+            SERVER_END_REQ;
         }
-        SERVER_END_REQ;
         if (status == STATUS_SUCCESS)
         {
             if (data) memcpy( data, &affinity, min( length, sizeof(affinity) ));
@@ -2150,6 +2210,11 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
         if (length != sizeof(ULONG)) return STATUS_INFO_LENGTH_MISMATCH;
         if (!data) return STATUS_ACCESS_VIOLATION;
 
+        if (handle == GetCurrentThread() && get_thread_snapshot( &snapshot ))
+        {
+            *(ULONG *)data = snapshot.suspend_count;
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( get_thread_info )
         {
             req->handle = wine_server_obj_handle( handle );
@@ -2194,6 +2259,12 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
     case ThreadHideFromDebugger:
         if (length != sizeof(BOOLEAN)) return STATUS_INFO_LENGTH_MISMATCH;
         if (!data) return STATUS_ACCESS_VIOLATION;
+        if (handle == GetCurrentThread() && get_thread_snapshot( &snapshot ))
+        {
+            *(BOOLEAN*)data = snapshot.dbg_hidden;
+            if (ret_len) *ret_len = sizeof(BOOLEAN);
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( get_thread_info )
         {
             req->handle = wine_server_obj_handle( handle );
@@ -152,7 +152,13 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct wine_rb_tree views_tree;
-static pthread_mutex_t virtual_mutex;
+
+/* the views lock is taken exclusively to change the views and page protections, and shared
+ * to look them up; the exclusive lock is recursive, and the shared lock taken by the thread
+ * that holds it exclusively simply nests inside it */
+static pthread_rwlock_t virtual_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_t virtual_lock_owner;     /* thread holding the exclusive lock */
+static unsigned int virtual_lock_count;  /* recursion count of the exclusive lock */
 
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
@@ -235,6 +241,73 @@ static struct range_entry *free_ranges;
 static struct range_entry *free_ranges_end;
 
 
+/* check if the current thread holds the views lock exclusively */
+static inline BOOL is_virtual_lock_owner(void)
+{
+    return __atomic_load_n( &virtual_lock_count, __ATOMIC_ACQUIRE ) &&
+           pthread_equal( virtual_lock_owner, pthread_self() );
+}
+
+/***********************************************************************
+ *           lock_views
+ *
+ * Take the views lock exclusively. Signals are blocked unless sigset is NULL,
+ * which is only allowed from inside a signal handler.
+ * Like mutex_lock(), the lock is ignored once the process is exiting: the other
+ * threads may have been killed while holding it, and would never release it.
+ */
+static void lock_views( sigset_t *sigset )
+{
+    if (sigset) pthread_sigmask( SIG_BLOCK, &server_block_set, sigset );
+    if (process_exiting) return;
+    if (is_virtual_lock_owner())
+    {
+        virtual_lock_count++;
+        return;
+    }
+    pthread_rwlock_wrlock( &virtual_lock );
+    virtual_lock_owner = pthread_self();
+    __atomic_store_n( &virtual_lock_count, 1, __ATOMIC_RELEASE );
+}
+
+/***********************************************************************
+ *           unlock_views
+ */
+static void unlock_views( sigset_t *sigset )
+{
+    if (!process_exiting && !--virtual_lock_count) pthread_rwlock_unlock( &virtual_lock );
+    if (sigset) pthread_sigmask( SIG_SETMASK, sigset, NULL );
+}
+
+/***********************************************************************
+ *           lock_views_shared
+ *
+ * Take the views lock for lookups that may run in parallel. The caller must not take
+ * the lock exclusively while holding it shared, which includes touching memory that
+ * may fault, such as buffers supplied by the application.
+ */
+static void lock_views_shared( sigset_t *sigset )
+{
+    if (sigset) pthread_sigmask( SIG_BLOCK, &server_block_set, sigset );
+    if (process_exiting) return;
+    if (is_virtual_lock_owner()) virtual_lock_count++;
+    else pthread_rwlock_rdlock( &virtual_lock );
+}
+
+/***********************************************************************
+ *           unlock_views_shared
+ */
+static void unlock_views_shared( sigset_t *sigset )
+{
+    if (!process_exiting)
+    {
+        if (is_virtual_lock_owner()) virtual_lock_count--;
+        else pthread_rwlock_unlock( &virtual_lock );
+    }
+    if (sigset) pthread_sigmask( SIG_SETMASK, sigset, NULL );
+}
+
+
 static inline BOOL is_beyond_limit( const void *addr, size_t size, const void *limit )
 {
     return (addr >= limit || (const char *)addr + size > (const char *)limit);
@@ -656,7 +729,7 @@ void *get_builtin_so_handle( void *module )
     void *ret = NULL;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -664,7 +737,7 @@ void *get_builtin_so_handle( void *module )
         if (ret) builtin->refcount++;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return ret;
 }
 
@@ -689,7 +762,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, const void **fun
         return STATUS_SUCCESS;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -712,7 +785,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, const void **fun
         }
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -726,7 +799,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
     NTSTATUS status = STATUS_SUCCESS;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -734,7 +807,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
         else status = STATUS_IMAGE_ALREADY_LOADED;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -1042,6 +1115,31 @@ static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE c
 }
 
 
+/***********************************************************************
+ *           set_page_vprot_bits_atomic
+ *
+ * Set or clear vprot bits for a range of pages while only holding the views lock shared.
+ */
+static void set_page_vprot_bits_atomic( const void *addr, size_t size, BYTE set, BYTE clear )
+{
+    size_t idx = (size_t)addr >> page_shift;
+    size_t end = ((size_t)addr + size + page_mask) >> page_shift;
+    BYTE *ptr, old;
+
+    for ( ; idx < end; idx++)
+    {
+#ifdef _WIN64
+        ptr = pages_vprot[idx >> pages_vprot_shift] + (idx & pages_vprot_mask);
+#else
+        ptr = pages_vprot + idx;
+#endif
+        old = __atomic_load_n( ptr, __ATOMIC_RELAXED );
+        while (!__atomic_compare_exchange_n( ptr, &old, (old & ~clear) | set, FALSE,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED ));
+    }
+}
+
+
 /***********************************************************************
  *           alloc_pages_vprot
  *
@@ -1182,12 +1280,12 @@ static void VIRTUAL_Dump(void)
     struct file_view *view;
 
     TRACE( "Dump of all virtual memory views:\n" );
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         dump_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 }
 #endif
 
@@ -1195,7 +1293,7 @@ static void VIRTUAL_Dump(void)
 /***********************************************************************
  *           find_view
  *
- * Find the view containing a given address. virtual_mutex must be held by caller.
+ * Find the view containing a given address. virtual_lock must be held by caller.
  *
  * PARAMS
  *      addr  [I] Address
@@ -1273,7 +1371,7 @@ static inline BOOL is_system_range( const void *addr, size_t size )
  *           find_view_range
  *
  * Find the first view overlapping at least part of the specified range.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
@@ -1345,7 +1443,7 @@ static void* try_map_free_area( struct alloc_area *area, void *base, void *end,
  *           add_reserved_area
  *
  * Add a reserved area to the list maintained by libwine.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static void add_reserved_area( void *addr, size_t size )
 {
@@ -1369,7 +1467,7 @@ static void add_reserved_area( void *addr, size_t size )
  *           remove_reserved_area
  *
  * Remove a reserved area from the list maintained by libwine.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static void remove_reserved_area( void *addr, size_t size )
 {
@@ -1404,7 +1502,7 @@ struct area_boundary
  *
  * Get lowest boundary address between reserved area and non-reserved area
  * in the specified region. If no boundaries are found, result is NULL.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static int get_area_boundary_callback( void *start, SIZE_T size, void *arg )
 {
@@ -1432,7 +1530,7 @@ static int get_area_boundary_callback( void *start, SIZE_T size, void *arg )
  *           unmap_area
  *
  * Unmap an area, or simply replace it by an empty mapping if it is
- * in a reserved area. virtual_mutex must be held by caller.
+ * in a reserved area. virtual_lock must be held by caller.
  */
 static inline void unmap_area( void *addr, size_t size )
 {
@@ -1468,7 +1566,7 @@ static inline void unmap_area( void *addr, size_t size )
 /***********************************************************************
  *           alloc_view
  *
- * Allocate a new view. virtual_mutex must be held by caller.
+ * Allocate a new view. virtual_lock must be held by caller.
  */
 static struct file_view *alloc_view(void)
 {
@@ -1492,7 +1590,7 @@ static struct file_view *alloc_view(void)
 /***********************************************************************
  *           free_view
  *
- * Free memory for view structure. virtual_mutex must be held by caller.
+ * Free memory for view structure. virtual_lock must be held by caller.
  */
 static void free_view( struct file_view *view )
 {
@@ -1504,7 +1602,7 @@ static void free_view( struct file_view *view )
 /***********************************************************************
  *           unregister_view
  *
- * Remove view from the tree and update free ranges. virtual_mutex must be held by caller.
+ * Remove view from the tree and update free ranges. virtual_lock must be held by caller.
  */
 static void unregister_view( struct file_view *view )
 {
@@ -1516,7 +1614,7 @@ static void unregister_view( struct file_view *view )
 /***********************************************************************
  *           delete_view
  *
- * Deletes a view. virtual_mutex must be held by caller.
+ * Deletes a view. virtual_lock must be held by caller.
  */
 static void delete_view( struct file_view *view ) /* [in] View */
 {
@@ -1530,7 +1628,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
 /***********************************************************************
  *           register_view
  *
- * Add view to the tree and update free ranges. virtual_mutex must be held by caller.
+ * Add view to the tree and update free ranges. virtual_lock must be held by caller.
  */
 static void register_view( struct file_view *view )
 {
@@ -1542,7 +1640,7 @@ static void register_view( struct file_view *view )
 /***********************************************************************
  *           create_view
  *
- * Create a view. virtual_mutex must be held by caller.
+ * Create a view. virtual_lock must be held by caller.
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
@@ -2101,7 +2199,7 @@ static void *alloc_free_area( void *limit, size_t size, BOOL top_down, int unix_
  *           map_fixed_area
  *
  * mmap the fixed memory area.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static NTSTATUS map_fixed_area( void *base, size_t size, unsigned int vprot )
 {
@@ -2163,7 +2261,7 @@ static void clear_native_views(void)
  *           map_view
  *
  * Create a view and mmap the corresponding memory area.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
                           unsigned int alloc_type, unsigned int vprot, ULONG_PTR limit, size_t align_mask )
@@ -2227,7 +2325,7 @@ static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
  *           map_file_into_view
  *
  * Wrapper for mmap() to map a file into a view, falling back to read if mmap fails.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static NTSTATUS map_file_into_view( struct file_view *view, int fd, size_t start, size_t size,
                                     off_t offset, unsigned int vprot, BOOL removable )
@@ -2319,8 +2417,9 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
                 size = reply->size;
                 if (reply->committed)
                 {
+                    /* this may be called with the views lock held shared */
                     *vprot |= VPROT_COMMITTED;
-                    set_page_vprot_bits( base, size, VPROT_COMMITTED, 0 );
+                    set_page_vprot_bits_atomic( base, size, VPROT_COMMITTED, 0 );
                 }
             }
         }
@@ -2338,7 +2437,7 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
  *           decommit_pages
  *
  * Decommit some pages of a given view.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t size )
 {
@@ -2444,7 +2543,7 @@ static NTSTATUS map_pe_header( void *ptr, size_t size, int fd, BOOL *removable )
  *           map_image_into_view
  *
  * Map an executable (PE format) image into an existing view.
- * virtual_mutex must be held by caller.
+ * virtual_lock must be held by caller.
  */
 static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filename, int fd, void *orig_base,
                                      SIZE_T header_size, ULONG image_flags, int shared_fd, BOOL removable )
@@ -2637,6 +2736,199 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
 }
 
 
+/***********************************************************************
+ *           get_reloc_pages
+ *
+ * Validate the relocation blocks of an image and flag the pages they modify.
+ */
+static BOOL get_reloc_pages( const IMAGE_BASE_RELOCATION *rel, const IMAGE_BASE_RELOCATION *end,
+                             SIZE_T size, BOOL is64, BYTE *pages )
+{
+    while (rel < end - 1 && rel->SizeOfBlock)
+    {
+        const USHORT *relocs = (const USHORT *)(rel + 1);
+        UINT i, count;
+        SIZE_T offset, len;
+
+        if (rel->SizeOfBlock < sizeof(*rel) || rel->VirtualAddress >= size) return FALSE;
+        count = (rel->SizeOfBlock - sizeof(*rel)) / sizeof(USHORT);
+        if ((const char *)(relocs + count) > (const char *)end) return FALSE;
+
+        for (i = 0; i < count; i++)
+        {
+            switch (relocs[i] >> 12)
+            {
+            case IMAGE_REL_BASED_ABSOLUTE:
+                continue;
+            case IMAGE_REL_BASED_HIGH:
+            case IMAGE_REL_BASED_LOW:
+                len = sizeof(short);
+                break;
+            case IMAGE_REL_BASED_HIGHLOW:
+                len = sizeof(int);
+                break;
+            case IMAGE_REL_BASED_DIR64:
+                if (!is64) return FALSE;
+                len = sizeof(INT64);
+                break;
+            default:
+                return FALSE;  /* leave it to the loader */
+            }
+            offset = rel->VirtualAddress + (relocs[i] & 0xfff);
+            if (offset + len > size) return FALSE;
+            pages[offset >> page_shift] = 1;
+            pages[(offset + len - 1) >> page_shift] = 1;
+        }
+        rel = (const IMAGE_BASE_RELOCATION *)(relocs + count);
+    }
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           relocate_image
+ *
+ * Apply the relocations of a dll mapped away from its preferred base, like the kernel
+ * does on Windows. The relocated pages are stored in a file shared through the server,
+ * and processes mapping the same dll at the same address later map them copy-on-write
+ * instead of relocating their own private copy. Images that can't be handled here are
+ * left untouched for the loader to relocate.
+ * virtual_lock must be held by caller.
+ */
+static NTSTATUS relocate_image( struct file_view *view, const pe_image_info_t *image_info, int shared_fd )
+{
+    char *base = view->base;
+    SIZE_T size = min( image_info->map_size, view->size ), count = size >> page_shift, i, next;
+    IMAGE_NT_HEADERS *nt = (IMAGE_NT_HEADERS *)(base + ((IMAGE_DOS_HEADER *)base)->e_lfanew);
+    const IMAGE_BASE_RELOCATION *rel, *end;
+    const IMAGE_DATA_DIRECTORY *dir;
+    NTSTATUS status = STATUS_SUCCESS;
+    int fd = -1, needs_close = 0, fill = 0;
+    BOOL is64, success = TRUE;
+    HANDLE handle = 0;
+    ULONG_PTR orig_base;
+    BYTE *pages;
+
+    if (!(image_info->image_charact & IMAGE_FILE_DLL)) return STATUS_SUCCESS;
+    if (image_info->image_charact & IMAGE_FILE_RELOCS_STRIPPED) return STATUS_SUCCESS;
+    if (image_info->image_flags & IMAGE_FLAGS_ImageMappedFlat) return STATUS_SUCCESS;
+    /* pages of the shared sections are mapped from a file shared by all processes */
+    if (shared_fd != -1) return STATUS_SUCCESS;
+
+    switch (nt->OptionalHeader.Magic)
+    {
+    case IMAGE_NT_OPTIONAL_HDR32_MAGIC:
+        if ((ULONG_PTR)base + size > 0xffffffff) return STATUS_SUCCESS;
+        orig_base = ((IMAGE_NT_HEADERS32 *)nt)->OptionalHeader.ImageBase;
+        dir = &((IMAGE_NT_HEADERS32 *)nt)->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+        is64 = FALSE;
+        break;
+    case IMAGE_NT_OPTIONAL_HDR64_MAGIC:
+        orig_base = ((IMAGE_NT_HEADERS64 *)nt)->OptionalHeader.ImageBase;
+        dir = &((IMAGE_NT_HEADERS64 *)nt)->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+        is64 = TRUE;
+        break;
+    default:
+        return STATUS_SUCCESS;
+    }
+    if ((char *)(dir + 1) > base + ROUND_SIZE( 0, image_info->header_size )) return STATUS_SUCCESS;
+    if ((char *)orig_base == base || !dir->Size || !dir->VirtualAddress) return STATUS_SUCCESS;
+    if (dir->VirtualAddress >= size || dir->Size > size - dir->VirtualAddress) return STATUS_SUCCESS;
+
+    rel = (const IMAGE_BASE_RELOCATION *)(base + dir->VirtualAddress);
+    end = (const IMAGE_BASE_RELOCATION *)(base + dir->VirtualAddress + dir->Size);
+    for (i = dir->VirtualAddress >> page_shift; i <= (dir->VirtualAddress + dir->Size - 1) >> page_shift; i++)
+        if (!(get_page_vprot( base + (i << page_shift) ) & VPROT_COMMITTED)) return STATUS_SUCCESS;
+
+    if (!(pages = calloc( count, 1 ))) return STATUS_SUCCESS;
+    if (!get_reloc_pages( rel, end, size, is64, pages )) goto done;
+    pages[0] = 1;  /* the header, for the updated ImageBase */
+    for (i = 0; i < count; i++)
+        if (pages[i] && !(get_page_vprot( base + (i << page_shift) ) & VPROT_COMMITTED)) goto done;
+
+    SERVER_START_REQ( get_image_relocs )
+    {
+        req->base = wine_server_client_ptr( base );
+        if (!wine_server_call( req ))
+        {
+            handle = wine_server_ptr_handle( reply->handle );
+            fill = reply->fill;
+        }
+    }
+    SERVER_END_REQ;
+
+    if (handle)
+    {
+        if (server_get_unix_fd( handle, fill ? FILE_READ_DATA | FILE_WRITE_DATA : FILE_READ_DATA,
+                                &fd, &needs_close, NULL, NULL ))
+            fd = -1;
+        NtClose( handle );
+    }
+
+    if (fd != -1 && !fill)
+    {
+        TRACE_(module)( "mapping shared relocated pages at %p\n", base );
+        for (i = 0; i < count; i = next)
+        {
+            for (next = i; next < count && pages[next]; next++) ;
+            if (next == i)
+            {
+                next++;
+                continue;
+            }
+            if (mmap( base + (i << page_shift), (next - i) << page_shift, PROT_READ | PROT_WRITE,
+                      MAP_FIXED | MAP_PRIVATE, fd, (off_t)i << page_shift ) == MAP_FAILED)
+            {
+                ERR_(module)( "failed to map relocated pages at %p: %s\n",
+                              base + (i << page_shift), strerror( errno ));
+                status = STATUS_NO_MEMORY;
+                goto done;
+            }
+            mprotect_range( base + (i << page_shift), (next - i) << page_shift, 0, 0 );
+        }
+        goto done;
+    }
+
+    TRACE_(module)( "relocating %p from %p\n", base, (void *)orig_base );
+    for (i = 0; i < count; i++)
+        if (pages[i]) mprotect( base + (i << page_shift), page_size, PROT_READ | PROT_WRITE );
+
+    while (rel < end - 1 && rel->SizeOfBlock) rel = process_relocation_block( base, rel, base - (char *)orig_base );
+    if (is64) ((IMAGE_NT_HEADERS64 *)nt)->OptionalHeader.ImageBase = (ULONG_PTR)base;
+    else ((IMAGE_NT_HEADERS32 *)nt)->OptionalHeader.ImageBase = PtrToUlong( base );
+
+    for (i = 0; i < count; i = next)
+    {
+        for (next = i; next < count && pages[next]; next++) ;
+        if (next == i)
+        {
+            next++;
+            continue;
+        }
+        if (fd != -1 && pwrite( fd, base + (i << page_shift), (next - i) << page_shift,
+                                (off_t)i << page_shift ) != (next - i) << page_shift)
+            success = FALSE;
+        mprotect_range( base + (i << page_shift), (next - i) << page_shift, 0, 0 );
+    }
+
+    if (fill)
+    {
+        SERVER_START_REQ( set_image_relocs )
+        {
+            req->base    = wine_server_client_ptr( base );
+            req->success = fd != -1 && success;
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+    }
+
+done:
+    if (needs_close) close( fd );
+    free( pages );
+    return status;
+}
+
+
 /***********************************************************************
  *             get_mapping_info
  */
@@ -2699,7 +2991,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     int shared_fd = -1, shared_needs_close = 0;
     SIZE_T size = image_info->map_size;
     struct file_view *view;
-    unsigned int status;
+    unsigned int status, reloc_status;
     sigset_t sigset;
     void *base;
 
@@ -2714,7 +3006,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     }
 
     status = STATUS_INVALID_PARAMETER;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     base = wine_server_get_ptr( image_info->base );
     if ((ULONG_PTR)base != image_info->base) base = NULL;
@@ -2739,6 +3031,16 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
         }
         SERVER_END_REQ;
     }
+    if (status == STATUS_IMAGE_NOT_AT_BASE && (reloc_status = relocate_image( view, image_info, shared_fd )))
+    {
+        SERVER_START_REQ( unmap_view )
+        {
+            req->base = wine_server_client_ptr( view->base );
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+        status = reloc_status;
+    }
     if (NT_SUCCESS(status))
     {
         if (is_builtin) add_builtin_module( view->base, NULL );
@@ -2749,7 +3051,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     if (needs_close) close( unix_fd );
     if (shared_needs_close) close( shared_fd );
     return status;
@@ -2843,7 +3145,7 @@ static unsigned int virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_P
 
     if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL ))) return res;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     res = map_view( &view, base, size, alloc_type & (MEM_TOP_DOWN | MEM_REPLACE_PLACEHOLDER),
                     vprot, get_zero_bits_mask( zero_bits ), 0 );
@@ -2875,7 +3177,7 @@ static unsigned int virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_P
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     if (needs_close) close( unix_handle );
     TRACE("status %#x.\n", res);
     return res;
@@ -2922,14 +3224,8 @@ void virtual_init(void)
     struct alloc_virtual_heap alloc_views;
     size_t size;
     int i;
-    pthread_mutexattr_t attr;
     const char *env_var;
 
-    pthread_mutexattr_init( &attr );
-    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
-    pthread_mutex_init( &virtual_mutex, &attr );
-    pthread_mutexattr_destroy( &attr );
-
     if (!((env_var = getenv("WINE_DISABLE_KERNEL_WRITEWATCH")) && atoi(env_var))
             && (pagemap_reset_fd = open("/proc/self/pagemap_reset", O_RDONLY)) != -1)
     {
@@ -3109,7 +3405,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
     void *base = wine_server_get_ptr( info->base );
     int i;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     status = create_view( &view, base, size, SEC_IMAGE | SEC_FILE | VPROT_SYSTEM |
                           VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY | VPROT_EXEC );
     if (!status)
@@ -3148,7 +3444,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
         }
         else delete_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     return status;
 }
@@ -3261,7 +3557,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     SIZE_T block_size = signal_stack_mask + 1;
     BOOL is_wow = !!NtCurrentTeb()->WowTebOffset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (next_free_teb)
     {
         ptr = next_free_teb;
@@ -3277,7 +3573,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
             if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, is_win64 && is_wow ? 0x7fffffff : 0,
                                                    &total, MEM_RESERVE, PAGE_READWRITE )))
             {
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                unlock_views( &sigset );
                 return status;
             }
             teb_block = ptr;
@@ -3288,14 +3584,14 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
                                  MEM_COMMIT, PAGE_READWRITE );
     }
     *ret_teb = teb = init_teb( ptr, is_wow );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if ((status = signal_alloc_thread( teb )))
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_views( &sigset );
         *(void **)ptr = next_free_teb;
         next_free_teb = ptr;
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_views( &sigset );
     }
     return status;
 }
@@ -3329,13 +3625,13 @@ void virtual_free_teb( TEB *teb )
         NtFreeVirtualMemory( GetCurrentProcess(), &ptr, &size, MEM_RELEASE );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     list_remove( &thread_data->entry );
     ptr = teb;
     if (!is_win64) ptr = (char *)ptr - teb_offset;
     *(void **)ptr = next_free_teb;
     next_free_teb = ptr;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 }
 
 
@@ -3349,7 +3645,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 
     if (index < TLS_MINIMUM_AVAILABLE)
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_views( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( (GDI_TEB_BATCH *)thread_data, TEB, GdiTebBatch );
@@ -3360,14 +3656,14 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             teb->TlsSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_views( &sigset );
     }
     else
     {
         index -= TLS_MINIMUM_AVAILABLE;
         if (index >= 8 * sizeof(peb->TlsExpansionBitmapBits)) return STATUS_INVALID_PARAMETER;
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_views( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( (GDI_TEB_BATCH *)thread_data, TEB, GdiTebBatch );
@@ -3382,7 +3678,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             if (teb->TlsExpansionSlots) teb->TlsExpansionSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_views( &sigset );
     }
     return STATUS_SUCCESS;
 }
@@ -3407,7 +3703,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     if (size < 1024 * 1024) size = 1024 * 1024;  /* Xlib needs a large stack */
     size = (size + 0xffff) & ~0xffff;  /* round to 64K boundary */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if ((status = map_view( &view, NULL, size + extra_size, 0,
                             VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, get_zero_bits_mask( zero_bits ), 0 ))
@@ -3453,7 +3749,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     stack->StackBase = (char *)view->base + view->size;
     stack->StackLimit = (char *)view->base + 2 * page_size;
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -3565,6 +3861,41 @@ static NTSTATUS grow_thread_stack( char *page, struct thread_stack_info *stack_i
 }
 
 
+/***********************************************************************
+ *           handle_write_watch_fault
+ *
+ * Fast path for write faults on write-watched or private copy-on-write pages, which only
+ * touches the protection of the faulting page and can run with the views lock held shared.
+ */
+static BOOL handle_write_watch_fault( char *page )
+{
+    struct file_view *view;
+    BOOL ret = FALSE;
+    BYTE vprot;
+
+    lock_views_shared( NULL );  /* no need for signal masking inside signal handler */
+    vprot = get_page_vprot( page );
+    if (vprot & VPROT_GUARD) goto done;
+    if (vprot & VPROT_WRITECOPY)
+    {
+        /* shared mappings need to be replaced by a private page, leave that to the slow path */
+        if (!(vprot & VPROT_COMMITTED)) goto done;
+        if (!(view = find_view( page, 0 )) || !(view->protect & VPROT_WRITECOPY)) goto done;
+        set_page_vprot_bits_atomic( page, page_size, VPROT_WRITE | VPROT_WRITTEN,
+                                    VPROT_WRITECOPY | VPROT_WRITEWATCH );
+    }
+    else if (vprot & VPROT_WRITEWATCH)
+        set_page_vprot_bits_atomic( page, page_size, 0, VPROT_WRITEWATCH );
+    else goto done;
+
+    mprotect_range( page, page_size, 0, 0 );
+    ret = (get_unix_prot( get_page_vprot( page ) ) & PROT_WRITE) != 0;
+done:
+    unlock_views_shared( NULL );
+    return ret;
+}
+
+
 /***********************************************************************
  *           virtual_handle_fault
  */
@@ -3574,7 +3905,10 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
     char *page = ROUND_ADDR( addr, page_mask );
     BYTE vprot;
 
-    mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+    if (!use_kernel_writewatch && (err & EXCEPTION_WRITE_FAULT) && handle_write_watch_fault( page ))
+        return STATUS_SUCCESS;
+
+    lock_views( NULL );  /* no need for signal masking inside signal handler */
     vprot = get_page_vprot( page );
     if (stack && !is_inside_signal_stack( stack ) && (vprot & VPROT_GUARD))
     {
@@ -3631,7 +3965,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
         else
             set_page_vprot_bits( page, page_size, 0, VPROT_READ | VPROT_EXEC );
     }
-    mutex_unlock( &virtual_mutex );
+    unlock_views( NULL );
     return ret;
 }
 
@@ -3669,14 +4003,14 @@ void *virtual_setup_exception( void *stack_ptr, size_t size, EXCEPTION_RECORD *r
     }
     else if (stack < stack_info.limit)
     {
-        mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+        lock_views( NULL );  /* no need for signal masking inside signal handler */
         if ((get_page_vprot( stack ) & VPROT_GUARD) &&
             grow_thread_stack( ROUND_ADDR( stack, page_mask ), &stack_info ))
         {
             rec->ExceptionCode = STATUS_STACK_OVERFLOW;
             rec->NumberParameters = 0;
         }
-        mutex_unlock( &virtual_mutex );
+        unlock_views( NULL );
     }
 #if defined(VALGRIND_MAKE_MEM_UNDEFINED)
     VALGRIND_MAKE_MEM_UNDEFINED( stack, size );
@@ -3716,6 +4050,28 @@ static NTSTATUS check_write_access( void *base, size_t size, BOOL *has_write_wat
 }
 
 
+/***********************************************************************
+ *           is_plain_writable_range
+ *
+ * Check if a range is writable without needing any write watch or copy-on-write handling.
+ */
+static BOOL is_plain_writable_range( void *base, size_t size )
+{
+    size_t i;
+    char *addr = ROUND_ADDR( base, page_mask );
+
+    size = ROUND_SIZE( base, size );
+    for (i = 0; i < size; i += page_size)
+    {
+        BYTE vprot = get_page_vprot( addr + i );
+        if (vprot & VPROT_WRITECOPY) return FALSE;
+        if (!use_kernel_writewatch && (vprot & VPROT_WRITEWATCH)) return FALSE;
+        if (!(get_unix_prot( vprot ) & PROT_WRITE)) return FALSE;
+    }
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           virtual_locked_server_call
  */
@@ -3730,14 +4086,24 @@ unsigned int virtual_locked_server_call( void *req_ptr )
 
     if (!size) return wine_server_call( req_ptr );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    /* the common case of a plain writable buffer doesn't need to change any protections */
+    lock_views_shared( &sigset );
+    if (is_plain_writable_range( addr, size ))
+    {
+        ret = server_call_unlocked( req );
+        unlock_views_shared( &sigset );
+        return ret;
+    }
+    unlock_views_shared( &sigset );
+
+    lock_views( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         ret = server_call_unlocked( req );
         if (has_write_watch) update_write_watches( addr, size, wine_server_reply_size( req ));
     }
     else memset( &req->u.reply, 0, sizeof(req->u.reply) );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return ret;
 }
 
@@ -3754,14 +4120,14 @@ ssize_t virtual_locked_read( int fd, void *addr, size_t size )
     ssize_t ret = read( fd, addr, size );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = read( fd, addr, size );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     errno = err;
     return ret;
 }
@@ -3779,14 +4145,14 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
     ssize_t ret = pread( fd, addr, size, offset );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = pread( fd, addr, size, offset );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     errno = err;
     return ret;
 }
@@ -3805,7 +4171,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     ssize_t ret = recvmsg( fd, hdr, flags );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     for (i = 0; i < hdr->msg_iovlen; i++)
         if (check_write_access( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, &has_write_watch ))
             break;
@@ -3817,7 +4183,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     if (has_write_watch)
         while (i--) update_write_watches( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, 0 );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     errno = err;
     return ret;
 }
@@ -3832,10 +4198,10 @@ BOOL virtual_is_valid_code_address( const void *addr, SIZE_T size )
     BOOL ret = FALSE;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views_shared( &sigset );
     if ((view = find_view( addr, size )))
         ret = !(view->protect & VPROT_SYSTEM);  /* system views are not visible to the app */
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views_shared( &sigset );
     return ret;
 }
 
@@ -3922,7 +4288,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
 
     if (!size) return 0;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if ((view = find_view( addr, size )))
     {
         if (!(view->protect & VPROT_SYSTEM))
@@ -3938,7 +4304,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
             }
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return bytes_read;
 }
 
@@ -3958,13 +4324,13 @@ NTSTATUS virtual_uninterrupted_write_memory( void *addr, const void *buffer, SIZ
 
     if (!size) return STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         memcpy( addr, buffer, size );
         if (has_write_watch) update_write_watches( addr, size, size );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return ret;
 }
 
@@ -3979,7 +4345,7 @@ void virtual_set_force_exec( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!force_exec_prot != !enable)  /* change all existing views */
     {
         force_exec_prot = enable;
@@ -3997,7 +4363,7 @@ void virtual_set_force_exec( BOOL enable )
             mprotect_range( view->base, view->size, commit, 0 );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 }
 
 struct free_range
@@ -4129,7 +4495,7 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
 
     /* Reserve the memory */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if ((type & MEM_RESERVE) || !base)
     {
@@ -4173,7 +4539,7 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4405,7 +4771,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     if (size) size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     /* avoid freeing the DOS area when a broken app passes a NULL pointer */
     if (!base)
@@ -4554,7 +4920,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
         status = STATUS_INVALID_PARAMETER;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -4608,7 +4974,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if ((view = find_view( base, size )))
     {
@@ -4624,7 +4990,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4680,20 +5046,22 @@ static int get_free_mem_state_callback( void *start, SIZE_T size, void *arg )
     return 1;
 }
 
-static unsigned int fill_basic_memory_info( const void *addr, MEMORY_BASIC_INFORMATION *info )
+static unsigned int fill_basic_memory_info( const void *addr, MEMORY_BASIC_INFORMATION *ret_info )
 {
     char *base, *alloc_base = 0, *alloc_end = working_set_limit;
     struct wine_rb_entry *ptr;
     struct file_view *view;
+    MEMORY_BASIC_INFORMATION info;
     sigset_t sigset;
 
     base = ROUND_ADDR( addr, page_mask );
 
     if (is_beyond_limit( base, 1, working_set_limit )) return STATUS_INVALID_PARAMETER;
 
-    /* Find the view containing the address */
+    /* Find the view containing the address; the info is only copied to the caller's buffer
+     * once the lock is released, as a page fault on it needs to take the lock exclusively */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views_shared( &sigset );
     ptr = views_tree.root;
     while (ptr)
     {
@@ -4718,31 +5086,31 @@ static unsigned int fill_basic_memory_info( const void *addr, MEMORY_BASIC_INFOR
 
     /* Fill the info structure */
 
-    info->AllocationBase = alloc_base;
-    info->BaseAddress    = base;
-    info->RegionSize     = alloc_end - base;
+    info.AllocationBase = alloc_base;
+    info.BaseAddress    = base;
+    info.RegionSize     = alloc_end - base;
 
     if (!ptr)
     {
-        if (!mmap_enum_reserved_areas( get_free_mem_state_callback, info, 0 ))
+        if (!mmap_enum_reserved_areas( get_free_mem_state_callback, &info, 0 ))
         {
             /* not in a reserved area at all, pretend it's allocated */
 #ifdef __i386__
             if (base >= (char *)address_space_start)
             {
-                info->State             = MEM_RESERVE;
-                info->Protect           = PAGE_NOACCESS;
-                info->AllocationProtect = PAGE_NOACCESS;
-                info->Type              = MEM_PRIVATE;
+                info.State             = MEM_RESERVE;
+                info.Protect           = PAGE_NOACCESS;
+                info.AllocationProtect = PAGE_NOACCESS;
+                info.Type              = MEM_PRIVATE;
             }
             else
 #endif
             {
-                info->State             = MEM_FREE;
-                info->Protect           = PAGE_NOACCESS;
-                info->AllocationBase    = 0;
-                info->AllocationProtect = 0;
-                info->Type              = 0;
+                info.State             = MEM_FREE;
+                info.Protect           = PAGE_NOACCESS;
+                info.AllocationBase    = 0;
+                info.AllocationProtect = 0;
+                info.Type              = 0;
             }
         }
     }
@@ -4750,16 +5118,17 @@ static unsigned int fill_basic_memory_info( const void *addr, MEMORY_BASIC_INFOR
     {
         BYTE vprot;
 
-        info->RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
-        info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
-        info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
-        info->AllocationProtect = get_win32_prot( view->protect, view->protect );
-        if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
-        else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
-        else info->Type = MEM_PRIVATE;
+        info.RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
+        info.State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
+        info.Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
+        info.AllocationProtect = get_win32_prot( view->protect, view->protect );
+        if (view->protect & SEC_IMAGE) info.Type = MEM_IMAGE;
+        else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info.Type = MEM_MAPPED;
+        else info.Type = MEM_PRIVATE;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views_shared( &sigset );
 
+    *ret_info = info;
     return STATUS_SUCCESS;
 }
 
@@ -4868,7 +5237,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (vmentries == NULL)
             WARN( "couldn't get process vmmap, errno %d\n", errno );
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_views( &sigset );
         for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
         {
              int i;
@@ -4895,7 +5264,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                      p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
              }
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_views( &sigset );
 
         if (vmentries)
             procstat_freevmmap( pstat, vmentries );
@@ -4905,7 +5274,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
             procstat_close( pstat );
     }
 #else
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (pagemap_fd == -2)
     {
 #ifdef O_CLOEXEC
@@ -4944,7 +5313,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 #endif
 
     if (res_len)
@@ -5294,7 +5663,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
         return status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if ((view = find_view( addr, 0 )) && !is_view_valloc( view ))
     {
         if (flags & MEM_PRESERVE_PLACEHOLDER && !(view->protect & VPROT_FROMPLACEHOLDER))
@@ -5313,7 +5682,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
                 {
                     TRACE( "not freeing in-use builtin %p\n", view->base );
                     builtin->refcount--;
-                    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                    unlock_views( &sigset );
                     return STATUS_SUCCESS;
                 }
             }
@@ -5343,7 +5712,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
         else FIXME( "failed to unmap %p %x\n", view->base, status );
     }
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -5487,7 +5856,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         return result.virtual_flush.status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!(view = find_view( addr, *size_ptr ))) status = STATUS_INVALID_PARAMETER;
     else
     {
@@ -5497,7 +5866,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         if (msync( addr, *size_ptr, MS_ASYNC )) status = STATUS_NOT_MAPPED_DATA;
 #endif
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -5524,7 +5893,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     TRACE( "%p %x %p-%p %p %lu\n", process, (int)flags, base, (char *)base + size,
            addresses, *count );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if (is_write_watch_range( base, size ))
     {
@@ -5616,7 +5985,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     else status = STATUS_INVALID_PARAMETER;
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -5637,14 +6006,14 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     if (!size) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if (is_write_watch_range( base, size ))
         reset_write_watches( base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -5721,7 +6090,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
 
     TRACE("%p %p\n", addr1, addr2);
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views_shared( &sigset );
 
     view1 = find_view( addr1, 0 );
     view2 = find_view( addr2, 0 );
@@ -5745,7 +6114,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
         SERVER_END_REQ;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views_shared( &sigset );
     return status;
 }
 
@@ -13546,6 +13546,67 @@ done:
     flush_events();
 }
 
+static void test_PeekMessage_range_order(void)
+{
+    static const UINT posted[] = { WM_USER + 1, WM_USER + 2, WM_USER + 40, WM_USER + 1, WM_USER + 2 };
+    static const UINT expect[] = { 0, 1, 3, 4 };
+    static const UINT colliding[] = { WM_USER + 33, WM_USER + 1, WM_USER + 65, WM_USER + 2,
+                                      WM_USER + 34, WM_USER + 1, WM_USER + 64 };
+    static const UINT expect_low[] = { 1, 3, 5 };
+    static const UINT expect_high[] = { 0, 4, 6 };
+    unsigned int i;
+    BOOL ret;
+    MSG msg;
+
+    flush_events();
+    for (i = 0; i < ARRAY_SIZE(posted); i++) PostThreadMessageA( GetCurrentThreadId(), posted[i], i, 0 );
+
+    /* messages within a range are still retrieved in posting order */
+    for (i = 0; i < ARRAY_SIZE(expect); i++)
+    {
+        ret = PeekMessageA( &msg, NULL, WM_USER + 1, WM_USER + 2, PM_REMOVE );
+        ok( ret, "%u: PeekMessage failed\n", i );
+        ok( msg.message == posted[expect[i]], "%u: got message %04x\n", i, msg.message );
+        ok( msg.wParam == expect[i], "%u: got wparam %Iu\n", i, msg.wParam );
+    }
+    ret = PeekMessageA( &msg, NULL, WM_USER + 1, WM_USER + 2, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+
+    ret = PeekMessageA( &msg, NULL, WM_USER, WM_USER + 100, PM_REMOVE );
+    ok( ret && msg.message == WM_USER + 40, "got message %04x\n", msg.message );
+    ret = PeekMessageA( &msg, NULL, WM_USER, WM_USER + 100, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+
+    /* codes 32 apart share the same server index bucket */
+    for (i = 0; i < ARRAY_SIZE(colliding); i++) PostThreadMessageA( GetCurrentThreadId(), colliding[i], i, 0 );
+
+    for (i = 0; i < ARRAY_SIZE(expect_low); i++)
+    {
+        ret = PeekMessageA( &msg, NULL, WM_USER + 1, WM_USER + 2, PM_REMOVE );
+        ok( ret, "%u: PeekMessage failed\n", i );
+        ok( msg.message == colliding[expect_low[i]], "%u: got message %04x\n", i, msg.message );
+        ok( msg.wParam == expect_low[i], "%u: got wparam %Iu\n", i, msg.wParam );
+    }
+    ret = PeekMessageA( &msg, NULL, WM_USER + 1, WM_USER + 2, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+
+    for (i = 0; i < ARRAY_SIZE(expect_high); i++)
+    {
+        ret = PeekMessageA( &msg, NULL, WM_USER + 33, WM_USER + 64, PM_REMOVE );
+        ok( ret, "%u: PeekMessage failed\n", i );
+        ok( msg.message == colliding[expect_high[i]], "%u: got message %04x\n", i, msg.message );
+        ok( msg.wParam == expect_high[i], "%u: got wparam %Iu\n", i, msg.wParam );
+    }
+    ret = PeekMessageA( &msg, NULL, WM_USER + 33, WM_USER + 64, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+
+    ret = PeekMessageA( &msg, NULL, WM_USER + 65, WM_USER + 65, PM_REMOVE );
+    ok( ret && msg.message == WM_USER + 65, "got message %04x\n", msg.message );
+    ok( msg.wParam == 2, "got wparam %Iu\n", msg.wParam );
+    ret = PeekMessageA( &msg, NULL, WM_USER, WM_USER + 100, PM_REMOVE );
+    ok( !ret, "got message %04x\n", msg.message );
+}
+
 static void test_PeekMessage3(void)
 {
     HWND hwnd;
@@ -19565,6 +19626,7 @@ START_TEST(msg)
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_PeekMessage_range_order();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
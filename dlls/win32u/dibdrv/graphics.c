@@ -47,10 +47,18 @@ enum glyph_type
 #define GLYPH_CACHE_PAGE_SIZE  0x100
 #define GLYPH_CACHE_PAGES      (0x10000 / GLYPH_CACHE_PAGE_SIZE)
 
+/* unused fonts are freed, least recently used first, when there are more than
+ * FONT_CACHE_MAX_UNUSED of them or when the glyphs of all the cached fonts take
+ * more than FONT_CACHE_MAX_SIZE bytes; if fonts in use still exceed that size,
+ * new glyphs are rendered without being cached */
+#define FONT_CACHE_MAX_UNUSED  5
+#define FONT_CACHE_MAX_SIZE    (8 * 1024 * 1024)
+
 struct cached_font
 {
     struct list           entry;
     LONG                  ref;
+    LONG                  size;   /* bytes used by the glyph cache */
     DWORD                 hash;
     LOGFONTW              lf;
     XFORM                 xform;
@@ -59,6 +67,8 @@ struct cached_font
 };
 
 static struct list font_cache = LIST_INIT( font_cache );
+static unsigned int font_cache_hits, font_cache_misses;
+static LONG font_cache_size;  /* bytes used by the glyph caches of all fonts */
 
 static pthread_mutex_t font_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -631,10 +641,48 @@ static int font_cache_cmp( const struct cached_font *p1, const struct cached_fon
     return ret;
 }
 
+static void free_cached_font( struct cached_font *font )
+{
+    UINT i, j, k;
+
+    TRACE( "%p, %d bytes, %u hits %u misses\n", font, (int)font->size, font_cache_hits, font_cache_misses );
+
+    for (i = 0; i < GLYPH_NBTYPES; i++)
+    {
+        for (j = 0; j < GLYPH_CACHE_PAGES; j++)
+        {
+            if (!font->glyphs[i][j]) continue;
+            for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
+                free( font->glyphs[i][j][k] );
+            free( font->glyphs[i][j] );
+        }
+    }
+    InterlockedExchangeAdd( &font_cache_size, -font->size );
+    free( font );
+}
+
+/* free the least recently used unused fonts; must be called with the font cache lock held */
+static void trim_font_cache(void)
+{
+    struct cached_font *ptr, *next;
+    UINT unused = 0;
+
+    LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
+        if (!ptr->ref) unused++;
+
+    LIST_FOR_EACH_ENTRY_SAFE_REV( ptr, next, &font_cache, struct cached_font, entry )
+    {
+        if (unused <= FONT_CACHE_MAX_UNUSED && font_cache_size <= FONT_CACHE_MAX_SIZE) break;
+        if (ptr->ref) continue;
+        unused--;
+        list_remove( &ptr->entry );
+        free_cached_font( ptr );
+    }
+}
+
 static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 {
-    struct cached_font font, *ptr, *last_unused = NULL;
-    UINT i = 0, j, k;
+    struct cached_font font, *ptr;
 
     NtGdiExtGetObjectW( hfont, sizeof(font.lf), &font.lf );
     font.xform = dc->xformWorld2Vport;
@@ -656,31 +704,14 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
         {
             InterlockedIncrement( &ptr->ref );
             list_remove( &ptr->entry );
+            list_add_head( &font_cache, &ptr->entry );
+            font_cache_hits++;
             goto done;
         }
-        if (!ptr->ref)
-        {
-            i++;
-            last_unused = ptr;
-        }
     }
 
-    if (i > 5)  /* keep at least 5 of the most-recently used fonts around */
-    {
-        ptr = last_unused;
-        for (i = 0; i < GLYPH_NBTYPES; i++)
-        {
-            for (j = 0; j < GLYPH_CACHE_PAGES; j++)
-            {
-                if (!ptr->glyphs[i][j]) continue;
-                for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
-                    free( ptr->glyphs[i][j][k] );
-                free( ptr->glyphs[i][j] );
-            }
-        }
-        list_remove( &ptr->entry );
-    }
-    else if (!(ptr = malloc( sizeof(*ptr) )))
+    font_cache_misses++;
+    if (!(ptr = malloc( sizeof(*ptr) )))
     {
         pthread_mutex_unlock( &font_cache_lock );
         return NULL;
@@ -688,9 +719,11 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 
     *ptr = font;
     ptr->ref = 1;
+    ptr->size = 0;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
-done:
     list_add_head( &font_cache, &ptr->entry );
+    trim_font_cache();
+done:
     pthread_mutex_unlock( &font_cache_lock );
     TRACE( "%d %s -> %p\n", (int)ptr->lf.lfHeight, debugstr_w(ptr->lf.lfFaceName), ptr );
     return ptr;
@@ -701,19 +734,42 @@ void release_cached_font( struct cached_font *font )
     if (font) InterlockedDecrement( &font->ref );
 }
 
+/* check that a glyph fits in the cache, freeing unused fonts if needed */
+static BOOL reserve_glyph_cache( UINT size )
+{
+    BOOL ret;
+
+    if (font_cache_size + size <= FONT_CACHE_MAX_SIZE) return TRUE;
+
+    pthread_mutex_lock( &font_cache_lock );
+    trim_font_cache();
+    ret = font_cache_size + size <= FONT_CACHE_MAX_SIZE;
+    pthread_mutex_unlock( &font_cache_lock );
+    return ret;
+}
+
+/* add a glyph to the font cache; if the cache is full of fonts in use, the glyph
+ * is returned without being cached and *uncached is set, the caller frees it */
 static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT index, UINT flags,
-                                              struct cached_glyph *glyph )
+                                              struct cached_glyph *glyph, UINT size, BOOL *uncached )
 {
     struct cached_glyph *ret;
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
     UINT entry = index % GLYPH_CACHE_PAGE_SIZE;
+    UINT page_size = GLYPH_CACHE_PAGE_SIZE * sizeof(*font->glyphs[type][page]);
+
+    if (!reserve_glyph_cache( font->glyphs[type][page] ? size : size + page_size ))
+    {
+        *uncached = TRUE;
+        return glyph;
+    }
 
     if (!font->glyphs[type][page])
     {
         struct cached_glyph **ptr;
 
-        ptr = calloc( 1, GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr) );
+        ptr = calloc( 1, page_size );
         if (!ptr)
         {
             free( glyph );
@@ -721,9 +777,19 @@ static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT ind
         }
         if (InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page], ptr, NULL ))
             free( ptr );
+        else
+        {
+            InterlockedExchangeAdd( &font->size, page_size );
+            InterlockedExchangeAdd( &font_cache_size, page_size );
+        }
     }
     ret = InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page][entry], glyph, NULL );
-    if (!ret) ret = glyph;
+    if (!ret)
+    {
+        InterlockedExchangeAdd( &font->size, size );
+        InterlockedExchangeAdd( &font_cache_size, size );
+        ret = glyph;
+    }
     else free( glyph );
     return ret;
 }
@@ -822,7 +888,8 @@ static const int padding[4] = {0, 3, 2, 1};
  * For non-antialiased bitmaps convert them to the 17-level format
  * using only values 0 or 16.
  */
-static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font, UINT index, UINT flags )
+static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font, UINT index, UINT flags,
+                                                BOOL *uncached )
 {
     UINT ggo_flags = font->aa_flags;
     static const MAT2 identity = { {0,1}, {0,0}, {0,0}, {0,1} };
@@ -884,7 +951,7 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
 
 done:
     glyph->metrics = metrics;
-    return add_cached_glyph( font, index, flags, glyph );
+    return add_cached_glyph( font, index, flags, glyph, FIELD_OFFSET( struct cached_glyph, bits[size] ), uncached );
 }
 
 static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT x, INT y,
@@ -892,6 +959,7 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
                            const struct clipped_rects *clipped_rects, RECT *bounds )
 {
     UINT i;
+    BOOL uncached;
     struct cached_glyph *glyph;
     dib_info glyph_dib;
     DWORD text_color;
@@ -912,8 +980,9 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
 
     for (i = 0; i < count; i++)
     {
+        uncached = FALSE;
         if (!(glyph = get_cached_glyph( font, str[i], flags )) &&
-            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
+            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags, &uncached ))) continue;
 
         glyph_dib.width       = glyph->metrics.gmBlackBoxX;
         glyph_dib.height      = glyph->metrics.gmBlackBoxY;
@@ -939,6 +1008,7 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
             x += glyph->metrics.gmCellIncX;
             y += glyph->metrics.gmCellIncY;
         }
+        if (uncached) free( glyph );
     }
 }
 
@@ -4624,44 +4624,55 @@ static inline BYTE blend_color(BYTE dst, BYTE src, DWORD alpha)
     return (src * alpha + dst * (255 - alpha) + 127) / 255;
 }
 
+/* The 8888 blending helpers below work on two channels at a time, each held
+ * in a 16-bit lane of a DWORD (blue and red, or green and alpha). A lane never
+ * exceeds 255 * 255 + 127, so no carry crosses into the other lane, and the
+ * division by 255 is exact for that range. The results are identical to
+ * blending each channel separately with blend_color(). */
+
+/* compute (x + 127) / 255 for both lanes of x */
+static inline DWORD div255_lanes( DWORD x )
+{
+    x += 0x007f007f;
+    return ((x + ((x >> 8) & 0x00ff00ff) + 0x00010001) >> 8) & 0x00ff00ff;
+}
+
+static inline DWORD blend_lanes( DWORD dst, DWORD src, DWORD alpha )
+{
+    return div255_lanes( src * alpha + dst * (255 - alpha) );
+}
+
 static inline DWORD blend_argb_constant_alpha( DWORD dst, DWORD src, DWORD alpha )
 {
-    return (blend_color( dst, src, alpha ) |
-            blend_color( dst >> 8, src >> 8, alpha ) << 8 |
-            blend_color( dst >> 16, src >> 16, alpha ) << 16 |
-            blend_color( dst >> 24, src >> 24, alpha ) << 24);
+    return (blend_lanes( dst & 0x00ff00ff, src & 0x00ff00ff, alpha ) |
+            blend_lanes( (dst >> 8) & 0x00ff00ff, (src >> 8) & 0x00ff00ff, alpha ) << 8);
 }
 
 static inline DWORD blend_argb_no_src_alpha( DWORD dst, DWORD src, DWORD alpha )
 {
-    return (blend_color( dst, src, alpha ) |
-            blend_color( dst >> 8, src >> 8, alpha ) << 8 |
-            blend_color( dst >> 16, src >> 16, alpha ) << 16 |
-            blend_color( dst >> 24, 255, alpha ) << 24);
+    return blend_argb_constant_alpha( dst, src | 0xff000000, alpha );
+}
+
+/* blend premultiplied source lanes over dst; the channel sums are combined with
+ * a bitwise or, so that out of range source values give the same result as
+ * the per-channel code */
+static inline DWORD blend_argb_lanes( DWORD dst, DWORD src_rb, DWORD src_ag )
+{
+    DWORD alpha = src_ag >> 16;
+    DWORD rb = src_rb + div255_lanes( (dst & 0x00ff00ff) * (255 - alpha) );
+    DWORD ag = src_ag + div255_lanes( ((dst >> 8) & 0x00ff00ff) * (255 - alpha) );
+    return rb | ag << 8;
 }
 
 static inline DWORD blend_argb( DWORD dst, DWORD src )
 {
-    BYTE b = (BYTE)src;
-    BYTE g = (BYTE)(src >> 8);
-    BYTE r = (BYTE)(src >> 16);
-    DWORD alpha  = (BYTE)(src >> 24);
-    return ((b     + ((BYTE)dst         * (255 - alpha) + 127) / 255) |
-            (g     + ((BYTE)(dst >> 8)  * (255 - alpha) + 127) / 255) << 8 |
-            (r     + ((BYTE)(dst >> 16) * (255 - alpha) + 127) / 255) << 16 |
-            (alpha + ((BYTE)(dst >> 24) * (255 - alpha) + 127) / 255) << 24);
+    return blend_argb_lanes( dst, src & 0x00ff00ff, (src >> 8) & 0x00ff00ff );
 }
 
 static inline DWORD blend_argb_alpha( DWORD dst, DWORD src, DWORD alpha )
 {
-    BYTE b = ((BYTE)src         * alpha + 127) / 255;
-    BYTE g = ((BYTE)(src >> 8)  * alpha + 127) / 255;
-    BYTE r = ((BYTE)(src >> 16) * alpha + 127) / 255;
-    alpha  = ((BYTE)(src >> 24) * alpha + 127) / 255;
-    return ((b     + ((BYTE)dst         * (255 - alpha) + 127) / 255) |
-            (g     + ((BYTE)(dst >> 8)  * (255 - alpha) + 127) / 255) << 8 |
-            (r     + ((BYTE)(dst >> 16) * (255 - alpha) + 127) / 255) << 16 |
-            (alpha + ((BYTE)(dst >> 24) * (255 - alpha) + 127) / 255) << 24);
+    return blend_argb_lanes( dst, div255_lanes( (src & 0x00ff00ff) * alpha ),
+                             div255_lanes( ((src >> 8) & 0x00ff00ff) * alpha ) );
 }
 
 static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BLENDFUNCTION blend )
@@ -4697,7 +4708,12 @@ static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
             if (blend.SourceConstantAlpha == 255)
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
                     for (x = 0; x < rc->right - rc->left; x++)
-                        dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
+                    {
+                        /* opaque pixels replace the destination, and fully transparent
+                         * black ones leave it unchanged */
+                        if (src_ptr[x] >= 0xff000000) dst_ptr[x] = src_ptr[x];
+                        else if (src_ptr[x]) dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
+                    }
             else
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
                     for (x = 0; x < rc->right - rc->left; x++)
@@ -6378,6 +6394,7 @@ static void draw_subpixel_glyph_8888( const dib_info *dib, const RECT *rect, con
         for (x = 0; x < rect->right - rect->left; x++)
         {
             if (glyph_ptr[x] == 0) continue;
+            if (glyph_ptr[x] == 0x00ffffff) { dst_ptr[x] = text_pixel & 0x00ffffff; continue; }
             dst_ptr[x] = blend_subpixel( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x],
                                          text_pixel, glyph_ptr[x], gamma_ramp );
         }
@@ -7481,12 +7498,40 @@ static void calc_halftone_params( const struct bitblt_coords *dst, const struct
     *src_inc_y = mirrored_y ? -(float)src_height / dst_height : (float)src_height / dst_height;
 }
 
+struct halftone_column
+{
+    int   x0, x1;  /* source columns to interpolate between */
+    float dx;      /* weight of the x1 column */
+};
+
+#define HALFTONE_MAX_COLUMNS 256
+
+/* the source columns only depend on the destination column, so compute them
+ * once per strip of destination columns instead of for every row; returns the
+ * source position of the next column */
+static float calc_halftone_columns( struct halftone_column *columns, int count, const RECT *src_rect,
+                                    float float_x, float src_inc_x )
+{
+    int dst_x;
+
+    for (dst_x = 0; dst_x < count; ++dst_x)
+    {
+        float_x = clampf( float_x, src_rect->left, src_rect->right - 1 );
+        columns[dst_x].x0 = float_x;
+        columns[dst_x].x1 = clamp( columns[dst_x].x0 + 1, src_rect->left, src_rect->right - 1 );
+        columns[dst_x].dx = float_x - columns[dst_x].x0;
+        float_x += src_inc_x;
+    }
+    return float_x;
+}
+
 static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *dst,
                           const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, y0, y1, col, count;
     DWORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
     float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    struct halftone_column columns[HALFTONE_MAX_COLUMNS];
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
@@ -7496,60 +7541,62 @@ static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *d
     calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
                           &src_inc_y );
 
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
+    float_x = src_start_x;
+    for (col = 0; col < dst_rect.right - dst_rect.left; col += count)
     {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
+        count = min( dst_rect.right - dst_rect.left - col, HALFTONE_MAX_COLUMNS );
+        float_x = calc_halftone_columns( columns, count, &src_rect, float_x, src_inc_x );
 
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
+        float_y = src_start_y;
+        dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left + col, dst_rect.top );
+        for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
+            y0 = float_y;
+            y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
+            dy = float_y - y0;
 
-            c00_ptr = src_ptr + x0;
-            c01_ptr = src_ptr + x1;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_r = (*c00_ptr >> 16) & 0xff;
-            c01_r = (*c01_ptr >> 16) & 0xff;
-            c10_r = (*c10_ptr >> 16) & 0xff;
-            c11_r = (*c11_ptr >> 16) & 0xff;
-            c00_g = (*c00_ptr >> 8) & 0xff;
-            c01_g = (*c01_ptr >> 8) & 0xff;
-            c10_g = (*c10_ptr >> 8) & 0xff;
-            c11_g = (*c11_ptr >> 8) & 0xff;
-            c00_b = *c00_ptr & 0xff;
-            c01_b = *c01_ptr & 0xff;
-            c10_b = *c10_ptr & 0xff;
-            c11_b = *c11_ptr & 0xff;
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x] = ((r << 16) & 0xff0000) | ((g << 8) & 0x00ff00) | (b & 0x0000ff);
+            src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
+            src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
+            for (dst_x = 0; dst_x < count; ++dst_x)
+            {
+                dx = columns[dst_x].dx;
 
-            float_x += src_inc_x;
-        }
+                c00_ptr = src_ptr + columns[dst_x].x0;
+                c01_ptr = src_ptr + columns[dst_x].x1;
+                c10_ptr = c00_ptr + src_ptr_dy;
+                c11_ptr = c01_ptr + src_ptr_dy;
+                c00_r = (*c00_ptr >> 16) & 0xff;
+                c01_r = (*c01_ptr >> 16) & 0xff;
+                c10_r = (*c10_ptr >> 16) & 0xff;
+                c11_r = (*c11_ptr >> 16) & 0xff;
+                c00_g = (*c00_ptr >> 8) & 0xff;
+                c01_g = (*c01_ptr >> 8) & 0xff;
+                c10_g = (*c10_ptr >> 8) & 0xff;
+                c11_g = (*c11_ptr >> 8) & 0xff;
+                c00_b = *c00_ptr & 0xff;
+                c01_b = *c01_ptr & 0xff;
+                c10_b = *c10_ptr & 0xff;
+                c11_b = *c11_ptr & 0xff;
+                r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
+                g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
+                b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
+                dst_ptr[dst_x] = ((r << 16) & 0xff0000) | ((g << 8) & 0x00ff00) | (b & 0x0000ff);
+            }
 
-        dst_ptr += dst_dib->stride / 4;
-        float_y += src_inc_y;
+            dst_ptr += dst_dib->stride / 4;
+            float_y += src_inc_y;
+        }
     }
 }
 
 static void halftone_32( const dib_info *dst_dib, const struct bitblt_coords *dst,
                          const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, y0, y1, col, count;
     DWORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
     float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    struct halftone_column columns[HALFTONE_MAX_COLUMNS];
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
@@ -7559,60 +7606,62 @@ static void halftone_32( const dib_info *dst_dib, const struct bitblt_coords *ds
     calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
                           &src_inc_y );
 
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
+    float_x = src_start_x;
+    for (col = 0; col < dst_rect.right - dst_rect.left; col += count)
     {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
+        count = min( dst_rect.right - dst_rect.left - col, HALFTONE_MAX_COLUMNS );
+        float_x = calc_halftone_columns( columns, count, &src_rect, float_x, src_inc_x );
 
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
+        float_y = src_start_y;
+        dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left + col, dst_rect.top );
+        for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+            float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
+            y0 = float_y;
+            y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
+            dy = float_y - y0;
 
-            c00_ptr = src_ptr + x0;
-            c01_ptr = src_ptr + x1;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_r = get_field( *c00_ptr, src_dib->red_shift, src_dib->red_len );
-            c01_r = get_field( *c01_ptr, src_dib->red_shift, src_dib->red_len );
-            c10_r = get_field( *c10_ptr, src_dib->red_shift, src_dib->red_len );
-            c11_r = get_field( *c11_ptr, src_dib->red_shift, src_dib->red_len );
-            c00_g = get_field( *c00_ptr, src_dib->green_shift, src_dib->green_len );
-            c01_g = get_field( *c01_ptr, src_dib->green_shift, src_dib->green_len );
-            c10_g = get_field( *c10_ptr, src_dib->green_shift, src_dib->green_len );
-            c11_g = get_field( *c11_ptr, src_dib->green_shift, src_dib->green_len );
-            c00_b = get_field( *c00_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c01_b = get_field( *c01_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c10_b = get_field( *c10_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c11_b = get_field( *c11_ptr, src_dib->blue_shift, src_dib->blue_len );
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x] = rgb_to_pixel_masks( dst_dib, r, g, b );
+            src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
+            src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
+            for (dst_x = 0; dst_x < count; ++dst_x)
+            {
+                dx = columns[dst_x].dx;
 
-            float_x += src_inc_x;
-        }
+                c00_ptr = src_ptr + columns[dst_x].x0;
+                c01_ptr = src_ptr + columns[dst_x].x1;
+                c10_ptr = c00_ptr + src_ptr_dy;
+                c11_ptr = c01_ptr + src_ptr_dy;
+                c00_r = get_field( *c00_ptr, src_dib->red_shift, src_dib->red_len );
+                c01_r = get_field( *c01_ptr, src_dib->red_shift, src_dib->red_len );
+                c10_r = get_field( *c10_ptr, src_dib->red_shift, src_dib->red_len );
+                c11_r = get_field( *c11_ptr, src_dib->red_shift, src_dib->red_len );
+                c00_g = get_field( *c00_ptr, src_dib->green_shift, src_dib->green_len );
+                c01_g = get_field( *c01_ptr, src_dib->green_shift, src_dib->green_len );
+                c10_g = get_field( *c10_ptr, src_dib->green_shift, src_dib->green_len );
+                c11_g = get_field( *c11_ptr, src_dib->green_shift, src_dib->green_len );
+                c00_b = get_field( *c00_ptr, src_dib->blue_shift, src_dib->blue_len );
+                c01_b = get_field( *c01_ptr, src_dib->blue_shift, src_dib->blue_len );
+                c10_b = get_field( *c10_ptr, src_dib->blue_shift, src_dib->blue_len );
+                c11_b = get_field( *c11_ptr, src_dib->blue_shift, src_dib->blue_len );
+                r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
+                g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
+                b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
+                dst_ptr[dst_x] = rgb_to_pixel_masks( dst_dib, r, g, b );
+            }
 
-        dst_ptr += dst_dib->stride / 4;
-        float_y += src_inc_y;
+            dst_ptr += dst_dib->stride / 4;
+            float_y += src_inc_y;
+        }
     }
 }
 
 static void halftone_24( const dib_info *dst_dib, const struct bitblt_coords *dst,
                          const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
+    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, y0, y1, col, count;
     BYTE *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
     float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
+    struct halftone_column columns[HALFTONE_MAX_COLUMNS];
     BYTE c00_r, c01_r, c10_r, c11_r;
     BYTE c00_g, c01_g, c10_g, c11_g;
     BYTE c00_b, c01_b, c10_b, c11_b;
@@ -7622,53 +7671,54 @@ static void halftone_24( const dib_info *dst_dib, const struct bitblt_coords *ds
     calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
                           &src_inc_y );
 
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_24( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
-    {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
-
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_24( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
-        {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
-
-            c00_ptr = src_ptr + x0 * 3;
-            c01_ptr = src_ptr + x1 * 3;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_b = c00_ptr[0];
-            c01_b = c01_ptr[0];
-            c10_b = c10_ptr[0];
-            c11_b = c11_ptr[0];
-            c00_g = c00_ptr[1];
-            c01_g = c01_ptr[1];
-            c10_g = c10_ptr[1];
-            c11_g = c11_ptr[1];
-            c00_r = c00_ptr[2];
-            c01_r = c01_ptr[2];
-            c10_r = c10_ptr[2];
-            c11_r = c11_ptr[2];
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x * 3] = b;
-            dst_ptr[dst_x * 3 + 1] = g;
-            dst_ptr[dst_x * 3 + 2] = r;
-
-            float_x += src_inc_x;
+    float_x = src_start_x;
+    for (col = 0; col < dst_rect.right - dst_rect.left; col += count)
+    {
+        count = min( dst_rect.right - dst_rect.left - col, HALFTONE_MAX_COLUMNS );
+        float_x = calc_halftone_columns( columns, count, &src_rect, float_x, src_inc_x );
+
+        float_y = src_start_y;
+        dst_ptr = get_pixel_ptr_24( dst_dib, dst_rect.left + col, dst_rect.top );
+        for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
+        {
+            float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
+            y0 = float_y;
+            y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
+            dy = float_y - y0;
+
+            src_ptr = get_pixel_ptr_24( src_dib, 0, y0 );
+            src_ptr_dy = (y1 - y0) * src_dib->stride;
+            for (dst_x = 0; dst_x < count; ++dst_x)
+            {
+                dx = columns[dst_x].dx;
+
+                c00_ptr = src_ptr + columns[dst_x].x0 * 3;
+                c01_ptr = src_ptr + columns[dst_x].x1 * 3;
+                c10_ptr = c00_ptr + src_ptr_dy;
+                c11_ptr = c01_ptr + src_ptr_dy;
+                c00_b = c00_ptr[0];
+                c01_b = c01_ptr[0];
+                c10_b = c10_ptr[0];
+                c11_b = c11_ptr[0];
+                c00_g = c00_ptr[1];
+                c01_g = c01_ptr[1];
+                c10_g = c10_ptr[1];
+                c11_g = c11_ptr[1];
+                c00_r = c00_ptr[2];
+                c01_r = c01_ptr[2];
+                c10_r = c10_ptr[2];
+                c11_r = c11_ptr[2];
+                r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
+                g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
+                b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
+                dst_ptr[dst_x * 3] = b;
+                dst_ptr[dst_x * 3 + 1] = g;
+                dst_ptr[dst_x * 3 + 2] = r;
+            }
+
+            dst_ptr += dst_dib->stride;
+            float_y += src_inc_y;
         }
-
-        dst_ptr += dst_dib->stride;
-        float_y += src_inc_y;
     }
 }
 
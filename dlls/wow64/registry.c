@@ -450,6 +450,19 @@ NTSTATUS WINAPI wow64_NtSaveKey( UINT *args )
 }
 
 
+/**********************************************************************
+ *           wow64_NtSaveKeyEx
+ */
+NTSTATUS WINAPI wow64_NtSaveKeyEx( UINT *args )
+{
+    HANDLE key = get_handle( &args );
+    HANDLE file = get_handle( &args );
+    ULONG format = get_ulong( &args );
+
+    return NtSaveKeyEx( key, file, format );
+}
+
+
 /**********************************************************************
  *           wow64_NtSetInformationKey
  */
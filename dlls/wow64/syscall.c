@@ -364,6 +364,37 @@ NTSTATUS WINAPI wow64_wine_server_call( UINT *args )
 }
 
 
+/**********************************************************************
+ *           wow64_wine_server_call_batch
+ */
+NTSTATUS WINAPI wow64_wine_server_call_batch( UINT *args )
+{
+    struct __server_request_info32 *reqs32 = get_ptr( &args );
+    ULONG count = get_ulong( &args );
+
+    unsigned int i, j;
+    NTSTATUS status;
+    struct __server_request_info *reqs;
+
+    if (count > __SERVER_MAX_BATCH) return STATUS_INVALID_PARAMETER;
+    reqs = Wow64AllocateTemp( count * sizeof(*reqs) );
+    for (i = 0; i < count; i++)
+    {
+        reqs[i].u.req = reqs32[i].u.req;
+        reqs[i].data_count = reqs32[i].data_count;
+        for (j = 0; j < reqs[i].data_count; j++)
+        {
+            reqs[i].data[j].ptr = ULongToPtr( reqs32[i].data[j].ptr );
+            reqs[i].data[j].size = reqs32[i].data[j].size;
+        }
+        reqs[i].reply_data = ULongToPtr( reqs32[i].reply_data );
+    }
+    status = wine_server_call_batch( reqs, count );
+    for (i = 0; i < count; i++) reqs32[i].u.reply = reqs[i].u.reply;
+    return status;
+}
+
+
 /**********************************************************************
  *           get_syscall_num
  */
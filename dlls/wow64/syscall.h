@@ -198,6 +198,7 @@
     SYSCALL_ENTRY( NtResumeProcess ) \
     SYSCALL_ENTRY( NtResumeThread ) \
     SYSCALL_ENTRY( NtSaveKey ) \
+    SYSCALL_ENTRY( NtSaveKeyEx ) \
     SYSCALL_ENTRY( NtSecureConnectPort ) \
     SYSCALL_ENTRY( NtSetContextThread ) \
     SYSCALL_ENTRY( NtSetDebugFilterState ) \
@@ -258,6 +259,7 @@
     SYSCALL_ENTRY( __wine_unix_spawnvp ) \
     SYSCALL_ENTRY( wine_nt_to_unix_file_name ) \
     SYSCALL_ENTRY( wine_server_call ) \
+    SYSCALL_ENTRY( wine_server_call_batch ) \
     SYSCALL_ENTRY( wine_server_fd_to_handle ) \
     SYSCALL_ENTRY( wine_server_handle_to_fd ) \
     SYSCALL_ENTRY( wine_unix_to_nt_file_name )
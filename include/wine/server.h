@@ -36,6 +36,7 @@ struct __server_iovec
 };
 
 #define __SERVER_MAX_DATA 5
+#define __SERVER_MAX_BATCH 64
 
 struct __server_request_info
 {
@@ -50,6 +51,7 @@ struct __server_request_info
 };
 
 extern unsigned int CDECL wine_server_call( void *req_ptr );
+extern unsigned int CDECL wine_server_call_batch( struct __server_request_info *reqs, unsigned int count );
 extern NTSTATUS CDECL wine_server_fd_to_handle( int fd, unsigned int access, unsigned int attributes, HANDLE *handle );
 extern NTSTATUS CDECL wine_server_handle_to_fd( HANDLE handle, unsigned int access, int *unix_fd, unsigned int *options );
 
@@ -136,5 +138,24 @@ static inline void *wine_server_get_ptr( client_ptr_t ptr )
         while(0); \
     } while(0)
 
+/* batched requests: the requests must be independent of each other, must not block,
+ * and must not transfer file descriptors; they are sent with wine_server_call_batch()
+ * and each reply carries its own status in reply_header.error */
+
+static inline void *wine_server_init_batch_req( struct __server_request_info *req, enum request type )
+{
+    memset( &req->u.req, 0, sizeof(req->u.req) );
+    req->u.req.request_header.req = type;
+    req->data_count = 0;
+    req->reply_data = NULL;
+    return &req->u.req;
+}
+
+#define SERVER_BATCH_REQ(info,type) \
+    ((struct type##_request *)wine_server_init_batch_req( (info), REQ_##type ))
+
+#define SERVER_BATCH_REPLY(info,type) \
+    ((const struct type##_reply *)&(info)->u.reply.type##_reply)
+
 
 #endif  /* __WINE_WINE_SERVER_H */
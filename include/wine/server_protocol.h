@@ -858,6 +858,51 @@ struct cpu_topology_override
 
 
 
+typedef struct
+{
+    unsigned int   seq;
+    process_id_t   pid;
+    process_id_t   ppid;
+    int            exit_code;
+    affinity_t     affinity;
+    client_ptr_t   peb;
+    timeout_t      start_time;
+    unsigned int   session_id;
+    int            priority;
+    int            running_threads;
+    unsigned short machine;
+    unsigned short __pad;
+} process_snapshot_t;
+
+typedef struct
+{
+    unsigned int   seq;
+    thread_id_t    tid;
+    affinity_t     affinity;
+    client_ptr_t   entry_point;
+    timeout_t      creation_time;
+    int            priority;
+    int            suspend_count;
+    int            dbg_hidden;
+    int            unix_tid;
+} thread_snapshot_t;
+
+#define MAX_SNAPSHOT_THREADS 1024
+
+typedef struct
+{
+    process_snapshot_t process;
+    thread_snapshot_t  threads[MAX_SNAPSHOT_THREADS];
+} process_shm_t;
+
+
+#define REGISTRY_CACHE_SLOTS 65536
+
+
+#define BATCH_ALIGN(size) (((size) + 7) & ~7)
+
+
+
 
 
 struct new_process_request
@@ -977,6 +1022,8 @@ struct init_first_thread_reply
     timeout_t    server_start;
     unsigned int session_id;
     data_size_t  info_size;
+    obj_handle_t shm_handle;
+    unsigned int shm_slot;
     /* VARARG(machines,ushorts); */
 };
 
@@ -995,7 +1042,7 @@ struct init_thread_reply
 {
     struct reply_header __header;
     int          suspend;
-    char __pad_12[4];
+    unsigned int shm_slot;
 };
 
 
@@ -1106,6 +1153,20 @@ struct get_process_vm_counters_reply
 
 
 
+struct get_process_handle_count_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_process_handle_count_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    unsigned int max_count;
+};
+
+
+
 struct set_process_info_request
 {
     struct request_header __header;
@@ -1994,6 +2055,36 @@ struct unmap_view_reply
 
 
 
+struct get_image_relocs_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+    client_ptr_t base;
+};
+struct get_image_relocs_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    int          fill;
+};
+
+
+
+struct set_image_relocs_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+    client_ptr_t base;
+    int          success;
+    char __pad_28[4];
+};
+struct set_image_relocs_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct get_mapping_committed_range_request
 {
     struct request_header __header;
@@ -2346,11 +2437,27 @@ struct get_key_value_reply
     struct reply_header __header;
     int          type;
     data_size_t  total;
+    unsigned int cache_slot;
+    unsigned int cache_gen;
     /* VARARG(data,bytes); */
 };
 
 
 
+struct get_registry_cache_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_registry_cache_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
 struct enum_key_value_request
 {
     struct request_header __header;
@@ -5697,6 +5804,21 @@ struct get_fsync_apc_idx_reply
 };
 
 
+struct batch_requests_request
+{
+    struct request_header __header;
+    unsigned int count;
+    /* VARARG(requests,bytes); */
+};
+struct batch_requests_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    /* VARARG(replies,bytes); */
+    char __pad_12[4];
+};
+
+
 enum request
 {
     REQ_new_process,
@@ -5712,6 +5834,7 @@ enum request
     REQ_get_process_debug_info,
     REQ_get_process_image_name,
     REQ_get_process_vm_counters,
+    REQ_get_process_handle_count,
     REQ_set_process_info,
     REQ_get_thread_info,
     REQ_get_thread_times,
@@ -5765,6 +5888,8 @@ enum request
     REQ_get_mapping_info,
     REQ_map_view,
     REQ_unmap_view,
+    REQ_get_image_relocs,
+    REQ_set_image_relocs,
     REQ_get_mapping_committed_range,
     REQ_add_mapping_committed_range,
     REQ_is_same_mapping,
@@ -5786,6 +5911,7 @@ enum request
     REQ_enum_key,
     REQ_set_key_value,
     REQ_get_key_value,
+    REQ_get_registry_cache,
     REQ_enum_key_value,
     REQ_delete_key_value,
     REQ_load_registry,
@@ -5988,6 +6114,7 @@ enum request
     REQ_get_fsync_idx,
     REQ_fsync_msgwait,
     REQ_get_fsync_apc_idx,
+    REQ_batch_requests,
     REQ_NB_REQUESTS
 };
 
@@ -6008,6 +6135,7 @@ union generic_request
     struct get_process_debug_info_request get_process_debug_info_request;
     struct get_process_image_name_request get_process_image_name_request;
     struct get_process_vm_counters_request get_process_vm_counters_request;
+    struct get_process_handle_count_request get_process_handle_count_request;
     struct set_process_info_request set_process_info_request;
     struct get_thread_info_request get_thread_info_request;
     struct get_thread_times_request get_thread_times_request;
@@ -6061,6 +6189,8 @@ union generic_request
     struct get_mapping_info_request get_mapping_info_request;
     struct map_view_request map_view_request;
     struct unmap_view_request unmap_view_request;
+    struct get_image_relocs_request get_image_relocs_request;
+    struct set_image_relocs_request set_image_relocs_request;
     struct get_mapping_committed_range_request get_mapping_committed_range_request;
     struct add_mapping_committed_range_request add_mapping_committed_range_request;
     struct is_same_mapping_request is_same_mapping_request;
@@ -6082,6 +6212,7 @@ union generic_request
     struct enum_key_request enum_key_request;
     struct set_key_value_request set_key_value_request;
     struct get_key_value_request get_key_value_request;
+    struct get_registry_cache_request get_registry_cache_request;
     struct enum_key_value_request enum_key_value_request;
     struct delete_key_value_request delete_key_value_request;
     struct load_registry_request load_registry_request;
@@ -6284,6 +6415,7 @@ union generic_request
     struct get_fsync_idx_request get_fsync_idx_request;
     struct fsync_msgwait_request fsync_msgwait_request;
     struct get_fsync_apc_idx_request get_fsync_apc_idx_request;
+    struct batch_requests_request batch_requests_request;
 };
 union generic_reply
 {
@@ -6302,6 +6434,7 @@ union generic_reply
     struct get_process_debug_info_reply get_process_debug_info_reply;
     struct get_process_image_name_reply get_process_image_name_reply;
     struct get_process_vm_counters_reply get_process_vm_counters_reply;
+    struct get_process_handle_count_reply get_process_handle_count_reply;
     struct set_process_info_reply set_process_info_reply;
     struct get_thread_info_reply get_thread_info_reply;
     struct get_thread_times_reply get_thread_times_reply;
@@ -6355,6 +6488,8 @@ union generic_reply
     struct get_mapping_info_reply get_mapping_info_reply;
     struct map_view_reply map_view_reply;
     struct unmap_view_reply unmap_view_reply;
+    struct get_image_relocs_reply get_image_relocs_reply;
+    struct set_image_relocs_reply set_image_relocs_reply;
     struct get_mapping_committed_range_reply get_mapping_committed_range_reply;
     struct add_mapping_committed_range_reply add_mapping_committed_range_reply;
     struct is_same_mapping_reply is_same_mapping_reply;
@@ -6376,6 +6511,7 @@ union generic_reply
     struct enum_key_reply enum_key_reply;
     struct set_key_value_reply set_key_value_reply;
     struct get_key_value_reply get_key_value_reply;
+    struct get_registry_cache_reply get_registry_cache_reply;
     struct enum_key_value_reply enum_key_value_reply;
     struct delete_key_value_reply delete_key_value_reply;
     struct load_registry_reply load_registry_reply;
@@ -6578,11 +6714,12 @@ union generic_reply
     struct get_fsync_idx_reply get_fsync_idx_reply;
     struct fsync_msgwait_reply fsync_msgwait_reply;
     struct get_fsync_apc_idx_reply get_fsync_apc_idx_reply;
+    struct batch_requests_reply batch_requests_reply;
 };
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 760
+#define SERVER_PROTOCOL_VERSION 770
 
 /* ### protocol_version end ### */
 
@@ -5537,6 +5537,11 @@ typedef struct _TAPE_GET_MEDIA_PARAMETERS {
 #define REG_APP_HIVE            0x00000010
 #define REG_PROCESS_PRIVATE     0x00000020
 
+/* for RegSaveKeyEx flags */
+#define REG_STANDARD_FORMAT     1
+#define REG_LATEST_FORMAT       2
+#define REG_NO_COMPRESSION      4
+
 #define KEY_READ	      ((STANDARD_RIGHTS_READ|  \
 				KEY_QUERY_VALUE|  \
 				KEY_ENUMERATE_SUB_KEYS|  \
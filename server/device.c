@@ -853,6 +853,8 @@ static void device_manager_destroy( struct object *obj )
 
     if (do_esync())
         close( manager->esync_fd );
+    if (do_fsync())
+        fsync_free_shm( manager->fsync_idx );
 }
 
 static struct device_manager *create_device_manager(void)
@@ -1679,6 +1679,8 @@ static void fd_destroy( struct object *obj )
 
     if (do_esync())
         close( fd->esync_fd );
+    if (do_fsync())
+        fsync_free_shm( fd->fsync_idx );
 }
 
 /* check if the desired access is possible without violating */
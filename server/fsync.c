@@ -25,6 +25,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <sys/mman.h>
 #ifdef HAVE_SYS_STAT_H
 # include <sys/stat.h>
@@ -85,8 +86,11 @@ static long pagesize;
 
 static int is_fsync_initialized;
 
+static void dump_shm_stats(void);
+
 static void shm_cleanup(void)
 {
+    if (debug_level) dump_shm_stats();
     close( shm_fd );
     if (shm_unlink( shm_name ) == -1)
         perror( "shm_unlink" );
@@ -197,12 +201,22 @@ static void fsync_destroy( struct object *obj )
     struct fsync *fsync = (struct fsync *)obj;
     if (fsync->type == FSYNC_MUTEX)
         list_remove( &fsync->mutex_entry );
+    fsync_free_shm( fsync->shm_idx );
 }
 
+/* layout of a shm slot; the meaning of the first two fields depends on the object type */
+struct fsync_slot
+{
+    int          low;
+    int          high;
+    int          ref;  /* references held by the server object and by clients using the slot */
+    unsigned int gen;  /* generation, incremented every time the slot is reused */
+};
+
 static void *get_shm( unsigned int idx )
 {
-    int entry  = (idx * 8) / pagesize;
-    int offset = (idx * 8) % pagesize;
+    int entry  = (idx * sizeof(struct fsync_slot)) / pagesize;
+    int offset = (idx * sizeof(struct fsync_slot)) % pagesize;
 
     if (entry >= shm_addrs_size)
     {
@@ -235,38 +249,178 @@ static void *get_shm( unsigned int idx )
     return (void *)((unsigned long)shm_addrs[entry] + offset);
 }
 
-/* FIXME: This is rather inefficient... */
-static unsigned int shm_idx_counter = 1;
+/* Slot allocator. Freed slots are tracked in a bitmap and the lowest free
+ * index is always reused first, so that live slots stay packed at the start
+ * of the file and pages that become entirely free can be given back to the
+ * system. A slot is only reused once its reference count drops to zero, i.e.
+ * once no client is using it anymore; clients check the generation to detect
+ * that a cached slot has been reused for another object. */
+
+static unsigned int shm_idx_limit = 1;   /* first index never allocated so far; 0 is reserved */
+static unsigned int shm_capacity;        /* number of slots the arrays below can describe */
+static unsigned int *shm_free_map;       /* bitmap of free slots below shm_idx_limit */
+static unsigned int shm_free_hint;       /* lowest word of the bitmap that may contain a free slot */
+static unsigned int *shm_gens;           /* current generation of each slot */
+static unsigned short *shm_page_live;    /* number of allocated slots in each page */
+static unsigned int *shm_deferred;       /* freed slots still referenced by clients */
+static unsigned int shm_deferred_count;
+static unsigned int shm_deferred_size;
+
+/* slot statistics */
+static unsigned int shm_live_count;
+static unsigned int shm_free_count;
+static unsigned int shm_peak_count;
+
+static unsigned int slots_per_page(void)
+{
+    return pagesize / sizeof(struct fsync_slot);
+}
+
+static void dump_shm_stats(void)
+{
+    fprintf( stderr, "fsync: %u live, %u free, %u deferred, %u peak slots (%jd bytes)\n",
+             shm_live_count, shm_free_count, shm_deferred_count, shm_peak_count, (intmax_t)shm_size );
+}
+
+static int grow_shm_arrays( unsigned int idx )
+{
+    unsigned int new_capacity = max( shm_capacity * 2, 4096 );
+    unsigned int *new_map, *new_gens;
+    unsigned short *new_live;
+    unsigned int pages;
+
+    while (new_capacity <= idx) new_capacity *= 2;
+    pages = (new_capacity + slots_per_page() - 1) / slots_per_page();
+
+    if (!(new_map = realloc( shm_free_map, new_capacity / 32 * sizeof(*new_map) ))) return 0;
+    shm_free_map = new_map;
+    if (!(new_gens = realloc( shm_gens, new_capacity * sizeof(*new_gens) ))) return 0;
+    shm_gens = new_gens;
+    if (!(new_live = realloc( shm_page_live, pages * sizeof(*new_live) ))) return 0;
+    shm_page_live = new_live;
+
+    memset( shm_free_map + shm_capacity / 32, 0, (new_capacity - shm_capacity) / 32 * sizeof(*new_map) );
+    memset( shm_gens + shm_capacity, 0, (new_capacity - shm_capacity) * sizeof(*new_gens) );
+    if (shm_capacity)
+    {
+        unsigned int old_pages = (shm_capacity + slots_per_page() - 1) / slots_per_page();
+        memset( shm_page_live + old_pages, 0, (pages - old_pages) * sizeof(*new_live) );
+    }
+    else memset( shm_page_live, 0, pages * sizeof(*new_live) );
+    shm_capacity = new_capacity;
+    return 1;
+}
+
+/* return the lowest free slot from the bitmap, or 0 if there is none */
+static unsigned int get_free_slot(void)
+{
+    unsigned int i, words = (shm_idx_limit + 31) / 32;
+
+    for (i = shm_free_hint; i < words; i++)
+    {
+        if (shm_free_map[i])
+        {
+            unsigned int bit = __builtin_ctz( shm_free_map[i] );
+            shm_free_map[i] &= ~(1u << bit);
+            shm_free_hint = i;
+            shm_free_count--;
+            return i * 32 + bit;
+        }
+    }
+    shm_free_hint = words;
+    return 0;
+}
+
+/* mark a slot as free once it's no longer referenced */
+static void release_slot( unsigned int idx )
+{
+    unsigned int page = idx / slots_per_page();
+
+    shm_free_map[idx / 32] |= 1u << (idx % 32);
+    if (idx / 32 < shm_free_hint) shm_free_hint = idx / 32;
+    shm_free_count++;
+    shm_live_count--;
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+    /* give back the memory of pages without any allocated slot; the contents
+     * read back as zeroes, which is what a free slot looks like to clients */
+    if (!--shm_page_live[page] &&
+        fallocate( shm_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)page * pagesize, pagesize ) == -1 &&
+        debug_level)
+        perror( "fsync: fallocate" );
+#else
+    shm_page_live[page]--;
+#endif
+}
+
+/* reclaim the freed slots which clients have stopped using since */
+static void reclaim_deferred_slots(void)
+{
+    unsigned int i = 0;
+
+    while (i < shm_deferred_count)
+    {
+        struct fsync_slot *slot = get_shm( shm_deferred[i] );
+
+        if (__atomic_load_n( &slot->ref, __ATOMIC_SEQ_CST ))
+        {
+            i++;
+            continue;
+        }
+        release_slot( shm_deferred[i] );
+        shm_deferred[i] = shm_deferred[--shm_deferred_count];
+    }
+}
 
 unsigned int fsync_alloc_shm( int low, int high )
 {
 #ifdef __linux__
-    int shm_idx;
-    int *shm;
+    struct fsync_slot *slot;
+    unsigned int shm_idx;
 
     /* this is arguably a bit of a hack, but we need some way to prevent
      * allocating shm for the master socket */
     if (!is_fsync_initialized)
         return 0;
 
-    shm_idx = shm_idx_counter++;
+    if (shm_deferred_count) reclaim_deferred_slots();
 
-    while (shm_idx * 8 >= shm_size)
+    if (!(shm_idx = get_free_slot()))
     {
-        /* Better expand the shm section. */
-        shm_size += pagesize;
-        if (ftruncate( shm_fd, shm_size ) == -1)
+        shm_idx = shm_idx_limit;
+        if (shm_idx >= shm_capacity && !grow_shm_arrays( shm_idx ))
         {
-            fprintf( stderr, "fsync: couldn't expand %s to size %jd: ",
-                shm_name, shm_size );
-            perror( "ftruncate" );
+            fprintf( stderr, "fsync: couldn't grow the slot arrays to %u entries\n", shm_idx + 1 );
+            return 0;
         }
+        shm_idx_limit++;
+
+        while ((shm_idx + 1) * sizeof(struct fsync_slot) > shm_size)
+        {
+            /* Better expand the shm section. */
+            shm_size += pagesize;
+            if (ftruncate( shm_fd, shm_size ) == -1)
+            {
+                fprintf( stderr, "fsync: couldn't expand %s to size %jd: ",
+                    shm_name, (intmax_t)shm_size );
+                perror( "ftruncate" );
+            }
+        }
+    }
+
+    shm_page_live[shm_idx / slots_per_page()]++;
+    if (++shm_live_count > shm_peak_count)
+    {
+        shm_peak_count = shm_live_count;
+        if (debug_level && !(shm_peak_count & (shm_peak_count - 1))) dump_shm_stats();
     }
 
-    shm = get_shm( shm_idx );
-    assert(shm);
-    shm[0] = low;
-    shm[1] = high;
+    slot = get_shm( shm_idx );
+    assert(slot);
+    slot->low  = low;
+    slot->high = high;
+    __atomic_store_n( &slot->gen, ++shm_gens[shm_idx], __ATOMIC_SEQ_CST );
+    __atomic_store_n( &slot->ref, 1, __ATOMIC_SEQ_CST );
 
     return shm_idx;
 #else
@@ -274,6 +428,38 @@ unsigned int fsync_alloc_shm( int low, int high )
 #endif
 }
 
+/* drop the server reference to a slot; it is reused once clients are done with it */
+void fsync_free_shm( unsigned int shm_idx )
+{
+#ifdef __linux__
+    struct fsync_slot *slot;
+
+    if (!shm_idx) return;
+
+    if (debug_level > 1)
+        fprintf( stderr, "fsync_free_shm: index %u\n", shm_idx );
+
+    slot = get_shm( shm_idx );
+    if (!__atomic_sub_fetch( &slot->ref, 1, __ATOMIC_SEQ_CST ))
+    {
+        release_slot( shm_idx );
+        return;
+    }
+
+    if (shm_deferred_count == shm_deferred_size)
+    {
+        unsigned int new_size = max( shm_deferred_size * 2, 64 );
+        unsigned int *new_deferred;
+
+        /* if we can't keep track of it, the slot is simply leaked */
+        if (!(new_deferred = realloc( shm_deferred, new_size * sizeof(*new_deferred) ))) return;
+        shm_deferred = new_deferred;
+        shm_deferred_size = new_size;
+    }
+    shm_deferred[shm_deferred_count++] = shm_idx;
+#endif
+}
+
 static int type_matches( enum fsync_type type1, enum fsync_type type2 )
 {
     return (type1 == type2) ||
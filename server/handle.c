@@ -41,8 +41,9 @@
 
 struct handle_entry
 {
-    struct object *ptr;       /* object */
+    struct object *ptr;       /* object, NULL if the entry is free */
     unsigned int   access;    /* access rights */
+    int            next_free; /* next entry in the free list, if the entry is free */
 };
 
 struct handle_table
@@ -51,7 +52,10 @@ struct handle_table
     struct process      *process;     /* process owning this table */
     int                  count;       /* number of allocated entries */
     int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
+    int                  used;        /* highest entry initialized so far, entries above are fresh */
+    int                  free;        /* head of the list of free entries up to used, or -1 */
+    int                  max_used;    /* high-water mark of the number of handles in use */
+    int                  in_use;      /* number of handles in use */
     struct handle_entry *entries;     /* handle entries */
 };
 
@@ -153,8 +157,8 @@ static void handle_table_dump( struct object *obj, int verbose )
 
     assert( obj->ops == &handle_table_ops );
 
-    fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
-             table->last, table->count, table->process );
+    fprintf( stderr, "Handle table last=%d count=%d in_use=%d max=%d process=%p\n",
+             table->last, table->count, table->in_use, table->max_used, table->process );
     if (!verbose) return;
     entry = table->entries;
     for (i = 0; i <= table->last; i++, entry++)
@@ -207,10 +211,13 @@ struct handle_table *alloc_handle_table( struct process *process, int count )
     if (count < MIN_HANDLE_ENTRIES) count = MIN_HANDLE_ENTRIES;
     if (!(table = alloc_object( &handle_table_ops )))
         return NULL;
-    table->process = process;
-    table->count   = count;
-    table->last    = -1;
-    table->free    = 0;
+    table->process  = process;
+    table->count    = count;
+    table->last     = -1;
+    table->used     = -1;
+    table->free     = -1;
+    table->max_used = 0;
+    table->in_use   = 0;
     if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
     release_object( table );
     return NULL;
@@ -233,26 +240,61 @@ static int grow_handle_table( struct handle_table *table )
     return 1;
 }
 
-/* allocate the first free entry in the handle table */
+/* rebuild the free list from the entries up to the last used one */
+static void rebuild_free_list( struct handle_table *table )
+{
+    int i;
+
+    table->used = table->last;
+    table->free = -1;
+    table->in_use = 0;
+    for (i = table->used; i >= 0; i--)
+    {
+        if (table->entries[i].ptr)
+        {
+            table->in_use++;
+            continue;
+        }
+        table->entries[i].next_free = table->free;
+        table->free = i;
+    }
+    table->max_used = max( table->max_used, table->in_use );
+}
+
+/* allocate a free entry in the handle table, most recently freed first */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
+    struct handle_entry *entry;
     int i;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    if ((i = table->free) != -1)
+    {
+        entry = table->entries + i;
+        table->free = entry->next_free;
+    }
+    else
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        i = table->used + 1;
+        if (i >= table->count && !grow_handle_table( table )) return 0;
+        table->used = i;
+        entry = table->entries + i;
     }
-    table->last = i;
- found:
-    table->free = i + 1;
+    if (i > table->last) table->last = i;
+    if (++table->in_use > table->max_used) table->max_used = table->in_use;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
     return index_to_handle(i);
 }
 
+/* put an entry back in the free list */
+static void free_entry( struct handle_table *table, struct handle_entry *entry )
+{
+    entry->ptr = NULL;
+    entry->next_free = table->free;
+    table->free = entry - table->entries;
+    table->in_use--;
+}
+
 /* allocate a handle for an object, incrementing its refcount */
 static obj_handle_t alloc_handle_entry( struct process *process, void *ptr,
                                         unsigned int access, unsigned int attr )
@@ -352,6 +394,8 @@ static void shrink_handle_table( struct handle_table *table )
     if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
     table->count   = count;
     table->entries = new_entries;
+    /* drop the entries beyond the last one from the free list */
+    rebuild_free_list( table );
 }
 
 static void inherit_handle( struct process *parent, const obj_handle_t handle, struct handle_table *table )
@@ -414,6 +458,7 @@ struct handle_table *copy_handle_table( struct process *process, struct process
             }
         }
     }
+    rebuild_free_list( table );
     /* attempt to shrink the table */
     shrink_handle_table( table );
     return table;
@@ -430,9 +475,8 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
-    entry->ptr = NULL;
     table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
+    free_entry( table, entry );
     if (entry == table->entries + table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
@@ -634,11 +678,25 @@ obj_handle_t open_object( struct process *process, obj_handle_t parent, unsigned
     return handle;
 }
 
-/* return the size of the handle table of a given process */
+/* return the number of handles in use in a given process */
 unsigned int get_handle_table_count( struct process *process )
 {
     if (!process->handles) return 0;
-    return process->handles->count;
+    return process->handles->in_use;
+}
+
+/* retrieve the handle counts of a process */
+DECL_HANDLER(get_process_handle_count)
+{
+    struct process *process;
+
+    if (!(process = get_process_from_handle( req->handle, PROCESS_QUERY_LIMITED_INFORMATION ))) return;
+    if (process->handles)
+    {
+        reply->count     = process->handles->in_use;
+        reply->max_count = process->handles->max_used;
+    }
+    release_object( process );
 }
 
 /* close a handle */
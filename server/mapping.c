@@ -125,6 +125,52 @@ static const struct object_ops shared_map_ops =
 
 static struct list shared_map_list = LIST_INIT( shared_map_list );
 
+struct memory_view;
+
+/* file holding the relocated pages of a PE image mapped away from its preferred base */
+struct image_relocs
+{
+    struct object   obj;             /* object header */
+    struct fd      *fd;              /* file descriptor of the mapped PE file */
+    file_pos_t      size;            /* size of the PE file when the pages were relocated */
+    timeout_t       mtime;           /* modification time of the PE file at that point */
+    client_ptr_t    base;            /* address the pages are relocated for */
+    struct file    *file;            /* temp file holding the relocated pages */
+    struct memory_view *filler;      /* view whose process is storing the pages, NULL once complete */
+    struct list     entry;           /* entry in global relocs list, empty if abandoned */
+};
+
+static void image_relocs_dump( struct object *obj, int verbose );
+static void image_relocs_destroy( struct object *obj );
+
+static const struct object_ops image_relocs_ops =
+{
+    sizeof(struct image_relocs), /* size */
+    &no_type,                  /* type */
+    image_relocs_dump,         /* dump */
+    no_add_queue,              /* add_queue */
+    NULL,                      /* remove_queue */
+    NULL,                      /* signaled */
+    NULL,                      /* get_esync_fd */
+    NULL,                      /* get_fsync_idx */
+    NULL,                      /* satisfied */
+    no_signal,                 /* signal */
+    no_get_fd,                 /* get_fd */
+    default_map_access,        /* map_access */
+    default_get_sd,            /* get_sd */
+    default_set_sd,            /* set_sd */
+    no_get_full_name,          /* get_full_name */
+    no_lookup_name,            /* lookup_name */
+    no_link_name,              /* link_name */
+    NULL,                      /* unlink_name */
+    no_open_file,              /* open_file */
+    no_kernel_obj_list,        /* get_kernel_obj_list */
+    no_close_handle,           /* close_handle */
+    image_relocs_destroy       /* destroy */
+};
+
+static struct list image_relocs_list = LIST_INIT( image_relocs_list );
+
 /* memory view mapped in client address space */
 struct memory_view
 {
@@ -132,6 +178,7 @@ struct memory_view
     struct fd      *fd;              /* fd for mapped file */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct image_relocs *relocs;     /* relocated pages for a PE image not at its base */
     pe_image_info_t image;           /* image info (for PE image mapping) */
     unsigned int    flags;           /* SEC_* flags */
     client_ptr_t    base;            /* view base address (in process addr space) */
@@ -246,6 +293,22 @@ static void shared_map_destroy( struct object *obj )
     list_remove( &shared->entry );
 }
 
+static void image_relocs_dump( struct object *obj, int verbose )
+{
+    struct image_relocs *relocs = (struct image_relocs *)obj;
+    fprintf( stderr, "Image relocations fd=%p base=%08x%08x file=%p\n", relocs->fd,
+             (unsigned int)(relocs->base >> 32), (unsigned int)relocs->base, relocs->file );
+}
+
+static void image_relocs_destroy( struct object *obj )
+{
+    struct image_relocs *relocs = (struct image_relocs *)obj;
+
+    release_object( relocs->fd );
+    release_object( relocs->file );
+    list_remove( &relocs->entry );
+}
+
 /* extend a file beyond the current end of file */
 int grow_file( int unix_fd, file_pos_t new_size )
 {
@@ -426,6 +489,17 @@ static void free_memory_view( struct memory_view *view )
     if (view->fd) release_object( view->fd );
     if (view->committed) release_object( view->committed );
     if (view->shared) release_object( view->shared );
+    if (view->relocs)
+    {
+        /* the pages will never be completed, let another process store them */
+        if (view->relocs->filler == view)
+        {
+            view->relocs->filler = NULL;
+            list_remove( &view->relocs->entry );
+            list_init( &view->relocs->entry );
+        }
+        release_object( view->relocs );
+    }
     list_remove( &view->entry );
     free( view );
 }
@@ -1120,6 +1194,23 @@ struct object *create_user_data_mapping( struct object *root, const struct unico
     return &mapping->obj;
 }
 
+/* create an anonymous mapping that is also mapped writable in the server */
+struct object *create_server_shared_mapping( mem_size_t size, void **ptr )
+{
+    struct mapping *mapping;
+
+    if (!(mapping = create_mapping( NULL, NULL, 0, size, SEC_COMMIT, 0,
+                                    FILE_READ_DATA | FILE_WRITE_DATA, NULL ))) return NULL;
+    *ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (*ptr == MAP_FAILED)
+    {
+        file_set_error();
+        release_object( mapping );
+        return NULL;
+    }
+    return &mapping->obj;
+}
+
 /* create a file mapping */
 DECL_HANDLER(create_mapping)
 {
@@ -1259,6 +1350,7 @@ DECL_HANDLER(map_view)
         view->fd        = !is_fd_removable( mapping->fd ) ? (struct fd *)grab_object( mapping->fd ) : NULL;
         view->committed = mapping->committed ? (struct ranges *)grab_object( mapping->committed ) : NULL;
         view->shared    = mapping->shared ? (struct shared_map *)grab_object( mapping->shared ) : NULL;
+        view->relocs    = NULL;
         if (view->flags & SEC_IMAGE) view->image = mapping->image;
         add_process_view( current, view );
         if (view->flags & SEC_IMAGE && view->base != mapping->image.base)
@@ -1279,6 +1371,108 @@ DECL_HANDLER(unmap_view)
     free_memory_view( view );
 }
 
+/* get the size and modification time of a mapped PE file, so that pages relocated
+ * from older contents of the same file are not reused */
+static int get_image_file_stamp( struct fd *fd, file_pos_t *size, timeout_t *mtime )
+{
+    struct stat st;
+    int unix_fd;
+
+    if ((unix_fd = get_unix_fd( fd )) == -1) return 0;
+    if (fstat( unix_fd, &st ) == -1)
+    {
+        file_set_error();
+        return 0;
+    }
+    *size  = st.st_size;
+    *mtime = (timeout_t)st.st_mtime * TICKS_PER_SEC;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    *mtime += st.st_mtim.tv_nsec / 100;
+#endif
+    return 1;
+}
+
+/* get the relocated pages shared by the views of an image mapped at the same address */
+DECL_HANDLER(get_image_relocs)
+{
+    struct memory_view *view = find_mapped_view( current->process, req->base );
+    struct image_relocs *relocs;
+    struct file *file;
+    file_pos_t size;
+    timeout_t mtime;
+    int unix_fd;
+
+    if (!view) return;
+    if (!(view->flags & SEC_IMAGE) || !view->fd || view->base == view->image.base)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+
+    if (!(relocs = view->relocs))
+    {
+        if (!get_image_file_stamp( view->fd, &size, &mtime )) return;
+
+        LIST_FOR_EACH_ENTRY( relocs, &image_relocs_list, struct image_relocs, entry )
+        {
+            if (relocs->base != view->base || !is_same_file_fd( relocs->fd, view->fd )) continue;
+            if (relocs->size == size && relocs->mtime == mtime) break;
+            /* the file has been modified since, nobody may map these pages any more */
+            list_remove( &relocs->entry );
+            list_init( &relocs->entry );
+            relocs = LIST_ENTRY( &image_relocs_list, struct image_relocs, entry );
+            break;
+        }
+
+        if (&relocs->entry == &image_relocs_list)
+        {
+            if ((unix_fd = create_temp_file( view->image.map_size )) == -1) return;
+            if (!(file = create_file_for_fd( unix_fd, FILE_GENERIC_READ|FILE_GENERIC_WRITE, 0 ))) return;
+            if (!(relocs = alloc_object( &image_relocs_ops )))
+            {
+                release_object( file );
+                return;
+            }
+            relocs->fd     = (struct fd *)grab_object( view->fd );
+            relocs->size   = size;
+            relocs->mtime  = mtime;
+            relocs->base   = view->base;
+            relocs->file   = file;
+            relocs->filler = view;
+            list_add_head( &image_relocs_list, &relocs->entry );
+        }
+        else grab_object( relocs );
+        view->relocs = relocs;
+    }
+
+    if (relocs->filler == view)
+    {
+        reply->handle = alloc_handle( current->process, relocs->file, FILE_READ_DATA | FILE_WRITE_DATA, 0 );
+        reply->fill = 1;
+    }
+    else if (!relocs->filler && !list_empty( &relocs->entry ))
+        reply->handle = alloc_handle( current->process, relocs->file, FILE_READ_DATA, 0 );
+}
+
+/* mark the relocated pages stored by the caller as complete */
+DECL_HANDLER(set_image_relocs)
+{
+    struct memory_view *view = find_mapped_view( current->process, req->base );
+
+    if (!view) return;
+    if (!view->relocs || view->relocs->filler != view)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    view->relocs->filler = NULL;
+    if (!req->success)
+    {
+        list_remove( &view->relocs->entry );
+        list_init( &view->relocs->entry );
+    }
+}
+
 /* get a range of committed pages in a file mapping */
 DECL_HANDLER(get_mapping_committed_range)
 {
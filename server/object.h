@@ -270,6 +270,16 @@ extern void stop_watchdog(void);
 extern int watchdog_triggered(void);
 extern void init_signals(void);
 
+/* worker functions */
+
+struct worker;
+typedef int (*worker_callback)( void *arg );
+typedef void (*worker_done)( void *arg, int status );
+
+extern struct worker *create_worker( const char *name );
+extern int queue_worker_job( struct worker *worker, worker_callback work, worker_done done, void *arg );
+extern void flush_worker( struct worker *worker );
+
 /* atom functions */
 
 extern atom_t add_global_atom( struct winstation *winstation, const struct unicode_str *str );
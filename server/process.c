@@ -32,6 +32,7 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <poll.h>
 #ifdef HAVE_SYS_PARAM_H
@@ -697,6 +698,8 @@ struct process *create_process( int fd, struct process *parent, unsigned int fla
     process->esync_fd        = -1;
     process->fsync_idx       = 0;
     process->cpu_override.cpu_count = 0;
+    process->shm_mapping     = NULL;
+    process->shm             = NULL;
     list_init( &process->kernel_object );
     list_init( &process->thread_list );
     list_init( &process->locks );
@@ -806,7 +809,10 @@ static void process_destroy( struct object *obj )
     free( process->rawinput_devices );
     free( process->dir_cache );
     free( process->image );
+    if (process->shm) munmap( (void *)process->shm, sizeof(*process->shm) );
+    if (process->shm_mapping) release_object( process->shm_mapping );
     if (do_esync()) close( process->esync_fd );
+    if (do_fsync()) fsync_free_shm( process->fsync_idx );
 }
 
 /* dump a process on stdout for debugging purposes */
@@ -1018,6 +1024,39 @@ static void process_killed( struct process *process )
     wake_up( &process->obj, 0 );
 }
 
+/* create the mapping holding the process and thread state snapshots */
+int init_process_snapshot( struct process *process )
+{
+    void *ptr;
+
+    if (process->shm) return 1;
+    if (!(process->shm_mapping = create_server_shared_mapping( sizeof(*process->shm), &ptr ))) return 0;
+    process->shm = ptr;
+    update_process_snapshot( process );
+    return 1;
+}
+
+/* publish the current process state to the client */
+void update_process_snapshot( struct process *process )
+{
+    volatile process_snapshot_t *shm;
+
+    if (!process->shm) return;
+    shm = &process->shm->process;
+    snapshot_write_begin( &shm->seq );
+    shm->pid             = get_process_id( process );
+    shm->ppid            = process->parent_id;
+    shm->exit_code       = process->exit_code;
+    shm->affinity        = process->affinity;
+    shm->peb             = process->peb;
+    shm->start_time      = process->start_time;
+    shm->session_id      = process->session_id;
+    shm->priority        = process->priority;
+    shm->running_threads = process->running_threads;
+    shm->machine         = process->machine;
+    snapshot_write_end( &shm->seq );
+}
+
 /* add a thread to a process running threads list */
 void add_process_thread( struct process *process, struct thread *thread )
 {
@@ -1035,6 +1074,7 @@ void add_process_thread( struct process *process, struct thread *thread )
             }
         }
     }
+    update_process_snapshot( process );
     grab_object( thread );
 }
 
@@ -1055,6 +1095,7 @@ void remove_process_thread( struct process *process, struct thread *thread )
         process_killed( process );
     }
     else generate_debug_event( thread, DbgExitThreadStateChange, thread );
+    update_process_snapshot( process );
     release_object( thread );
 }
 
@@ -1467,6 +1508,8 @@ DECL_HANDLER(init_process_done)
 
     process->start_time = current_time;
     current->entry_point = base + image_info->entry_point;
+    update_process_snapshot( process );
+    update_thread_snapshot( current );
 
     init_process_tracing( process );
     generate_startup_debug_events( process );
@@ -1667,6 +1710,7 @@ DECL_HANDLER(set_process_info)
     {
         if (req->mask & SET_PROCESS_INFO_PRIORITY) process->priority = req->priority;
         if (req->mask & SET_PROCESS_INFO_AFFINITY) set_process_affinity( process, req->affinity );
+        update_process_snapshot( process );
         release_object( process );
     }
 }
@@ -88,6 +88,8 @@ struct process
     int                  esync_fd;        /* esync file descriptor (signaled on exit) */
     unsigned int         fsync_idx;
     struct cpu_topology_override cpu_override; /* Overridden CPUs to host CPUs mapping. */
+    struct object       *shm_mapping;     /* mapping for the process state snapshots */
+    volatile process_shm_t *shm;      /* server view of the process state snapshots */
 };
 
 /* process functions */
@@ -117,6 +119,8 @@ extern void kill_process( struct process *process, int violent_death );
 extern void kill_console_processes( struct thread *renderer, int exit_code );
 extern void detach_debugged_processes( struct debug_obj *debug_obj, int exit_code );
 extern void enum_processes( int (*cb)(struct process*, void*), void *user);
+extern int init_process_snapshot( struct process *process );
+extern void update_process_snapshot( struct process *process );
 
 /* console functions */
 extern struct thread *console_get_renderer( struct console *console );
@@ -145,4 +149,16 @@ static inline int is_process_init_done( struct process *process )
 
 static const unsigned int default_session_id = 1;
 
+/* snapshot updates are bracketed by two increments of the sequence number */
+static inline void snapshot_write_begin( volatile unsigned int *seq )
+{
+    __atomic_store_n( seq, *seq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+static inline void snapshot_write_end( volatile unsigned int *seq )
+{
+    __atomic_store_n( seq, *seq + 1, __ATOMIC_RELEASE );
+}
+
 #endif  /* __WINE_SERVER_PROCESS_H */
@@ -72,6 +72,7 @@ struct message_result
 struct message
 {
     struct list            entry;     /* entry in message list */
+    struct list            code_entry; /* entry in the posted messages index */
     enum message_type      type;      /* message type */
     user_handle_t          win;       /* window handle */
     unsigned int           msg;       /* message code */
@@ -118,6 +119,10 @@ struct thread_input
     int                    keystate_lock; /* keystate is locked */
 };
 
+/* posted messages are also indexed by message code, so that retrieving a narrow range doesn't
+ * need to walk the whole list; the size must be a power of 2 */
+#define POSTED_INDEX_SIZE 32
+
 struct msg_queue
 {
     struct object          obj;             /* object header */
@@ -132,6 +137,9 @@ struct msg_queue
     int                    exit_code;       /* exit code of pending quit message */
     int                    cursor_count;    /* per-queue cursor show count */
     struct list            msg_list[NB_MSG_KINDS];  /* lists of messages */
+    struct list            posted_index[POSTED_INDEX_SIZE]; /* posted messages hashed by message code */
+    unsigned int           posted_count;    /* number of posted messages in the queue */
+    unsigned int           posted_max;      /* highest number of posted messages in the queue */
     struct list            send_result;     /* stack of sent messages waiting for result */
     struct list            callback_result; /* list of callback messages waiting for result */
     struct message_result *recv_result;     /* stack of received messages waiting for result */
@@ -331,7 +339,10 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
         list_init( &queue->expired_timers );
+        queue->posted_count    = 0;
+        queue->posted_max      = 0;
         for (i = 0; i < NB_MSG_KINDS; i++) list_init( &queue->msg_list[i] );
+        for (i = 0; i < POSTED_INDEX_SIZE; i++) list_init( &queue->posted_index[i] );
 
         if (do_fsync())
             queue->fsync_idx = fsync_alloc_shm( 0, 0 );
@@ -734,6 +745,15 @@ static void free_message( struct message *msg )
     free( msg );
 }
 
+/* add a message to the posted messages list and index */
+static void add_posted_message( struct msg_queue *queue, struct message *msg )
+{
+    msg->unique_id = get_unique_post_id();
+    list_add_tail( &queue->msg_list[POST_MESSAGE], &msg->entry );
+    list_add_tail( &queue->posted_index[msg->msg % POSTED_INDEX_SIZE], &msg->code_entry );
+    if (++queue->posted_count > queue->posted_max) queue->posted_max = queue->posted_count;
+}
+
 /* remove (and free) a message from a message list */
 static void remove_queue_message( struct msg_queue *queue, struct message *msg,
                                   enum message_kind kind )
@@ -745,6 +765,8 @@ static void remove_queue_message( struct msg_queue *queue, struct message *msg,
         if (list_empty( &queue->msg_list[kind] )) clear_queue_bits( queue, QS_SENDMESSAGE );
         break;
     case POST_MESSAGE:
+        list_remove( &msg->code_entry );
+        queue->posted_count--;
         if (list_empty( &queue->msg_list[kind] ) && !queue->quit_message)
             clear_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
         if (msg->msg == WM_HOTKEY && --queue->hotkey_count == 0)
@@ -902,7 +924,28 @@ static int get_posted_message( struct msg_queue *queue, unsigned int ignore_msg,
                                unsigned int first, unsigned int last, unsigned int flags,
                                struct get_message_reply *reply )
 {
-    struct message *msg;
+    struct message *msg, *found = NULL;
+    unsigned int code;
+
+    if (last >= first && last - first < POSTED_INDEX_SIZE)
+    {
+        /* narrow range, look for the oldest match in the index buckets of each code */
+        code = first;
+        do
+        {
+            LIST_FOR_EACH_ENTRY( msg, &queue->posted_index[code % POSTED_INDEX_SIZE], struct message, code_entry )
+            {
+                if (found && (int)(msg->unique_id - found->unique_id) >= 0) break;
+                if (msg->msg != code) continue;
+                if (!match_window( win, msg->win )) continue;
+                if (ignore_msg && (int)(msg->unique_id - ignore_msg) >= 0) continue;
+                found = msg;
+                break;
+            }
+        } while (code++ != last);
+        if (!(msg = found)) return 0;
+        goto found;
+    }
 
     /* check against the filters */
     LIST_FOR_EACH_ENTRY( msg, &queue->msg_list[POST_MESSAGE], struct message, entry )
@@ -1058,8 +1101,8 @@ static void msg_queue_remove_queue(struct object *obj, struct wait_queue_entry *
 static void msg_queue_dump( struct object *obj, int verbose )
 {
     struct msg_queue *queue = (struct msg_queue *)obj;
-    fprintf( stderr, "Msg queue bits=%x mask=%x\n",
-             queue->wake_bits, queue->wake_mask );
+    fprintf( stderr, "Msg queue bits=%x mask=%x posted=%u max=%u\n",
+             queue->wake_bits, queue->wake_mask, queue->posted_count, queue->posted_max );
 }
 
 static int msg_queue_signaled( struct object *obj, struct wait_queue_entry *entry )
@@ -1138,6 +1181,7 @@ static void msg_queue_destroy( struct object *obj )
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
     if (do_esync()) close( queue->esync_fd );
+    if (do_fsync()) fsync_free_shm( queue->fsync_idx );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -1548,13 +1592,12 @@ found:
     msg->msg       = WM_HOTKEY;
     msg->wparam    = hotkey->id;
     msg->lparam    = ((hotkey->vkey & 0xffff) << 16) | modifiers;
-    msg->unique_id = get_unique_post_id();
 
     free( msg->data );
     msg->data      = NULL;
     msg->data_size = 0;
 
-    list_add_tail( &hotkey->queue->msg_list[POST_MESSAGE], &msg->entry );
+    add_posted_message( hotkey->queue, msg );
     set_queue_bits( hotkey->queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE|QS_HOTKEY );
     hotkey->queue->hotkey_count++;
     return 1;
@@ -2347,7 +2390,7 @@ void post_message( user_handle_t win, unsigned int message, lparam_t wparam, lpa
 
         get_message_defaults( thread->queue, &msg->x, &msg->y, &msg->time );
 
-        list_add_tail( &thread->queue->msg_list[POST_MESSAGE], &msg->entry );
+        add_posted_message( thread->queue, msg );
         set_queue_bits( thread->queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
         if (message == WM_HOTKEY)
         {
@@ -2600,8 +2643,7 @@ DECL_HANDLER(send_message)
             set_queue_bits( recv_queue, QS_SENDMESSAGE );
             break;
         case MSG_POSTED:
-            msg->unique_id = get_unique_post_id();
-            list_add_tail( &recv_queue->msg_list[POST_MESSAGE], &msg->entry );
+            add_posted_message( recv_queue, msg );
             set_queue_bits( recv_queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
             if (msg->msg == WM_HOTKEY)
             {
@@ -33,6 +33,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -87,6 +88,11 @@ struct key
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    struct name_index *subkey_index; /* hash index of the subkeys of large keys */
+    int               sorted_subkeys; /* number of sorted subkeys at the start of the array, if indexed */
+    struct name_index *value_index;  /* hash index of the values of large keys */
+    int               sorted_values; /* number of sorted values at the start of the array, if indexed */
+    unsigned int      cache_slot;  /* slot of the generation counter in the registry cache, or 0 */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
@@ -114,6 +120,7 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define INDEX_MIN_ENTRIES 64  /* min. number of subkeys or values of a key to build a hash index */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -123,6 +130,7 @@ static struct key *root_key;
 
 static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89) * TICKS_PER_SEC;
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
+static const size_t journal_min_compact = 256 * 1024;  /* journal size that may trigger a full save */
 static struct timeout_user *save_timeout_user;  /* saving timer */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
 
@@ -133,16 +141,87 @@ static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_va
 static void set_periodic_save_timer(void);
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
 
+/* a growable buffer used to build the data saved to disk */
+struct save_buffer
+{
+    char   *data;
+    size_t  size;
+    size_t  alloc;
+    int     failed;
+};
+
+/* reserve some zeroed space in a save buffer; return its offset */
+static unsigned int reserve_save_buffer( struct save_buffer *buf, size_t len, size_t align )
+{
+    size_t pos = (buf->size + align - 1) & ~(align - 1);
+
+    if (buf->failed) return 0;
+    if (pos + len > UINT_MAX)
+    {
+        buf->failed = 1;
+        return 0;
+    }
+    if (pos + len > buf->alloc)
+    {
+        size_t new_alloc = max( buf->alloc * 2, pos + len );
+        char *new_data;
+
+        if (!(new_data = realloc( buf->data, new_alloc )))
+        {
+            buf->failed = 1;
+            return 0;
+        }
+        buf->data  = new_data;
+        buf->alloc = new_alloc;
+    }
+    memset( buf->data + buf->size, 0, pos + len - buf->size );
+    buf->size = pos + len;
+    return pos;
+}
+
+/* append some data to a save buffer; return its offset */
+static unsigned int append_save_buffer( struct save_buffer *buf, const void *data, size_t len, size_t align )
+{
+    unsigned int pos;
+
+    if (!len || !(pos = reserve_save_buffer( buf, len, align ))) return 0;
+    memcpy( buf->data + pos, data, len );
+    return pos;
+}
+
 /* information about where to save a registry branch */
 struct save_branch_info
 {
-    struct key  *key;
-    const char  *path;
+    struct key         *key;
+    const char         *path;
+    int                 pending;       /* save queued to the registry worker */
+    unsigned int        journal_gen;   /* generation of the journal receiving the changes */
+    unsigned int        saved_gen;     /* last generation included in the text file on disk */
+    size_t              journal_size;  /* size of the records already written to the journal */
+    size_t              base_size;     /* size of the last saved text file */
+    struct save_buffer  journal;       /* journal records not written yet */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
+static struct worker *registry_worker;  /* worker writing the saved branches to disk */
+
+/* a binary registry hive in memory; value data of the loaded keys points into it, unless copied */
+struct hive
+{
+    const char               *base;         /* base of the mapping */
+    size_t                    size;         /* size of the mapping */
+    const struct hive_key    *keys;         /* key records */
+    unsigned int              key_count;    /* number of key records */
+    const struct hive_value  *values;       /* value records */
+    unsigned int              value_count;  /* number of value records */
+    int                       copy;         /* the hive goes away after loading, copy the data */
+};
+
+static int registry_hive;  /* save and load binary hives along with the text files */
+static int hive_count;
+static struct hive hives[MAX_SAVE_BRANCH_INFO];
 
 unsigned int supported_machines_count = 0;
 unsigned short supported_machines[8];
@@ -287,12 +366,223 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* hash index of the names of the subkeys or values of a large key */
+struct name_index
+{
+    unsigned int  size;      /* number of slots, a power of 2 */
+    unsigned int  used;      /* number of slots that are not free */
+    int           slots[1];  /* position in the subkeys or values array */
+};
+
+#define INDEX_FREE     (-1)  /* slot was never used */
+#define INDEX_DELETED  (-2)  /* slot was used by a removed entry */
+
+static void get_entry_name( const struct key *key, int values, int pos, struct unicode_str *name )
+{
+    if (values)
+    {
+        name->str = key->values[pos].name;
+        name->len = key->values[pos].namelen;
+    }
+    else
+    {
+        name->str = key->subkeys[pos]->obj.name->name;
+        name->len = key->subkeys[pos]->obj.name->len;
+    }
+}
+
+static int compare_names( const struct unicode_str *name1, const struct unicode_str *name2 )
+{
+    int res = memicmp_strW( name1->str, name2->str, min( name1->len, name2->len ));
+    if (!res) res = name1->len - name2->len;
+    return res;
+}
+
+static int compare_subkeys( const void *ptr1, const void *ptr2 )
+{
+    const struct object_name *name1 = (*(struct key * const *)ptr1)->obj.name;
+    const struct object_name *name2 = (*(struct key * const *)ptr2)->obj.name;
+    struct unicode_str str1 = { name1->name, name1->len }, str2 = { name2->name, name2->len };
+
+    return compare_names( &str1, &str2 );
+}
+
+static int compare_values( const void *ptr1, const void *ptr2 )
+{
+    const struct key_value *value1 = ptr1, *value2 = ptr2;
+    struct unicode_str str1 = { value1->name, value1->namelen }, str2 = { value2->name, value2->namelen };
+
+    return compare_names( &str1, &str2 );
+}
+
+/* find the position of a name in a hash index; return -1 if not found */
+static int index_lookup( const struct key *key, int values, const struct name_index *index,
+                         const struct unicode_str *name )
+{
+    unsigned int i = hash_strW( name->str, name->len, index->size );
+    struct unicode_str str;
+    int pos;
+
+    for ( ; (pos = index->slots[i]) != INDEX_FREE; i = (i + 1) & (index->size - 1))
+    {
+        if (pos == INDEX_DELETED) continue;
+        get_entry_name( key, values, pos, &str );
+        if (str.len == name->len && !memicmp_strW( str.str, name->str, name->len )) return pos;
+    }
+    return -1;
+}
+
+/* add a position to a hash index */
+static void index_insert( struct name_index *index, const struct unicode_str *name, int pos )
+{
+    unsigned int i = hash_strW( name->str, name->len, index->size );
+
+    while (index->slots[i] >= 0) i = (i + 1) & (index->size - 1);
+    if (index->slots[i] == INDEX_FREE) index->used++;
+    index->slots[i] = pos;
+}
+
+/* remove a position from a hash index, and renumber the following ones since the entries get moved down */
+static void index_remove( struct name_index *index, const struct unicode_str *name, int pos )
+{
+    unsigned int i = hash_strW( name->str, name->len, index->size );
+
+    while (index->slots[i] != pos) i = (i + 1) & (index->size - 1);
+    index->slots[i] = INDEX_DELETED;
+    for (i = 0; i < index->size; i++) if (index->slots[i] > pos) index->slots[i]--;
+}
+
+/* build a hash index for the first count subkeys or values of a key */
+static struct name_index *build_index( const struct key *key, int values, int count )
+{
+    struct name_index *index;
+    struct unicode_str name;
+    unsigned int size = 2 * INDEX_MIN_ENTRIES;
+    int pos;
+
+    while (size < 4 * (unsigned int)count) size *= 2;
+    if (!(index = malloc( offsetof( struct name_index, slots[size] )))) return NULL;
+    index->size = size;
+    index->used = 0;
+    memset( index->slots, 0xff, size * sizeof(index->slots[0]) );  /* INDEX_FREE */
+    for (pos = 0; pos < count; pos++)
+    {
+        get_entry_name( key, values, pos, &name );
+        index_insert( index, &name, pos );
+    }
+    return index;
+}
+
+/* sort the unsorted entries at the end of an array and merge them with the sorted ones */
+static void sort_array( void *array, int count, int sorted, size_t size, int (*compare)(const void *, const void *) )
+{
+    char *base = array, *tmp;
+    int i, j, k;
+
+    qsort( base + sorted * size, count - sorted, size, compare );
+    if (!sorted) return;
+    if (!(tmp = malloc( (count - sorted) * size )))
+    {
+        qsort( base, count, size, compare );
+        return;
+    }
+    memcpy( tmp, base + sorted * size, (count - sorted) * size );
+    for (i = sorted - 1, j = count - sorted - 1, k = count - 1; j >= 0; k--)
+    {
+        if (i >= 0 && compare( base + i * size, tmp + j * size ) > 0)
+            memcpy( base + k * size, base + i-- * size, size );
+        else
+            memcpy( base + k * size, tmp + j-- * size, size );
+    }
+    free( tmp );
+}
+
+/* make sure that the subkeys or values of a key are sorted, for enumeration and saving */
+static void sort_entries( struct key *key, int values )
+{
+    struct name_index **index = values ? &key->value_index : &key->subkey_index;
+    int *sorted = values ? &key->sorted_values : &key->sorted_subkeys;
+    int count = values ? key->last_value + 1 : key->last_subkey + 1;
+
+    if (!*index || *sorted == count) return;
+
+    if (values) sort_array( key->values, count, *sorted, sizeof(key->values[0]), compare_values );
+    else sort_array( key->subkeys, count, *sorted, sizeof(key->subkeys[0]), compare_subkeys );
+    *sorted = count;
+
+    /* the positions have changed, without an index the sorted array is searched directly */
+    free( *index );
+    *index = build_index( key, values, count );
+}
+
+/* index a new entry, which is at the end of the array if the key is already indexed */
+static void index_add( struct key *key, int values, const struct unicode_str *name )
+{
+    struct name_index **index = values ? &key->value_index : &key->subkey_index;
+    int *sorted = values ? &key->sorted_values : &key->sorted_subkeys;
+    int count = values ? key->last_value + 1 : key->last_subkey + 1;
+    struct name_index *new_index;
+    struct unicode_str prev;
+
+    if (!*index)
+    {
+        /* small keys are kept sorted and searched directly */
+        if (count >= INDEX_MIN_ENTRIES && (*index = build_index( key, values, count ))) *sorted = count;
+        return;
+    }
+
+    if (*sorted == count - 1)
+    {
+        get_entry_name( key, values, count - 2, &prev );
+        if (compare_names( &prev, name ) < 0) *sorted = count;
+    }
+
+    if (2 * ((*index)->used + 1) <= (*index)->size)
+    {
+        index_insert( *index, name, count - 1 );
+        return;
+    }
+    if ((new_index = build_index( key, values, count )))
+    {
+        free( *index );
+        *index = new_index;
+        return;
+    }
+    /* out of memory, fall back to searching the sorted array */
+    sort_entries( key, values );
+    free( *index );
+    *index = NULL;
+}
+
+/* remove an entry from the index before it is removed from the array */
+static void index_del( struct key *key, int values, const struct unicode_str *name, int pos )
+{
+    struct name_index *index = values ? key->value_index : key->subkey_index;
+    int *sorted = values ? &key->sorted_values : &key->sorted_subkeys;
+
+    if (!index) return;
+    index_remove( index, name, pos );
+    if (pos < *sorted) (*sorted)--;
+}
+
 /* find the named child of a given key and return its index */
 static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_index)
+    {
+        /* new subkeys are appended, the array is sorted when needed */
+        if ((i = index_lookup( key, 0, key->subkey_index, name )) == -1)
+        {
+            *index = key->last_subkey + 1;
+            return NULL;
+        }
+        *index = i;
+        return key->subkeys[i];
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -339,11 +629,13 @@ static int grow_subkeys( struct key *key )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_entries( key, 0 );
+    sort_entries( key, 1 );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -606,6 +898,8 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
     for (i = ++parent_key->last_subkey; i > index; i--)
         parent_key->subkeys[i] = parent_key->subkeys[i - 1];
     parent_key->subkeys[index] = (struct key *)grab_object( key );
+    key->obj.name = name;  /* needed to index the key, create_named_object sets it anyway */
+    index_add( parent_key, 0, &tmp );
     if (is_wow6432node( name->name, name->len ) &&
         !is_wow6432node( parent_key->obj.name->name, parent_key->obj.name->len ))
         parent_key->wow6432node = key;
@@ -617,6 +911,7 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
 {
     struct key *key = (struct key *)obj;
     struct key *parent = (struct key *)name->parent;
+    struct unicode_str tmp;
     int i, nb_subkeys;
 
     if (!parent) return;
@@ -629,6 +924,9 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
 
     for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
     assert( i <= parent->last_subkey );
+    tmp.str = name->name;
+    tmp.len = name->len;
+    index_del( parent, 0, &tmp, i );
     for ( ; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
     name->parent = NULL;
@@ -657,6 +955,74 @@ static int key_close_handle( struct object *obj, struct process *process, obj_ha
     return 1;  /* ok to close */
 }
 
+/* check if a pointer is inside one of the mapped hives */
+static int is_hive_data( const void *ptr )
+{
+    int i;
+
+    for (i = 0; i < hive_count; i++)
+        if ((const char *)ptr >= hives[i].base && (const char *)ptr < hives[i].base + hives[i].size)
+            return 1;
+    return 0;
+}
+
+/* free the data of a value, unless it is still backed by a hive mapping */
+static void free_value_data( void *data )
+{
+    if (!is_hive_data( data )) free( data );
+}
+
+/* registry cache: keys whose values have been queried get a slot in a shared array of
+ * generation counters; clients keep the values they read along with the generation, and
+ * consider them stale as soon as the counter moves */
+
+static struct object *cache_mapping;      /* mapping holding the generation counters */
+static volatile unsigned int *cache_gens; /* generation counters, indexed by slot */
+static unsigned int *cache_free_slots;    /* stack of released slots */
+static unsigned int cache_free_count;     /* number of released slots */
+static unsigned int cache_next_slot = 1;  /* first slot that was never used */
+
+static int init_registry_cache(void)
+{
+    void *ptr;
+
+    if (cache_mapping) return 1;
+    if (!(cache_free_slots = mem_alloc( REGISTRY_CACHE_SLOTS * sizeof(*cache_free_slots) ))) return 0;
+    if (!(cache_mapping = create_server_shared_mapping( REGISTRY_CACHE_SLOTS * sizeof(*cache_gens), &ptr )))
+    {
+        free( cache_free_slots );
+        cache_free_slots = NULL;
+        return 0;
+    }
+    cache_gens = ptr;
+    return 1;
+}
+
+/* get the generation counter slot of a key, allocating it if needed; 0 if none available */
+static unsigned int get_cache_slot( struct key *key )
+{
+    if (key->cache_slot || !cache_mapping) return key->cache_slot;
+    if (cache_free_count) key->cache_slot = cache_free_slots[--cache_free_count];
+    else if (cache_next_slot < REGISTRY_CACHE_SLOTS) key->cache_slot = cache_next_slot++;
+    return key->cache_slot;
+}
+
+/* invalidate the values cached by clients for a key */
+static void bump_key_generation( struct key *key )
+{
+    if (key->cache_slot) cache_gens[key->cache_slot]++;
+}
+
+/* release the slot of a destroyed key; the generation is bumped so that entries
+ * cached for the old key never match the next owner of the slot */
+static void release_cache_slot( struct key *key )
+{
+    if (!key->cache_slot) return;
+    cache_gens[key->cache_slot]++;
+    cache_free_slots[cache_free_count++] = key->cache_slot;
+    key->cache_slot = 0;
+}
+
 static void key_destroy( struct object *obj )
 {
     int i;
@@ -668,9 +1034,12 @@ static void key_destroy( struct object *obj )
     for (i = 0; i <= key->last_value; i++)
     {
         free( key->values[i].name );
-        free( key->values[i].data );
+        free_value_data( key->values[i].data );
     }
     free( key->values );
+    free( key->value_index );
+    free( key->subkey_index );
+    release_cache_slot( key );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->obj.name->parent = NULL;
@@ -709,6 +1078,11 @@ static struct key *create_key_object( struct object *parent, const struct unicod
             key->nb_values   = 0;
             key->last_value  = -1;
             key->values      = NULL;
+            key->subkey_index   = NULL;
+            key->sorted_subkeys = 0;
+            key->value_index    = NULL;
+            key->sorted_values  = 0;
+            key->cache_slot  = 0;
             key->modif       = modif;
             list_init( &key->notify_list );
 
@@ -762,17 +1136,152 @@ static void check_notify( struct key *key, unsigned int change, int not_subtree
     }
 }
 
-/* update key modification time */
+/* update key modification time; the caller is responsible for journaling the change
+ * or marking the key dirty */
 static void touch_key( struct key *key, unsigned int change )
 {
     key->modif = current_time;
-    make_dirty( key );
+    bump_key_generation( key );
 
     /* do notifications */
     check_notify( key, change, 1 );
     for (key = get_parent( key ); key; key = get_parent( key )) check_notify( key, change, 0 );
 }
 
+/* registry journal: the changes made since the last full save of a branch are appended
+ * to "<branch>.reg.log", and replayed on top of the text file when it is loaded */
+
+#define JOURNAL_MAGIC   0x4c4e524a  /* "JRNL" */
+#define JOURNAL_VERSION 1
+
+enum journal_op
+{
+    JOURNAL_CREATE_KEY,
+    JOURNAL_DELETE_KEY,
+    JOURNAL_RENAME_KEY,
+    JOURNAL_SET_VALUE,
+    JOURNAL_DELETE_VALUE
+};
+
+struct journal_header
+{
+    unsigned int  magic;     /* JOURNAL_MAGIC */
+    unsigned int  version;   /* JOURNAL_VERSION */
+    unsigned int  gen;       /* generation, newer than the one stored in the text file */
+    unsigned int  reserved;
+};
+
+struct journal_record
+{
+    unsigned int  size;      /* size of the record, including the variable data */
+    unsigned int  checksum;  /* checksum of the record computed with this field set to 0 */
+    unsigned int  op;        /* enum journal_op */
+    unsigned int  pathlen;   /* length of the key path relative to the branch */
+    timeout_t     modif;     /* modification time set by the change */
+    unsigned int  namelen;   /* length of the value name, new key name or key class */
+    unsigned int  type;      /* value type or key flags */
+    unsigned int  len;       /* length of the value data */
+    unsigned int  reserved;
+    /* followed by the key path, the name and the value data */
+};
+
+static int registry_journal;  /* record the changes in the journals */
+static unsigned int load_journal_gen;  /* journal generation found while loading a branch */
+
+static unsigned int journal_checksum( const void *data, size_t size )
+{
+    const unsigned char *ptr = data;
+    unsigned int sum = 2166136261u;
+
+    while (size--) sum = (sum ^ *ptr++) * 16777619;
+    return sum;
+}
+
+/* find the saved branch containing a key */
+static struct save_branch_info *get_key_branch( const struct key *key )
+{
+    int i;
+
+    for ( ; key; key = get_parent( key ))
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key) return &save_branch_info[i];
+    return NULL;
+}
+
+/* append a change to the journal of the branch containing the key; return 0 if the
+ * change could not be recorded and the branch needs to be saved entirely */
+static int journal_record( const struct key *key, enum journal_op op, const void *name, data_size_t namelen,
+                           unsigned int type, const void *data, data_size_t len )
+{
+    struct save_branch_info *info;
+    struct journal_record *rec;
+    const struct key *parent;
+    data_size_t pathlen = 0;
+    unsigned int pos;
+    char *ptr;
+
+    if (!registry_journal || (key->flags & KEY_VOLATILE)) return 0;
+    if (!(info = get_key_branch( key ))) return 0;
+
+    for (parent = key; parent != info->key; parent = get_parent( parent ))
+        pathlen += parent->obj.name->len + sizeof(WCHAR);
+    if (pathlen) pathlen -= sizeof(WCHAR);
+
+    if (!info->journal.size) reserve_save_buffer( &info->journal, sizeof(struct journal_header), sizeof(__int64) );
+    pos = reserve_save_buffer( &info->journal, sizeof(*rec) + pathlen + namelen + len, sizeof(__int64) );
+    if (info->journal.failed) return 0;
+
+    /* pad the record so that the next one is aligned */
+    reserve_save_buffer( &info->journal, 0, sizeof(__int64) );
+    if (info->journal.failed) return 0;
+
+    rec = (struct journal_record *)(info->journal.data + pos);
+    rec->size    = info->journal.size - pos;
+    rec->op      = op;
+    rec->pathlen = pathlen;
+    rec->modif   = current_time;
+    rec->namelen = namelen;
+    rec->type    = type;
+    rec->len     = len;
+
+    /* the path is built backwards from the key */
+    ptr = (char *)(rec + 1) + pathlen;
+    for (parent = key; parent != info->key; parent = get_parent( parent ))
+    {
+        ptr -= parent->obj.name->len;
+        memcpy( ptr, parent->obj.name->name, parent->obj.name->len );
+        if (ptr > (char *)(rec + 1))
+        {
+            ptr -= sizeof(WCHAR);
+            *(WCHAR *)ptr = '\\';
+        }
+    }
+    ptr = (char *)(rec + 1) + pathlen;
+    if (namelen) memcpy( ptr, name, namelen );
+    if (len) memcpy( ptr + namelen, data, len );
+    rec->checksum = journal_checksum( rec, rec->size );
+    return 1;
+}
+
+/* start a new journal generation once a branch has been saved entirely */
+static void start_new_journal( struct save_branch_info *info, size_t base_size )
+{
+    info->journal_gen++;
+    info->journal_size   = 0;
+    info->journal.size   = 0;
+    info->journal.failed = 0;
+    info->base_size      = base_size;
+}
+
+/* record the creation of a key; the newly created key is only dirty if this fails */
+static int journal_create_key( struct key *key )
+{
+    if (!journal_record( key, JOURNAL_CREATE_KEY, key->class, key->classlen, key->flags & KEY_SYMLINK, NULL, 0 ))
+        return 0;
+    key->flags &= ~KEY_DIRTY;
+    return 1;
+}
+
 /* get the wow6432node key if any, grabbing it and releasing the original key */
 static struct key *grab_wow6432node( struct key *key )
 {
@@ -841,8 +1350,8 @@ static struct key *open_key( struct key *parent, const struct unicode_str *name,
 
 /* create a subkey */
 static struct key *create_key( struct key *parent, const struct unicode_str *name,
-                               unsigned int options, unsigned int access, unsigned int attributes,
-                               const struct security_descriptor *sd )
+                               const struct unicode_str *class, unsigned int options, unsigned int access,
+                               unsigned int attributes, const struct security_descriptor *sd )
 {
     struct key *key;
 
@@ -860,6 +1369,13 @@ static struct key *create_key( struct key *parent, const struct unicode_str *nam
     if (!(key = create_key_object( &parent->obj, name, attributes, options, current_time, sd )))
         return NULL;
 
+    if (class && class->str)
+    {
+        free( key->class );
+        key->classlen = class->len;
+        if (!(key->class = memdup( class->str, class->len ))) key->classlen = 0;
+    }
+
     if (get_error() == STATUS_OBJECT_NAME_EXISTS)
     {
         if (key->flags & KEY_PREDEF) set_error( STATUS_PREDEFINED_HANDLE );
@@ -867,7 +1383,11 @@ static struct key *create_key( struct key *parent, const struct unicode_str *nam
     }
     else
     {
-        if (parent) touch_key( get_parent( key ), REG_NOTIFY_CHANGE_NAME );
+        if (parent)
+        {
+            if (!journal_create_key( key )) make_dirty( get_parent( key ));
+            touch_key( get_parent( key ), REG_NOTIFY_CHANGE_NAME );
+        }
         if (debug_level > 1) dump_operation( key, NULL, "Create" );
     }
     return key;
@@ -925,6 +1445,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_entries( key, 0 );
         key = key->subkeys[index];
     }
 
@@ -1004,8 +1525,9 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
 {
     struct object_name *new_name_ptr;
     struct key *subkey, *parent = get_parent( key );
+    struct unicode_str tmp;
     data_size_t len;
-    int i, index, cur_index;
+    int i, index, cur_index, journaled;
 
     /* changing to a path is not allowed */
     len = get_path_element( new_name->str, new_name->len );
@@ -1036,10 +1558,18 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     new_name_ptr->parent = &parent->obj;
     memcpy( new_name_ptr->name, new_name->str, new_name->len );
 
+    /* the journal needs the old name of the key */
+    journaled = journal_record( key, JOURNAL_RENAME_KEY, new_name->str, new_name->len, 0, NULL, 0 );
+
     for (cur_index = 0; cur_index <= parent->last_subkey; cur_index++)
         if (parent->subkeys[cur_index] == key) break;
 
-    if (cur_index < index && (index - cur_index) > 1)
+    /* an indexed key is moved to the end of the array and reindexed under its new name */
+    tmp.str = key->obj.name->name;
+    tmp.len = key->obj.name->len;
+    index_del( parent, 0, &tmp, cur_index );
+
+    if (cur_index < index)
     {
         --index;
         for (i = cur_index; i < index; ++i) parent->subkeys[i] = parent->subkeys[i+1];
@@ -1052,8 +1582,10 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
 
     free( key->obj.name );
     key->obj.name = new_name_ptr;
+    if (parent->subkey_index) index_add( parent, 0, new_name );
 
     if (debug_level > 1) dump_operation( key, NULL, "Rename" );
+    if (!journaled) make_dirty( key );
     touch_key( key, REG_NOTIFY_CHANGE_NAME );
 }
 
@@ -1087,7 +1619,9 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    if (!journal_record( key, JOURNAL_DELETE_KEY, NULL, 0, 0, NULL, 0 )) make_dirty( parent );
     key->flags |= KEY_DELETED;
+    bump_key_generation( key );
     unlink_named_object( &key->obj );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 1;
@@ -1124,6 +1658,18 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_index)
+    {
+        /* new values are appended, the array is sorted when needed */
+        if ((i = index_lookup( key, 1, key->value_index, name )) == -1)
+        {
+            *index = key->last_value + 1;
+            return NULL;
+        }
+        *index = i;
+        return &key->values[i];
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1167,6 +1713,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    index_add( key, 1, name );
     return value;
 }
 
@@ -1215,11 +1762,12 @@ static void set_value( struct key *key, const struct unicode_str *name,
             return;
         }
     }
-    else free( value->data ); /* already existing, free previous data */
+    else free_value_data( value->data ); /* already existing, free previous data */
 
     value->type  = type;
     value->len   = len;
     value->data  = ptr;
+    if (!journal_record( key, JOURNAL_SET_VALUE, name->str, name->len, type, data, len )) make_dirty( key );
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
     if (debug_level > 1) dump_operation( key, value, "Set" );
 }
@@ -1267,6 +1815,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_entries( key, 1 );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1325,8 +1874,10 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    if (!journal_record( key, JOURNAL_DELETE_VALUE, name->str, name->len, 0, NULL, 0 )) make_dirty( key );
+    index_del( key, 1, name, index );
     free( value->name );
-    free( value->data );
+    free_value_data( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
@@ -1524,6 +2075,10 @@ static int load_global_option( const char *buffer, struct file_load_info *info )
             return 0;
         }
     }
+    else if (!strncmp( buffer, "#journal=", 9 ))
+    {
+        load_journal_gen = strtoul( buffer + 9, NULL, 10 );
+    }
     /* ignore unknown options */
     return 1;
 }
@@ -1672,15 +2227,16 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     if (!len) newptr = NULL;
     else if (!(newptr = memdup( ptr, len ))) return 0;
 
-    free( value->data );
+    free_value_data( value->data );
     value->data = newptr;
     value->len  = len;
     value->type = type;
+    bump_key_generation( key );
     return 1;
 
  error:
     file_read_error( "Malformed value", info );
-    free( value->data );
+    free_value_data( value->data );
     value->data = NULL;
     value->len  = 0;
     value->type = REG_NONE;
@@ -1786,69 +2342,510 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     free( info.tmp );
 }
 
-/* load a part of the registry from a file */
-static void load_registry( struct key *key, obj_handle_t handle )
+/* binary hive format: a header, the key records in depth-first order, the value
+ * records, then the names, classes and value data referenced by offset */
+
+#define HIVE_MAGIC   0x45564948  /* "HIVE" */
+#define HIVE_VERSION 1
+
+struct hive_header
 {
-    struct file *file;
-    int fd;
+    unsigned int  magic;        /* HIVE_MAGIC */
+    unsigned int  version;      /* HIVE_VERSION */
+    unsigned int  prefix_type;  /* architecture of the prefix */
+    unsigned int  size;         /* total size of the hive */
+    unsigned int  keys;         /* offset of the key records */
+    unsigned int  key_count;    /* number of key records */
+    unsigned int  values;       /* offset of the value records */
+    unsigned int  value_count;  /* number of value records */
+    file_pos_t    text_size;    /* size of the text file saved along with the hive */
+    file_pos_t    text_ino;     /* inode of the text file */
+    __int64       text_mtime;   /* modification time of the text file */
+    unsigned int  text_nsec;    /* nanoseconds part of the modification time */
+    unsigned int  journal;      /* generation of the last journal included in the hive */
+};
 
-    if (!(file = get_file_obj( current->process, handle, FILE_READ_DATA ))) return;
-    fd = dup( get_file_unix_fd( file ) );
-    release_object( file );
-    if (fd != -1)
-    {
-        FILE *f = fdopen( fd, "r" );
-        if (f)
-        {
-            load_keys( key, NULL, f, -1 );
-            fclose( f );
-        }
-        else file_set_error();
-    }
-}
+struct hive_key
+{
+    timeout_t     modif;        /* last modification time */
+    unsigned int  name;         /* offset of the key name */
+    unsigned int  namelen;      /* length of the key name in bytes */
+    unsigned int  class;        /* offset of the key class */
+    unsigned int  classlen;     /* length of the key class in bytes */
+    unsigned int  flags;        /* key flags (only KEY_SYMLINK) */
+    unsigned int  subtree;      /* number of records of the subkeys, which follow this one */
+    unsigned int  first_value;  /* index of the first value record */
+    unsigned int  value_count;  /* number of value records */
+};
 
-/* load one of the initial registry files */
-static int load_init_registry_from_file( const char *filename, struct key *key )
+struct hive_value
 {
-    FILE *f;
+    unsigned int  name;         /* offset of the value name */
+    unsigned int  namelen;      /* length of the value name in bytes */
+    unsigned int  type;         /* value type */
+    unsigned int  len;          /* length of the data */
+    unsigned int  data;         /* offset of the data */
+};
 
-    if ((f = fopen( filename, "r" )))
-    {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
-        {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
-        }
-    }
+/* set the stamp of the text file a hive is in sync with */
+static void set_hive_stamp( struct hive_header *header, const struct stat *st )
+{
+    header->text_size  = st->st_size;
+    header->text_ino   = st->st_ino;
+    header->text_mtime = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    header->text_nsec  = st->st_mtim.tv_nsec;
+#else
+    header->text_nsec  = 0;
+#endif
+}
 
-    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+/* check if a hive is in sync with its text file */
+static int check_hive_stamp( const struct hive_header *header, const struct stat *st )
+{
+    struct hive_header tmp;
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
-    make_object_permanent( &key->obj );
-    return (f != NULL);
+    set_hive_stamp( &tmp, st );
+    return (header->text_size == tmp.text_size && header->text_ino == tmp.text_ino &&
+            header->text_mtime == tmp.text_mtime && header->text_nsec == tmp.text_nsec);
 }
 
-static WCHAR *format_user_registry_path( const struct sid *sid, struct unicode_str *path )
+/* check that a range of the hive is inside the mapping */
+static int check_hive_range( const struct hive *hive, unsigned int offset, unsigned int len )
 {
-    char buffer[7 + 11 + 11 + 11 * ARRAY_SIZE(sid->sub_auth)], *p = buffer;
-    unsigned int i;
+    return offset <= hive->size && len <= hive->size - offset;
+}
 
-    p += sprintf( p, "User\\S-%u-%u", sid->revision,
-                  ((unsigned int)sid->id_auth[2] << 24) |
-                  ((unsigned int)sid->id_auth[3] << 16) |
-                  ((unsigned int)sid->id_auth[4] << 8) |
-                  ((unsigned int)sid->id_auth[5]) );
-    for (i = 0; i < sid->sub_count; i++) p += sprintf( p, "-%u", sid->sub_auth[i] );
-    return ascii_to_unicode_str( buffer, path );
+/* set up a hive from its contents, checking the header */
+static int init_hive( struct hive *hive, const void *base, size_t size )
+{
+    const struct hive_header *header = base;
+
+    if (size < sizeof(*header) || size > UINT_MAX) return 0;
+
+    hive->base        = base;
+    hive->size        = size;
+    hive->keys        = (const struct hive_key *)(hive->base + header->keys);
+    hive->key_count   = header->key_count;
+    hive->values      = (const struct hive_value *)(hive->base + header->values);
+    hive->value_count = header->value_count;
+    hive->copy        = 0;
+
+    return (header->magic == HIVE_MAGIC && header->version == HIVE_VERSION && header->size == size &&
+            header->key_count && !(header->keys % sizeof(timeout_t)) && !(header->values % sizeof(int)) &&
+            header->key_count <= size / sizeof(struct hive_key) &&
+            header->value_count <= size / sizeof(struct hive_value) &&
+            check_hive_range( hive, header->keys, header->key_count * sizeof(struct hive_key) ) &&
+            check_hive_range( hive, header->values, header->value_count * sizeof(struct hive_value) ) &&
+            hive->keys[0].subtree == header->key_count - 1);
 }
 
-static void init_supported_machines(void)
+/* check a key record and its subkeys, so that loading them can only fail on memory allocation */
+static int check_hive_key( const struct hive *hive, unsigned int index )
 {
-    unsigned int count = 0;
-#ifdef __i386__
+    const struct hive_key *rec = &hive->keys[index];
+    unsigned int i, j, end = index + rec->subtree;
+
+    if (rec->subtree >= hive->key_count - index) return 0;
+    if (rec->value_count > hive->value_count || rec->first_value > hive->value_count - rec->value_count)
+        return 0;
+    if (!check_hive_range( hive, rec->class, rec->classlen )) return 0;
+
+    for (i = 0; i < rec->value_count; i++)
+    {
+        const struct hive_value *val = &hive->values[rec->first_value + i];
+
+        if ((val->namelen % sizeof(WCHAR)) || val->namelen > MAX_VALUE_LEN * sizeof(WCHAR) ||
+            !check_hive_range( hive, val->name, val->namelen ) || !check_hive_range( hive, val->data, val->len ))
+            return 0;
+    }
+
+    for (i = index + 1; i <= end; i += hive->keys[i].subtree + 1)
+    {
+        const struct hive_key *sub = &hive->keys[i];
+        const WCHAR *name = (const WCHAR *)(hive->base + sub->name);
+
+        if (sub->subtree > end - i) return 0;
+        if (!sub->namelen || (sub->namelen % sizeof(WCHAR)) || sub->namelen > MAX_NAME_LEN * sizeof(WCHAR) ||
+            !check_hive_range( hive, sub->name, sub->namelen ))
+            return 0;
+        /* a separator would make the key land somewhere else */
+        for (j = 0; j < sub->namelen / sizeof(WCHAR); j++) if (name[j] == '\\') return 0;
+        if (!check_hive_key( hive, i )) return 0;
+    }
+    return 1;
+}
+
+/* load a value from a checked hive; the data is only copied if the hive doesn't stay around */
+static int load_hive_value( struct key *key, const struct hive *hive, const struct hive_value *rec )
+{
+    struct key_value *value;
+    struct unicode_str name;
+    void *data = NULL;
+    int index;
+
+    if (rec->len)
+    {
+        data = (void *)(hive->base + rec->data);
+        if (hive->copy && !(data = memdup( data, rec->len ))) return 0;
+    }
+
+    name.str = (const WCHAR *)(hive->base + rec->name);
+    name.len = rec->namelen;
+    if (!(value = find_value( key, &name, &index )) && !(value = insert_value( key, &name, index )))
+    {
+        if (hive->copy) free( data );
+        return 0;
+    }
+    free_value_data( value->data );
+    value->type = rec->type;
+    value->len  = rec->len;
+    value->data = data;
+    bump_key_generation( key );
+    return 1;
+}
+
+/* load a key and its subkeys from a checked hive */
+static int load_hive_key( struct key *key, const struct hive *hive, unsigned int index )
+{
+    const struct hive_key *rec = &hive->keys[index];
+    unsigned int i, end = index + rec->subtree;
+    WCHAR *class;
+
+    if (rec->classlen)
+    {
+        if (!(class = memdup( hive->base + rec->class, rec->classlen ))) return 0;
+        free( key->class );
+        key->class    = class;
+        key->classlen = rec->classlen;
+    }
+    if (rec->flags & KEY_SYMLINK) key->flags |= KEY_SYMLINK;
+
+    for (i = 0; i < rec->value_count; i++)
+        if (!load_hive_value( key, hive, &hive->values[rec->first_value + i] )) return 0;
+
+    for (i = index + 1; i <= end; i += hive->keys[i].subtree + 1)
+    {
+        const struct hive_key *sub = &hive->keys[i];
+        struct unicode_str name;
+        struct key *subkey;
+        int ret;
+
+        name.str = (const WCHAR *)(hive->base + sub->name);
+        name.len = sub->namelen;
+        if (!(subkey = create_key_object( &key->obj, &name, OBJ_OPENIF, 0, sub->modif, NULL ))) return 0;
+        ret = load_hive_key( subkey, hive, i );
+        release_object( subkey );
+        if (!ret) return 0;
+    }
+    key->modif = rec->modif;
+    return 1;
+}
+
+/* load a registry branch from its binary hive, if the hive is in sync with the text file */
+static int load_init_registry_from_hive( const char *filename, struct key *key )
+{
+    const struct hive_header *header;
+    struct hive *hive;
+    struct stat st, text_st;
+    char *name;
+    void *base;
+    int fd;
+
+    if (!registry_hive || hive_count == MAX_SAVE_BRANCH_INFO) return 0;
+    if (stat( filename, &text_st ) == -1) return 0;  /* the text file is authoritative */
+
+    if (!(name = malloc( strlen(filename) + 5 ))) return 0;
+    sprintf( name, "%s.bin", filename );
+    fd = open( name, O_RDONLY );
+    free( name );
+    if (fd == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > UINT_MAX)
+    {
+        close( fd );
+        return 0;
+    }
+    base = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (base == MAP_FAILED) return 0;
+
+    header = base;
+    hive = &hives[hive_count];
+    if (!init_hive( hive, base, st.st_size ) || !check_hive_stamp( header, &text_st )) goto failed;
+
+    if (header->prefix_type != PREFIX_UNKNOWN)
+    {
+        if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->prefix_type;
+        else if (header->prefix_type != prefix_type) goto failed;
+    }
+
+    /* nothing may be created from a corrupted hive, the text file is loaded instead */
+    if (!check_hive_key( hive, 0 ))
+    {
+        fprintf( stderr, "wineserver: %s.bin is corrupted, ignoring it\n", filename );
+        goto failed;
+    }
+
+    /* from now on values may point into the mapping, so it has to stay around */
+    hive_count++;
+    load_journal_gen = header->journal;
+    if (!load_hive_key( key, hive, 0 ))
+    {
+        /* out of memory; the text file holds the same data and is loaded on top */
+        return 0;
+    }
+    if (debug_level) fprintf( stderr, "wineserver: loaded %s from binary hive (%u keys, %u values)\n",
+                              filename, header->key_count, header->value_count );
+    return 1;
+
+failed:
+    munmap( base, st.st_size );
+    return 0;
+}
+
+/* load a part of the registry from a binary hive saved with the latest format */
+static void load_registry_hive( struct key *key, int fd, const struct stat *st )
+{
+    struct hive hive;
+    ssize_t ret;
+    char *data;
+
+    if (st->st_size > UINT_MAX)
+    {
+        set_error( STATUS_REGISTRY_CORRUPT );
+        return;
+    }
+    if (!(data = mem_alloc( st->st_size ))) return;
+
+    if ((ret = pread( fd, data, st->st_size, 0 )) == -1) file_set_error();
+    else if (ret != st->st_size || !init_hive( &hive, data, ret ) || !check_hive_key( &hive, 0 ))
+        set_error( STATUS_REGISTRY_CORRUPT );
+    else
+    {
+        hive.copy = 1;
+        if (!load_hive_key( key, &hive, 0 ) && !get_error()) set_error( STATUS_NO_MEMORY );
+    }
+    free( data );
+}
+
+/* replay a journal record on top of a loaded branch */
+static void replay_journal_record( struct key *branch, const struct journal_record *rec )
+{
+    const char *ptr = (const char *)(rec + 1);
+    struct unicode_str path, name;
+    struct key *key, *parent;
+
+    path.str = (const WCHAR *)ptr;
+    path.len = rec->pathlen;
+    name.str = (const WCHAR *)(ptr + rec->pathlen);
+    name.len = rec->namelen;
+
+    if (!(key = create_key_recursive( branch, &path, rec->modif ))) return;
+
+    switch (rec->op)
+    {
+    case JOURNAL_CREATE_KEY:
+        if (rec->namelen)
+        {
+            WCHAR *class;
+
+            if (!(class = memdup( name.str, name.len ))) break;
+            free( key->class );
+            key->class    = class;
+            key->classlen = name.len;
+        }
+        key->flags |= rec->type & KEY_SYMLINK;
+        key->modif = rec->modif;
+        if ((parent = get_parent( key ))) parent->modif = rec->modif;
+        break;
+    case JOURNAL_DELETE_KEY:
+        if (key == branch) break;
+        parent = get_parent( key );
+        if (delete_key( key, 1 ) && parent) parent->modif = rec->modif;
+        break;
+    case JOURNAL_RENAME_KEY:
+        if (key == branch) break;
+        rename_key( key, &name );
+        key->modif = rec->modif;
+        break;
+    case JOURNAL_SET_VALUE:
+        set_value( key, &name, rec->type, ptr + rec->pathlen + rec->namelen, rec->len );
+        key->modif = rec->modif;
+        break;
+    case JOURNAL_DELETE_VALUE:
+        delete_value( key, &name );
+        key->modif = rec->modif;
+        break;
+    }
+    release_object( key );
+    clear_error();
+}
+
+/* check that a journal record is complete and valid */
+static int check_journal_record( struct journal_record *rec, size_t size )
+{
+    unsigned int checksum = rec->checksum;
+    size_t avail;
+    int ret;
+
+    if (size < sizeof(*rec) || rec->size < sizeof(*rec) || rec->size > size) return 0;
+    if (rec->size % sizeof(__int64) || rec->op > JOURNAL_DELETE_VALUE) return 0;
+    if (rec->pathlen % sizeof(WCHAR) || rec->namelen % sizeof(WCHAR)) return 0;
+    avail = rec->size - sizeof(*rec);
+    if (rec->pathlen > avail || rec->namelen > avail - rec->pathlen ||
+        rec->len > avail - rec->pathlen - rec->namelen)
+        return 0;
+    rec->checksum = 0;
+    ret = (journal_checksum( rec, rec->size ) == checksum);
+    rec->checksum = checksum;
+    return ret;
+}
+
+/* replay the journal "<path>.log" on top of a branch that has just been loaded, if it is newer
+ * than the generation included in the file; an incomplete last record is truncated */
+static int load_journal( struct key *branch, const char *path, unsigned int *gen, size_t *size )
+{
+    const struct journal_header *header;
+    unsigned int count = 0;
+    struct stat st;
+    char *name, *data = NULL;
+    size_t pos;
+    int fd, ret = 0;
+
+    if (!(name = malloc( strlen(path) + 5 ))) return 0;
+    sprintf( name, "%s.log", path );
+    if ((fd = open( name, O_RDWR )) == -1) goto done;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > UINT_MAX) goto done;
+    if (!(data = malloc( st.st_size ))) goto done;
+    if (read( fd, data, st.st_size ) != st.st_size) goto done;
+
+    /* an older journal has already been merged into the text file, the next save replaces it */
+    header = (const struct journal_header *)data;
+    if (header->magic != JOURNAL_MAGIC || header->version != JOURNAL_VERSION || header->gen <= *gen)
+        goto done;
+
+    for (pos = sizeof(*header); pos < st.st_size; pos += ((struct journal_record *)(data + pos))->size)
+    {
+        struct journal_record *rec = (struct journal_record *)(data + pos);
+
+        if (!check_journal_record( rec, st.st_size - pos )) break;
+        replay_journal_record( branch, rec );
+        count++;
+    }
+    if (pos < st.st_size)
+    {
+        /* the server died while writing a record, new records must follow the valid ones */
+        fprintf( stderr, "wineserver: %s: ignoring incomplete journal record\n", name );
+        ftruncate( fd, pos );
+    }
+    if (debug_level) fprintf( stderr, "wineserver: replayed %u records from %s\n", count, name );
+    *gen  = header->gen;
+    *size = pos - sizeof(*header);
+    ret = 1;
+
+done:
+    if (fd != -1) close( fd );
+    free( data );
+    free( name );
+    return ret;
+}
+
+/* replay the journal of a branch that has just been loaded, if it is newer than the text file */
+static void load_init_registry_journal( struct save_branch_info *info )
+{
+    unsigned int gen = load_journal_gen;
+    struct stat st;
+    size_t size;
+
+    if (!stat( info->path, &st )) info->base_size = st.st_size;
+    info->saved_gen = load_journal_gen;
+    if (load_journal( info->key, info->path, &gen, &size ))
+    {
+        info->journal_gen  = gen;
+        info->journal_size = size;
+    }
+    else info->journal_gen = load_journal_gen + 1;
+}
+
+/* load a part of the registry from a file */
+static void load_registry( struct key *key, obj_handle_t handle )
+{
+    struct file *file;
+    struct stat st;
+    unsigned int magic;
+    int fd;
+
+    if (!(file = get_file_obj( current->process, handle, FILE_READ_DATA ))) return;
+    fd = dup( get_file_unix_fd( file ) );
+    release_object( file );
+    if (fd == -1) return;
+
+    if (!fstat( fd, &st ) && pread( fd, &magic, sizeof(magic), 0 ) == sizeof(magic) && magic == HIVE_MAGIC)
+    {
+        load_registry_hive( key, fd, &st );
+        close( fd );
+    }
+    else
+    {
+        FILE *f = fdopen( fd, "r" );
+        if (f)
+        {
+            load_keys( key, NULL, f, -1 );
+            fclose( f );
+        }
+        else
+        {
+            file_set_error();
+            close( fd );
+        }
+    }
+}
+
+/* load one of the initial registry files */
+static int load_init_registry_from_file( const char *filename, struct key *key )
+{
+    FILE *f = NULL;
+    int loaded;
+
+    load_journal_gen = 0;
+    if (!(loaded = load_init_registry_from_hive( filename, key )) && (f = fopen( filename, "r" )))
+    {
+        load_keys( key, filename, f, 0 );
+        fclose( f );
+        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        {
+            fprintf( stderr, "%s is not a valid registry file\n", filename );
+            return 1;
+        }
+    }
+
+    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+
+    save_branch_info[save_branch_count].path = filename;
+    save_branch_info[save_branch_count].key = (struct key *)grab_object( key );
+    make_object_permanent( &key->obj );
+    load_init_registry_journal( &save_branch_info[save_branch_count++] );
+    return loaded || f != NULL;
+}
+
+static WCHAR *format_user_registry_path( const struct sid *sid, struct unicode_str *path )
+{
+    char buffer[7 + 11 + 11 + 11 * ARRAY_SIZE(sid->sub_auth)], *p = buffer;
+    unsigned int i;
+
+    p += sprintf( p, "User\\S-%u-%u", sid->revision,
+                  ((unsigned int)sid->id_auth[2] << 24) |
+                  ((unsigned int)sid->id_auth[3] << 16) |
+                  ((unsigned int)sid->id_auth[4] << 8) |
+                  ((unsigned int)sid->id_auth[5]) );
+    for (i = 0; i < sid->sub_count; i++) p += sprintf( p, "-%u", sid->sub_auth[i] );
+    return ascii_to_unicode_str( buffer, path );
+}
+
+static void init_supported_machines(void)
+{
+    unsigned int count = 0;
+#ifdef __i386__
     if (prefix_type == PREFIX_32BIT) supported_machines[count++] = IMAGE_FILE_MACHINE_I386;
 #elif defined(__x86_64__)
     if (prefix_type == PREFIX_64BIT) supported_machines[count++] = IMAGE_FILE_MACHINE_AMD64;
@@ -1908,6 +2905,9 @@ void init_registry(void)
 
     if (fchdir( config_dir_fd ) == -1) fatal_error( "chdir to config dir: %s\n", strerror( errno ));
 
+    /* binary hives are only used if explicitly requested */
+    if ((p = getenv( "WINEREGISTRYHIVE" ))) registry_hive = atoi( p );
+
     /* create the root key */
     root_key = create_key_object( NULL, &root_name, OBJ_PERMANENT, 0, current_time, NULL );
     assert( root_key );
@@ -1978,6 +2978,10 @@ void init_registry(void)
     release_object( hkcu );
 
     /* start the periodic save timer */
+#if defined(HAVE_OPEN_MEMSTREAM) && defined(HAVE_RENAMEAT)
+    registry_worker = create_worker( "registry" );
+    registry_journal = (registry_worker != NULL);
+#endif
     set_periodic_save_timer();
 
     /* create windows directories */
@@ -2002,7 +3006,7 @@ void init_registry(void)
 }
 
 /* save a registry branch to a file */
-static void save_all_subkeys( struct key *key, FILE *f )
+static void save_all_subkeys( struct key *key, FILE *f, unsigned int journal )
 {
     fprintf( f, "WINE REGISTRY Version 2\n" );
     fprintf( f, ";; All keys relative to " );
@@ -2019,6 +3023,7 @@ static void save_all_subkeys( struct key *key, FILE *f )
     default:
         break;
     }
+    if (journal) fprintf( f, "#journal=%u\n", journal );
     save_subkeys( key, key, f );
 }
 
@@ -2036,7 +3041,7 @@ static void save_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "w" );
         if (f)
         {
-            save_all_subkeys( key, f );
+            save_all_subkeys( key, f, 0 );
             if (fclose( f )) file_set_error();
         }
         else
@@ -2047,12 +3052,191 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+#ifdef HAVE_RENAMEAT
+
+/* write a buffer to a unix fd */
+static int write_all( int fd, const char *data, size_t size )
+{
+    ssize_t ret;
+
+    while (size)
+    {
+        if ((ret = write( fd, data, size )) == -1)
+        {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        data += ret;
+        size -= ret;
+    }
+    return 1;
+}
+
+/* count the keys and values that need to be saved */
+static void count_hive_keys( const struct key *key, unsigned int *keys, unsigned int *values )
+{
+    int i;
+
+    ++*keys;
+    *values += key->last_value + 1;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) count_hive_keys( key->subkeys[i], keys, values );
+}
+
+/* save a key and its subkeys to a hive buffer; return the number of key records used */
+static unsigned int save_hive_key( struct key *key, const struct key *base, struct save_buffer *buf,
+                                   unsigned int index, unsigned int *value_index )
+{
+    const struct hive_header *header = (const struct hive_header *)buf->data;
+    struct hive_key rec;
+    struct hive_value val;
+    unsigned int count = 1;
+    int i;
+
+    sort_entries( key, 0 );
+    sort_entries( key, 1 );
+    memset( &rec, 0, sizeof(rec) );
+    rec.modif = key->modif;
+    if (key != base)
+    {
+        rec.name    = append_save_buffer( buf, key->obj.name->name, key->obj.name->len, sizeof(WCHAR) );
+        rec.namelen = key->obj.name->len;
+    }
+    rec.class       = append_save_buffer( buf, key->class, key->classlen, sizeof(WCHAR) );
+    rec.classlen    = key->classlen;
+    rec.flags       = key->flags & KEY_SYMLINK;
+    rec.first_value = *value_index;
+    rec.value_count = key->last_value + 1;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        const struct key_value *value = &key->values[i];
+
+        val.name    = append_save_buffer( buf, value->name, value->namelen, sizeof(WCHAR) );
+        val.namelen = value->namelen;
+        val.type    = value->type;
+        val.data    = append_save_buffer( buf, value->data, value->len, sizeof(__int64) );
+        val.len     = value->len;
+        if (buf->failed) return 0;
+        header = (const struct hive_header *)buf->data;
+        memcpy( buf->data + header->values + (*value_index)++ * sizeof(val), &val, sizeof(val) );
+    }
+
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        if (key->subkeys[i]->flags & KEY_VOLATILE) continue;
+        count += save_hive_key( key->subkeys[i], base, buf, index + count, value_index );
+    }
+    if (buf->failed) return 0;
+
+    rec.subtree = count - 1;
+    header = (const struct hive_header *)buf->data;
+    memcpy( buf->data + header->keys + index * sizeof(rec), &rec, sizeof(rec) );
+    return count;
+}
+
+/* build the binary hive of a registry branch; the text file stamp is set when writing it */
+static int build_hive( struct key *key, unsigned int journal, struct save_buffer *buf )
+{
+    struct hive_header *header;
+    unsigned int keys = 0, values = 0, value_index = 0, hdr, keys_offset, values_offset;
+
+    memset( buf, 0, sizeof(*buf) );
+    count_hive_keys( key, &keys, &values );
+    hdr           = reserve_save_buffer( buf, sizeof(*header), sizeof(__int64) );
+    keys_offset   = reserve_save_buffer( buf, (size_t)keys * sizeof(struct hive_key), sizeof(__int64) );
+    values_offset = reserve_save_buffer( buf, (size_t)values * sizeof(struct hive_value), sizeof(int) );
+    if (buf->failed) goto failed;
+
+    header = (struct hive_header *)(buf->data + hdr);
+    header->magic       = HIVE_MAGIC;
+    header->version     = HIVE_VERSION;
+    header->prefix_type = prefix_type;
+    header->keys        = keys_offset;
+    header->key_count   = keys;
+    header->values      = values_offset;
+    header->value_count = values;
+    header->journal     = journal;
+
+    if (save_hive_key( key, key, buf, 0, &value_index ) != keys) goto failed;
+    header = (struct hive_header *)buf->data;
+    header->size = buf->size;
+    return 1;
+
+failed:
+    free( buf->data );
+    memset( buf, 0, sizeof(*buf) );
+    return 0;
+}
+
+/* replace a file with the given contents, going through a temp file in the same directory */
+static int replace_file( int dir_fd, const char *path, const char *data, size_t size )
+{
+    char *p, *tmp;
+    int fd, count = 0, ret = 0;
+
+    if (!(tmp = malloc( strlen(path) + 20 ))) return 0;
+    strcpy( tmp, path );
+    if ((p = strrchr( tmp, '/' ))) p++;
+    else p = tmp;
+    for (;;)
+    {
+        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
+        if ((fd = openat( dir_fd, tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
+        if (errno != EEXIST) goto done;
+    }
+
+    ret = write_all( fd, data, size );
+    if (close( fd )) ret = 0;
+    if (ret) ret = !renameat( dir_fd, tmp, dir_fd, path );
+    if (!ret) unlinkat( dir_fd, tmp, 0 );
+
+done:
+    free( tmp );
+    return ret;
+}
+
+/* write the binary hive next to the text file it was built from */
+static int write_hive_file( int dir_fd, const char *path, struct save_buffer *buf )
+{
+    struct hive_header *header = (struct hive_header *)buf->data;
+    struct stat st;
+    char *name;
+    int ret;
+
+    if (fstatat( dir_fd, path, &st, 0 ) == -1) return 0;
+    set_hive_stamp( header, &st );
+
+    if (!(name = malloc( strlen(path) + 5 ))) return 0;
+    sprintf( name, "%s.bin", path );
+    /* always replace the file, it may be mapped by a running server */
+    ret = replace_file( dir_fd, name, buf->data, buf->size );
+    free( name );
+    return ret;
+}
+
+/* remove the journal of a branch once its changes have been saved to the text file */
+static void remove_journal_file( int dir_fd, const char *path )
+{
+    char *name;
+
+    if (!(name = malloc( strlen(path) + 5 ))) return;
+    sprintf( name, "%s.log", path );
+    unlinkat( dir_fd, name, 0 );
+    free( name );
+}
+
+#endif  /* HAVE_RENAMEAT */
+
 /* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+static int save_branch( struct save_branch_info *info )
 {
+    struct key *key = info->key;
+    const char *path = info->path;
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
+    long size;
     FILE *f;
 
     if (!(key->flags & KEY_DIRTY))
@@ -2105,7 +3289,8 @@ static int save_branch( struct key *key, const char *path )
         dump_operation( key, NULL, "saving" );
     }
 
-    save_all_subkeys( key, f );
+    save_all_subkeys( key, f, info->journal_gen );
+    size = ftell( f );
     ret = !fclose(f);
 
     if (tmp)
@@ -2117,19 +3302,272 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    if (ret)
+    {
+#ifdef HAVE_RENAMEAT
+        struct save_buffer hive;
+
+        if (registry_hive && build_hive( key, info->journal_gen, &hive ))
+        {
+            write_hive_file( config_dir_fd, path, &hive );
+            free( hive.data );
+        }
+        remove_journal_file( config_dir_fd, path );
+#endif
+        info->saved_gen = info->journal_gen;
+        start_new_journal( info, size );
+        make_clean( key );
+    }
+    return ret;
+}
+
+#if defined(HAVE_OPEN_MEMSTREAM) && defined(HAVE_RENAMEAT)
+
+/* a registry branch formatted in memory, waiting to be written by the registry worker */
+struct save_job
+{
+    struct save_branch_info *info;    /* branch being saved */
+    unsigned int             gen;     /* journal generation included in the data */
+    int                      dir_fd;  /* directory the path is relative to */
+    char                    *data;    /* formatted branch contents */
+    size_t                   size;    /* size of the data */
+    struct save_buffer       hive;    /* binary hive, if enabled */
+};
+
+/* the text file of a branch has been written; runs in the registry worker thread */
+static void saved_branch_file( struct save_job *job )
+{
+    /* checked by the journal jobs, which run after this one in the same thread */
+    job->info->saved_gen = job->gen;
+    remove_journal_file( job->dir_fd, job->info->path );
+}
+
+/* write a formatted registry branch to its file; runs in the registry worker thread */
+static int write_branch_file( void *arg )
+{
+    struct save_job *job = arg;
+    const char *path = job->info->path;
+    struct stat st;
+    char *p, *tmp = NULL;
+    int fd, count = 0, ret = 0;
+
+    /* same logic as save_branch, but relative to the config dir since the
+     * main thread may change the current directory at any time */
+
+    if ((fd = openat( job->dir_fd, path, O_WRONLY )) != -1)
+    {
+        if (!fstatat( job->dir_fd, path, &st, AT_SYMLINK_NOFOLLOW ) &&
+            (!S_ISREG(st.st_mode) || st.st_nlink > 1))
+        {
+            ftruncate( fd, 0 );
+            ret = write_all( fd, job->data, job->size );
+            if (close( fd )) ret = 0;
+            if (ret && job->hive.data) write_hive_file( job->dir_fd, path, &job->hive );
+            if (ret) saved_branch_file( job );
+            return ret;
+        }
+        close( fd );
+    }
+
+    if (!(tmp = malloc( strlen(path) + 20 ))) return 0;
+    strcpy( tmp, path );
+    if ((p = strrchr( tmp, '/' ))) p++;
+    else p = tmp;
+    for (;;)
+    {
+        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
+        if ((fd = openat( job->dir_fd, tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
+        if (errno != EEXIST) goto done;
+    }
+
+    ret = write_all( fd, job->data, job->size );
+    if (close( fd )) ret = 0;
+    if (ret) ret = !renameat( job->dir_fd, tmp, job->dir_fd, path );
+    if (!ret) unlinkat( job->dir_fd, tmp, 0 );
+
+done:
+    free( tmp );
+    if (ret && job->hive.data) write_hive_file( job->dir_fd, path, &job->hive );
+    if (ret) saved_branch_file( job );
     return ret;
 }
 
+/* completion of a branch save; runs in the main thread */
+static void write_branch_done( void *arg, int status )
+{
+    struct save_job *job = arg;
+
+    job->info->pending = 0;
+    if (!status)
+    {
+        fprintf( stderr, "wineserver: could not save registry branch to %s\n", job->info->path );
+        make_dirty( job->info->key );  /* try again on the next save */
+    }
+    free( job->data );
+    free( job->hive.data );
+    free( job );
+}
+
+/* format a registry branch in memory and queue it to the registry worker */
+static int queue_save_branch( struct save_branch_info *info )
+{
+    struct save_job *job;
+    FILE *f;
+
+    if (!(info->key->flags & KEY_DIRTY)) return 1;
+    if (info->pending) return 1;  /* will be saved again next time */
+
+    if (!(job = mem_alloc( sizeof(*job) ))) return 0;
+    job->info   = info;
+    job->gen    = info->journal_gen;
+    job->dir_fd = config_dir_fd;
+    job->data   = NULL;
+    job->size   = 0;
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->path );
+        dump_operation( info->key, NULL, "queuing save" );
+    }
+
+    memset( &job->hive, 0, sizeof(job->hive) );
+
+    if (!(f = open_memstream( &job->data, &job->size ))) goto failed;
+    save_all_subkeys( info->key, f, info->journal_gen );
+    if (fclose( f )) goto failed;
+    if (registry_hive) build_hive( info->key, info->journal_gen, &job->hive );  /* the text file is enough on failure */
+
+    if (!queue_worker_job( registry_worker, write_branch_file, write_branch_done, job )) goto failed;
+    info->pending = 1;
+    start_new_journal( info, job->size );  /* the pending records are part of the saved branch */
+    make_clean( info->key );
+    return 1;
+
+failed:
+    free( job->data );
+    free( job->hive.data );
+    free( job );
+    return 0;
+}
+
+/* journal records waiting to be appended by the registry worker */
+struct journal_job
+{
+    struct save_branch_info *info;    /* branch the records belong to */
+    int                      dir_fd;  /* directory the path is relative to */
+    struct save_buffer       data;    /* journal header followed by the records */
+};
+
+/* append records to the journal of a branch; runs in the registry worker thread */
+static int write_journal_file( void *arg )
+{
+    struct journal_job *job = arg;
+    const struct journal_header *header = (const struct journal_header *)job->data.data;
+    struct journal_header current;
+    char *name;
+    off_t end;
+    int fd, ret;
+
+    if (!(name = malloc( strlen(job->info->path) + 5 ))) return 0;
+    sprintf( name, "%s.log", job->info->path );
+
+    /* an older journal can only be replaced once a save including it has succeeded;
+     * otherwise its records are still needed, and the new ones go after them */
+    if ((fd = openat( job->dir_fd, name, O_RDWR )) != -1)
+    {
+        if (pread( fd, &current, sizeof(current), 0 ) == sizeof(current) &&
+            current.magic == JOURNAL_MAGIC && current.version == JOURNAL_VERSION &&
+            current.gen > job->info->saved_gen && (end = lseek( fd, 0, SEEK_END )) != -1)
+        {
+            ret = write_all( fd, job->data.data + sizeof(*header), job->data.size - sizeof(*header) );
+            if (!ret) ftruncate( fd, end );  /* don't leave an incomplete record behind */
+            /* the generation is updated last, the records are replayed either way */
+            else if (current.gen != header->gen)
+                ret = (pwrite( fd, header, sizeof(*header), 0 ) == sizeof(*header));
+            if (close( fd )) ret = 0;
+            free( name );
+            return ret;
+        }
+        close( fd );
+    }
+
+    /* the journal doesn't exist yet, or its records are in the text file */
+    ret = replace_file( job->dir_fd, name, job->data.data, job->data.size );
+    free( name );
+    return ret;
+}
+
+/* completion of a journal write; runs in the main thread */
+static void write_journal_done( void *arg, int status )
+{
+    struct journal_job *job = arg;
+
+    if (!status)
+    {
+        fprintf( stderr, "wineserver: could not write registry journal for %s\n", job->info->path );
+        make_dirty( job->info->key );  /* save the whole branch instead */
+    }
+    free( job->data.data );
+    free( job );
+}
+
+/* queue the pending journal records of a branch to the registry worker */
+static int queue_journal( struct save_branch_info *info )
+{
+    struct journal_header *header;
+    struct journal_job *job;
+
+    if (info->journal.size <= sizeof(*header)) return 1;
+
+    if (!(job = mem_alloc( sizeof(*job) ))) return 0;
+    header = (struct journal_header *)info->journal.data;
+    header->magic   = JOURNAL_MAGIC;
+    header->version = JOURNAL_VERSION;
+    header->gen     = info->journal_gen;
+    job->info   = info;
+    job->dir_fd = config_dir_fd;
+    job->data   = info->journal;
+
+    if (!queue_worker_job( registry_worker, write_journal_file, write_journal_done, job ))
+    {
+        free( job );
+        return 0;
+    }
+    info->journal_size += info->journal.size - sizeof(*header);
+    memset( &info->journal, 0, sizeof(info->journal) );
+    return 1;
+}
+
+#endif  /* HAVE_OPEN_MEMSTREAM && HAVE_RENAMEAT */
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
     int i;
 
-    if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+#if defined(HAVE_OPEN_MEMSTREAM) && defined(HAVE_RENAMEAT)
+    if (registry_worker)
+    {
+        /* only the formatting is done here, the file I/O happens in the worker */
+        for (i = 0; i < save_branch_count; i++)
+        {
+            struct save_branch_info *info = &save_branch_info[i];
+
+            /* merge the journal into the text file once it gets large compared to it */
+            if (!info->pending && info->journal_size + info->journal.size >
+                max( journal_min_compact, info->base_size / 2 ))
+                make_dirty( info->key );
+
+            if (info->key->flags & KEY_DIRTY) queue_save_branch( info );
+            else queue_journal( info );
+        }
+        set_periodic_save_timer();
+        return;
+    }
+#endif
+    if (fchdir( config_dir_fd ) == -1) return;
+    for (i = 0; i < save_branch_count; i++) save_branch( &save_branch_info[i] );
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2141,15 +3579,34 @@ static void set_periodic_save_timer(void)
     save_timeout_user = add_timeout_user( save_period, periodic_save, NULL );
 }
 
+/* queue the changes made to the branch containing a key for writing, without waiting for them;
+ * without the worker the branch is saved by the next periodic save as before */
+static void flush_key_branch( struct key *key )
+{
+#if defined(HAVE_OPEN_MEMSTREAM) && defined(HAVE_RENAMEAT)
+    struct save_branch_info *info;
+
+    if (!registry_worker || !(info = get_key_branch( key ))) return;
+    if (info->key->flags & KEY_DIRTY) queue_save_branch( info );
+    else queue_journal( info );
+#endif
+}
+
 /* save the modified registry branches to disk */
 void flush_registry(void)
 {
     int i;
 
+    /* wait for the pending saves, failed ones will have been marked dirty again */
+    if (registry_worker) flush_worker( registry_worker );
+
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        /* merge the journals, the text files must be complete once the server is gone */
+        if (save_branch_info[i].journal_size || save_branch_info[i].journal.size)
+            make_dirty( save_branch_info[i].key );
+        if (!save_branch( &save_branch_info[i] ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -2171,13 +3628,15 @@ DECL_HANDLER(create_key)
 {
     struct key *key, *parent = NULL;
     unsigned int access = req->access;
-    const WCHAR *class;
-    struct unicode_str name;
+    struct unicode_str name, class;
     const struct security_descriptor *sd;
     const struct object_attributes *objattr = get_req_object_attributes( &sd, &name, NULL );
 
     if (!objattr) return;
 
+    class.str = get_req_data_after_objattr( objattr, &class.len );
+    class.len = (class.len / sizeof(WCHAR)) * sizeof(WCHAR);
+
     if (!is_wow64_thread( current )) access = (access & ~KEY_WOW64_32KEY) | KEY_WOW64_64KEY;
 
     if (objattr->rootdir)
@@ -2185,13 +3644,8 @@ DECL_HANDLER(create_key)
         if (!(parent = get_hkey_obj( objattr->rootdir, 0 ))) return;
     }
 
-    if ((key = create_key( parent, &name, req->options, access, objattr->attributes, sd )))
+    if ((key = create_key( parent, &name, &class, req->options, access, objattr->attributes, sd )))
     {
-        if ((class = get_req_data_after_objattr( objattr, &key->classlen )))
-        {
-            key->classlen = (key->classlen / sizeof(WCHAR)) * sizeof(WCHAR);
-            if (!(key->class = memdup( class, key->classlen ))) key->classlen = 0;
-        }
         reply->hkey = alloc_handle( current->process, key, access, objattr->attributes );
         release_object( key );
     }
@@ -2235,7 +3689,7 @@ DECL_HANDLER(flush_key)
     struct key *key = get_hkey_obj( req->hkey, 0 );
     if (key)
     {
-        /* we don't need to do anything here with the current implementation */
+        flush_key_branch( key );
         release_object( key );
     }
 }
@@ -2285,11 +3739,19 @@ DECL_HANDLER(get_key_value)
     reply->total = 0;
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
+        if ((reply->cache_slot = get_cache_slot( key ))) reply->cache_gen = cache_gens[reply->cache_slot];
         get_value( key, &name, &reply->type, &reply->total );
         release_object( key );
     }
 }
 
+/* retrieve the registry key generation counters */
+DECL_HANDLER(get_registry_cache)
+{
+    if (init_registry_cache())
+        reply->handle = alloc_handle( current->process, cache_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 );
+}
+
 /* enumerate the value of a registry key */
 DECL_HANDLER(enum_key_value)
 {
@@ -2335,7 +3797,7 @@ DECL_HANDLER(load_registry)
         if (!(parent = get_hkey_obj( objattr->rootdir, 0 ))) return;
     }
 
-    if ((key = create_key( parent, &name, 0, KEY_WOW64_64KEY, 0, sd )))
+    if ((key = create_key( parent, &name, NULL, 0, KEY_WOW64_64KEY, 0, sd )))
     {
         load_registry( key, req->file );
         release_object( key );
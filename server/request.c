@@ -326,6 +326,77 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* execute the requests of a batch back-to-back, collecting their replies in a single buffer */
+DECL_HANDLER(batch_requests)
+{
+    const char *ptr = get_req_data(), *end = ptr + get_req_data_size();
+    unsigned int i, count = req->count;
+    union generic_request batch_req = current->req;
+    void *batch_data = current->req_data;
+    data_size_t max_size = get_reply_max_size(), pos = 0;
+    unsigned int error = STATUS_SUCCESS;
+    char *replies = NULL;
+
+    if (max_size && !(replies = mem_alloc( max_size ))) return;
+
+    for (i = 0; i < count; i++)
+    {
+        union generic_request sub_req;
+        union generic_reply sub_reply;
+        data_size_t size, reply_size;
+
+        if (end - ptr < sizeof(sub_req))
+        {
+            error = STATUS_INVALID_PARAMETER;
+            break;
+        }
+        memcpy( &sub_req, ptr, sizeof(sub_req) );
+        size = sub_req.request_header.request_size;
+        reply_size = BATCH_ALIGN( sub_req.request_header.reply_size );
+        if (sub_req.request_header.req >= REQ_NB_REQUESTS ||
+            sub_req.request_header.req == REQ_batch_requests ||
+            size > end - ptr - sizeof(sub_req) ||
+            reply_size + sizeof(sub_reply) > max_size - pos)
+        {
+            error = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        current->req = sub_req;
+        current->req_data = (void *)(ptr + sizeof(sub_req));
+        current->reply_size = 0;
+        clear_error();
+        memset( &sub_reply, 0, sizeof(sub_reply) );
+
+        if (debug_level) trace_request();
+        req_handlers[sub_req.request_header.req]( &current->req, &sub_reply );
+        if (!current)  /* the thread has been killed */
+        {
+            free( replies );
+            return;
+        }
+
+        sub_reply.reply_header.error = current->error;
+        sub_reply.reply_header.reply_size = current->reply_size;
+        if (debug_level) trace_reply( sub_req.request_header.req, &sub_reply );
+        memcpy( replies + pos, &sub_reply, sizeof(sub_reply) );
+        if (current->reply_size) memcpy( replies + pos + sizeof(sub_reply), current->reply_data, current->reply_size );
+        free( current->reply_data );
+        current->reply_data = NULL;
+
+        pos += sizeof(sub_reply) + reply_size;
+        ptr += sizeof(sub_req) + BATCH_ALIGN( size );
+        if (ptr > end) ptr = end;
+    }
+
+    current->req = batch_req;
+    current->req_data = batch_data;
+    current->reply_size = 0;
+    set_error( error );
+    reply->count = i;
+    set_reply_data_ptr( replies, pos );
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
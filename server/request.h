@@ -132,6 +132,7 @@ DECL_HANDLER(get_process_info);
 DECL_HANDLER(get_process_debug_info);
 DECL_HANDLER(get_process_image_name);
 DECL_HANDLER(get_process_vm_counters);
+DECL_HANDLER(get_process_handle_count);
 DECL_HANDLER(set_process_info);
 DECL_HANDLER(get_thread_info);
 DECL_HANDLER(get_thread_times);
@@ -185,6 +186,8 @@ DECL_HANDLER(open_mapping);
 DECL_HANDLER(get_mapping_info);
 DECL_HANDLER(map_view);
 DECL_HANDLER(unmap_view);
+DECL_HANDLER(get_image_relocs);
+DECL_HANDLER(set_image_relocs);
 DECL_HANDLER(get_mapping_committed_range);
 DECL_HANDLER(add_mapping_committed_range);
 DECL_HANDLER(is_same_mapping);
@@ -206,6 +209,7 @@ DECL_HANDLER(flush_key);
 DECL_HANDLER(enum_key);
 DECL_HANDLER(set_key_value);
 DECL_HANDLER(get_key_value);
+DECL_HANDLER(get_registry_cache);
 DECL_HANDLER(enum_key_value);
 DECL_HANDLER(delete_key_value);
 DECL_HANDLER(load_registry);
@@ -408,6 +412,7 @@ DECL_HANDLER(open_fsync);
 DECL_HANDLER(get_fsync_idx);
 DECL_HANDLER(fsync_msgwait);
 DECL_HANDLER(get_fsync_apc_idx);
+DECL_HANDLER(batch_requests);
 
 #ifdef WANT_REQUEST_HANDLERS
 
@@ -427,6 +432,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_process_debug_info,
     (req_handler)req_get_process_image_name,
     (req_handler)req_get_process_vm_counters,
+    (req_handler)req_get_process_handle_count,
     (req_handler)req_set_process_info,
     (req_handler)req_get_thread_info,
     (req_handler)req_get_thread_times,
@@ -480,6 +486,8 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_mapping_info,
     (req_handler)req_map_view,
     (req_handler)req_unmap_view,
+    (req_handler)req_get_image_relocs,
+    (req_handler)req_set_image_relocs,
     (req_handler)req_get_mapping_committed_range,
     (req_handler)req_add_mapping_committed_range,
     (req_handler)req_is_same_mapping,
@@ -501,6 +509,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_enum_key,
     (req_handler)req_set_key_value,
     (req_handler)req_get_key_value,
+    (req_handler)req_get_registry_cache,
     (req_handler)req_enum_key_value,
     (req_handler)req_delete_key_value,
     (req_handler)req_load_registry,
@@ -703,6 +712,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_fsync_idx,
     (req_handler)req_fsync_msgwait,
     (req_handler)req_get_fsync_apc_idx,
+    (req_handler)req_batch_requests,
 };
 
 C_ASSERT( sizeof(abstime_t) == 8 );
@@ -784,7 +794,9 @@ C_ASSERT( FIELD_OFFSET(struct init_first_thread_reply, tid) == 12 );
 C_ASSERT( FIELD_OFFSET(struct init_first_thread_reply, server_start) == 16 );
 C_ASSERT( FIELD_OFFSET(struct init_first_thread_reply, session_id) == 24 );
 C_ASSERT( FIELD_OFFSET(struct init_first_thread_reply, info_size) == 28 );
-C_ASSERT( sizeof(struct init_first_thread_reply) == 32 );
+C_ASSERT( FIELD_OFFSET(struct init_first_thread_reply, shm_handle) == 32 );
+C_ASSERT( FIELD_OFFSET(struct init_first_thread_reply, shm_slot) == 36 );
+C_ASSERT( sizeof(struct init_first_thread_reply) == 40 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_request, unix_tid) == 12 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_request, reply_fd) == 16 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_request, wait_fd) == 20 );
@@ -792,6 +804,7 @@ C_ASSERT( FIELD_OFFSET(struct init_thread_request, teb) == 24 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_request, entry) == 32 );
 C_ASSERT( sizeof(struct init_thread_request) == 40 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, suspend) == 8 );
+C_ASSERT( FIELD_OFFSET(struct init_thread_reply, shm_slot) == 12 );
 C_ASSERT( sizeof(struct init_thread_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, exit_code) == 16 );
@@ -835,6 +848,11 @@ C_ASSERT( FIELD_OFFSET(struct get_process_vm_counters_reply, working_set_size) =
 C_ASSERT( FIELD_OFFSET(struct get_process_vm_counters_reply, pagefile_usage) == 40 );
 C_ASSERT( FIELD_OFFSET(struct get_process_vm_counters_reply, peak_pagefile_usage) == 48 );
 C_ASSERT( sizeof(struct get_process_vm_counters_reply) == 56 );
+C_ASSERT( FIELD_OFFSET(struct get_process_handle_count_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_process_handle_count_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_process_handle_count_reply, count) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_process_handle_count_reply, max_count) == 12 );
+C_ASSERT( sizeof(struct get_process_handle_count_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_process_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_process_info_request, mask) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_process_info_request, priority) == 20 );
@@ -1142,6 +1160,14 @@ C_ASSERT( FIELD_OFFSET(struct map_view_request, start) == 40 );
 C_ASSERT( sizeof(struct map_view_request) == 48 );
 C_ASSERT( FIELD_OFFSET(struct unmap_view_request, base) == 16 );
 C_ASSERT( sizeof(struct unmap_view_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocs_request, base) == 16 );
+C_ASSERT( sizeof(struct get_image_relocs_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocs_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocs_reply, fill) == 12 );
+C_ASSERT( sizeof(struct get_image_relocs_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct set_image_relocs_request, base) == 16 );
+C_ASSERT( FIELD_OFFSET(struct set_image_relocs_request, success) == 24 );
+C_ASSERT( sizeof(struct set_image_relocs_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_committed_range_request, base) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_committed_range_request, offset) == 24 );
 C_ASSERT( sizeof(struct get_mapping_committed_range_request) == 32 );
@@ -1243,7 +1269,12 @@ C_ASSERT( FIELD_OFFSET(struct get_key_value_request, hkey) == 12 );
 C_ASSERT( sizeof(struct get_key_value_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, total) == 12 );
-C_ASSERT( sizeof(struct get_key_value_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, cache_slot) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, cache_gen) == 20 );
+C_ASSERT( sizeof(struct get_key_value_reply) == 24 );
+C_ASSERT( sizeof(struct get_registry_cache_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_registry_cache_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_registry_cache_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, index) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, info_class) == 20 );
@@ -2350,6 +2381,10 @@ C_ASSERT( sizeof(struct fsync_msgwait_request) == 16 );
 C_ASSERT( sizeof(struct get_fsync_apc_idx_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_fsync_apc_idx_reply, shm_idx) == 8 );
 C_ASSERT( sizeof(struct get_fsync_apc_idx_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct batch_requests_request, count) == 12 );
+C_ASSERT( sizeof(struct batch_requests_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct batch_requests_reply, count) == 8 );
+C_ASSERT( sizeof(struct batch_requests_reply) == 16 );
 
 #endif  /* WANT_REQUEST_HANDLERS */
 
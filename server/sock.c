@@ -130,6 +130,17 @@ union unix_sockaddr
 
 static struct list poll_list = LIST_INIT( poll_list );
 
+struct poll_socket_entry
+{
+    struct list entry;          /* entry in the socket's list of polls */
+    struct poll_req *req;       /* poll request this entry belongs to */
+    struct sock *sock;
+    int mask;
+    obj_handle_t handle;
+    int flags;
+    unsigned int status;
+};
+
 struct poll_req
 {
     struct list entry;
@@ -140,14 +151,7 @@ struct poll_req
     int exclusive;
     int pending;
     unsigned int count;
-    struct
-    {
-        struct sock *sock;
-        int mask;
-        obj_handle_t handle;
-        int flags;
-        unsigned int status;
-    } sockets[1];
+    struct poll_socket_entry sockets[1];
 };
 
 struct accept_req
@@ -234,6 +238,7 @@ struct sock
     struct accept_req  *accept_recv_req; /* pending accept-into request which will recv on this socket */
     struct connect_req *connect_req; /* pending connection request */
     struct poll_req    *main_poll;   /* main poll */
+    struct list         poll_list;   /* entries of poll requests waiting on this socket */
     union win_sockaddr  addr;        /* socket name */
     int                 addr_len;    /* socket name length */
     unsigned int        rcvbuf;      /* advisory recv buffer size */
@@ -1033,7 +1038,10 @@ static void free_poll_req( void *private )
     if (req->timeout) remove_timeout_user( req->timeout );
 
     for (i = 0; i < req->count; ++i)
+    {
+        list_remove( &req->sockets[i].entry );
         release_object( req->sockets[i].sock );
+    }
     release_object( req->async );
     release_object( req->iosb );
     list_remove( &req->entry );
@@ -1152,35 +1160,48 @@ static void complete_async_poll( struct poll_req *req, unsigned int status )
     }
 }
 
+/* return the first entry of the next poll request in the socket's list;
+ * the entries of a request are always contiguous, since they are all added
+ * when the request is created */
+static struct list *next_poll_req_entry( struct sock *sock, struct poll_req *req, struct list *ptr )
+{
+    while ((ptr = list_next( &sock->poll_list, ptr )) &&
+           LIST_ENTRY( ptr, struct poll_socket_entry, entry )->req == req);
+    return ptr;
+}
+
 static void complete_async_polls( struct sock *sock, int event, int error )
 {
     int flags = get_poll_flags( sock, event );
-    struct poll_req *req, *next;
+    struct list *ptr = list_head( &sock->poll_list );
 
-    LIST_FOR_EACH_ENTRY_SAFE( req, next, &poll_list, struct poll_req, entry )
+    while (ptr)
     {
-        unsigned int i;
+        struct list *cur = ptr;
+        struct poll_req *req = LIST_ENTRY( cur, struct poll_socket_entry, entry )->req;
+        int signaled = 0;
+
+        /* completing the request may free it, so find the next one first */
+        ptr = next_poll_req_entry( sock, req, cur );
 
         if (req->iosb->status != STATUS_PENDING) continue;
 
-        for (i = 0; i < req->count; ++i)
+        for (; cur != ptr; cur = list_next( &sock->poll_list, cur ))
         {
-            if (req->sockets[i].sock != sock) continue;
-            if (!(req->sockets[i].mask & flags)) continue;
+            struct poll_socket_entry *entry = LIST_ENTRY( cur, struct poll_socket_entry, entry );
+
+            if (!(entry->mask & flags)) continue;
 
             if (debug_level)
                 fprintf( stderr, "completing poll for socket %p, wanted %#x got %#x\n",
-                         sock, req->sockets[i].mask, flags );
+                         sock, entry->mask, flags );
 
-            req->sockets[i].flags = req->sockets[i].mask & flags;
-            req->sockets[i].status = sock_get_ntstatus( error );
-
-            if (req->pending)
-            {
-                complete_async_poll( req, STATUS_SUCCESS );
-                break;
-            }
+            entry->flags = entry->mask & flags;
+            entry->status = sock_get_ntstatus( error );
+            signaled = 1;
         }
+
+        if (signaled && req->pending) complete_async_poll( req, STATUS_SUCCESS );
     }
 }
 
@@ -1456,7 +1477,7 @@ static int sock_get_poll_events( struct fd *fd )
 {
     struct sock *sock = get_fd_user( fd );
     unsigned int mask = sock->mask & ~sock->reported_events;
-    struct poll_req *req;
+    struct poll_socket_entry *entry;
     int ev = 0;
 
     assert( sock->obj.ops == &sock_ops );
@@ -1464,17 +1485,8 @@ static int sock_get_poll_events( struct fd *fd )
     if (!sock->type) /* not initialized yet */
         return -1;
 
-    LIST_FOR_EACH_ENTRY( req, &poll_list, struct poll_req, entry )
-    {
-        unsigned int i;
-
-        for (i = 0; i < req->count; ++i)
-        {
-            if (req->sockets[i].sock != sock) continue;
-
-            ev |= poll_flags_from_afd( sock, req->sockets[i].mask );
-        }
-    }
+    LIST_FOR_EACH_ENTRY( entry, &sock->poll_list, struct poll_socket_entry, entry )
+        ev |= poll_flags_from_afd( sock, entry->mask );
 
     switch (sock->state)
     {
@@ -1623,7 +1635,7 @@ static int sock_close_handle( struct object *obj, struct process *process, obj_h
     if (sock->obj.handle_count == 1) /* last handle */
     {
         struct accept_req *accept_req, *accept_next;
-        struct poll_req *poll_req, *poll_next;
+        struct list *ptr;
 
         if (sock->accept_recv_req)
             async_terminate( sock->accept_recv_req->async, STATUS_CANCELLED );
@@ -1634,25 +1646,25 @@ static int sock_close_handle( struct object *obj, struct process *process, obj_h
         if (sock->connect_req)
             async_terminate( sock->connect_req->async, STATUS_CANCELLED );
 
-        LIST_FOR_EACH_ENTRY_SAFE( poll_req, poll_next, &poll_list, struct poll_req, entry )
+        ptr = list_head( &sock->poll_list );
+        while (ptr)
         {
-            struct iosb *iosb = poll_req->iosb;
-            BOOL signaled = FALSE;
-            unsigned int i;
+            struct list *cur = ptr;
+            struct poll_req *poll_req = LIST_ENTRY( cur, struct poll_socket_entry, entry )->req;
+
+            ptr = next_poll_req_entry( sock, poll_req, cur );
 
-            if (iosb->status != STATUS_PENDING) continue;
+            if (poll_req->iosb->status != STATUS_PENDING) continue;
 
-            for (i = 0; i < poll_req->count; ++i)
+            for (; cur != ptr; cur = list_next( &sock->poll_list, cur ))
             {
-                if (poll_req->sockets[i].sock == sock)
-                {
-                    signaled = TRUE;
-                    poll_req->sockets[i].flags = AFD_POLL_CLOSE;
-                    poll_req->sockets[i].status = 0;
-                }
+                struct poll_socket_entry *entry = LIST_ENTRY( cur, struct poll_socket_entry, entry );
+
+                entry->flags = AFD_POLL_CLOSE;
+                entry->status = 0;
             }
 
-            if (signaled) complete_async_poll( poll_req, STATUS_SUCCESS );
+            complete_async_poll( poll_req, STATUS_SUCCESS );
         }
     }
 
@@ -1741,6 +1753,7 @@ static struct sock *create_socket(void)
     init_async_queue( &sock->poll_q );
     memset( sock->errors, 0, sizeof(sock->errors) );
     list_init( &sock->accept_list );
+    list_init( &sock->poll_list );
     return sock;
 }
 
@@ -3395,6 +3408,12 @@ static void poll_socket( struct sock *poll_sock, struct async *async, int exclus
     req->async = (struct async *)grab_object( async );
     req->iosb = async_get_iosb( async );
 
+    for (i = 0; i < count; ++i)
+    {
+        req->sockets[i].req = req;
+        list_add_tail( &req->sockets[i].sock->poll_list, &req->sockets[i].entry );
+    }
+
     handle_exclusive_poll(req);
 
     list_add_tail( &poll_list, &req->entry );
@@ -3777,6 +3796,37 @@ DECL_HANDLER(recv_socket)
     sock->pending_events &= ~(req->oob ? AFD_POLL_OOB : AFD_POLL_READ);
     sock->reported_events &= ~(req->oob ? AFD_POLL_OOB : AFD_POLL_READ);
 
+    if (status == STATUS_ALERTED && !req->force_async && !req->async.apc && !req->async.apc_context)
+    {
+        /* Nothing but the event needs to be notified of a synchronous completion,
+         * so don't queue an async at all; the client performs the I/O and fills
+         * the IOSB itself, without reporting the result back through
+         * set_async_direct_result.  If no data turns out to be available, the
+         * client simply makes the request again.
+         */
+        struct event *event = NULL;
+
+        if (req->async.event && !(event = get_event_obj( current->process, req->async.event, EVENT_MODIFY_STATE )))
+        {
+            release_object( sock );
+            return;
+        }
+        if (event)
+        {
+            set_event( event );
+            release_object( event );
+        }
+        else set_fd_signaled( fd, 1 );
+
+        sock_reselect( sock );
+        set_error( STATUS_ALERTED );
+        reply->wait = 0;
+        reply->options = get_fd_options( fd );
+        reply->nonblocking = sock->nonblocking;
+        release_object( sock );
+        return;
+    }
+
     if ((async = create_request_async( fd, get_fd_comp_flags( fd ), &req->async )))
     {
         set_error( status );
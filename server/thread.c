@@ -263,6 +263,7 @@ static inline void init_thread_structure( struct thread *thread )
     thread->desc            = NULL;
     thread->desc_len        = 0;
     thread->exit_poll       = NULL;
+    thread->shm             = NULL;
 
     thread->creation_time = current_time;
     thread->exit_time     = 0;
@@ -276,6 +277,53 @@ static inline void init_thread_structure( struct thread *thread )
         thread->inflight[i].server = thread->inflight[i].client = -1;
 }
 
+/* allocate a snapshot slot in the process shared mapping, return its index or ~0u if none */
+static unsigned int alloc_thread_snapshot( struct thread *thread )
+{
+    struct process *process = thread->process;
+    unsigned int i;
+
+    if (thread->shm) return thread->shm - process->shm->threads;
+    if (!process->shm) return ~0u;
+
+    for (i = 0; i < MAX_SNAPSHOT_THREADS; i++)
+    {
+        if (process->shm->threads[i].tid) continue;
+        thread->shm = &process->shm->threads[i];
+        update_thread_snapshot( thread );
+        return i;
+    }
+    return ~0u;
+}
+
+/* release the snapshot slot of a thread */
+static void free_thread_snapshot( struct thread *thread )
+{
+    if (!thread->shm) return;
+    snapshot_write_begin( &thread->shm->seq );
+    thread->shm->tid = 0;
+    snapshot_write_end( &thread->shm->seq );
+    thread->shm = NULL;
+}
+
+/* publish the current thread state to the client */
+void update_thread_snapshot( struct thread *thread )
+{
+    volatile thread_snapshot_t *shm = thread->shm;
+
+    if (!shm) return;
+    snapshot_write_begin( &shm->seq );
+    shm->tid           = get_thread_id( thread );
+    shm->affinity      = thread->affinity;
+    shm->entry_point   = thread->entry_point;
+    shm->creation_time = thread->creation_time;
+    shm->priority      = thread->priority;
+    shm->suspend_count = thread->suspend;
+    shm->dbg_hidden    = thread->dbg_hidden;
+    shm->unix_tid      = thread->unix_tid;
+    snapshot_write_end( &shm->seq );
+}
+
 /* check if address looks valid for a client-side data structure (TEB etc.) */
 static inline int is_valid_address( client_ptr_t addr )
 {
@@ -459,6 +507,7 @@ static void cleanup_thread( struct thread *thread )
         }
     }
     free( thread->desc );
+    free_thread_snapshot( thread );
     thread->req_data = NULL;
     thread->reply_data = NULL;
     thread->request_fd = NULL;
@@ -484,6 +533,11 @@ static void destroy_thread( struct object *obj )
 
     if (do_esync())
         close( thread->esync_fd );
+    if (do_fsync())
+    {
+        fsync_free_shm( thread->fsync_idx );
+        fsync_free_shm( thread->fsync_apc_idx );
+    }
 }
 
 /* dump a thread on stdout for debugging purposes */
@@ -640,7 +694,11 @@ int set_thread_affinity( struct thread *thread, affinity_t affinity )
         ret = sched_setaffinity( thread->unix_tid, sizeof(set), &set );
     }
 #endif
-    if (!ret) thread->affinity = affinity;
+    if (!ret)
+    {
+        thread->affinity = affinity;
+        update_thread_snapshot( thread );
+    }
     return ret;
 }
 
@@ -725,6 +783,7 @@ static void set_thread_info( struct thread *thread,
             thread->desc_len = 0;
         }
     }
+    update_thread_snapshot( thread );
 }
 
 /* stop a thread (at the Unix level) */
@@ -743,6 +802,7 @@ int suspend_thread( struct thread *thread )
     if (thread->suspend < MAXIMUM_SUSPEND_COUNT)
     {
         if (!(thread->process->suspend + thread->suspend++)) stop_thread( thread );
+        update_thread_snapshot( thread );
     }
     else set_error( STATUS_SUSPEND_COUNT_EXCEEDED );
     return old_count;
@@ -756,6 +816,7 @@ int resume_thread( struct thread *thread )
     {
         if (!(--thread->suspend)) resume_delayed_debug_events( thread );
         if (!(thread->suspend + thread->process->suspend)) wake_thread( thread );
+        update_thread_snapshot( thread );
     }
     return old_count;
 }
@@ -1528,6 +1589,11 @@ DECL_HANDLER(init_first_thread)
 
     debug_level = max( debug_level, req->debug_level );
 
+    /* the snapshots are optional, the client falls back to server requests without them */
+    if (!init_process_snapshot( process ) ||
+        !(reply->shm_handle = alloc_handle( process, process->shm_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 )))
+        clear_error();
+    reply->shm_slot     = alloc_thread_snapshot( current );
     reply->pid          = get_process_id( process );
     reply->tid          = get_thread_id( current );
     reply->session_id   = process->session_id;
@@ -1560,6 +1626,7 @@ DECL_HANDLER(init_thread)
         set_thread_affinity( current, current->affinity );
 
     reply->suspend = (current->suspend || current->process->suspend || current->context != NULL);
+    reply->shm_slot = alloc_thread_snapshot( current );
 }
 
 /* terminate a thread */
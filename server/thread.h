@@ -95,6 +95,7 @@ struct thread
     data_size_t            desc_len;      /* thread description length in bytes */
     WCHAR                 *desc;          /* thread description string */
     struct timeout_user   *exit_poll;     /* poll if the thread/process has exited already */
+    volatile thread_snapshot_t *shm;  /* thread state snapshot in the process shared mapping */
 };
 
 extern struct thread *current;
@@ -125,6 +126,7 @@ extern int thread_add_inflight_fd( struct thread *thread, int client, int server
 extern int thread_get_inflight_fd( struct thread *thread, int client );
 extern struct token *thread_get_impersonation_token( struct thread *thread );
 extern int set_thread_affinity( struct thread *thread, affinity_t affinity );
+extern void update_thread_snapshot( struct thread *thread );
 extern int suspend_thread( struct thread *thread );
 extern int resume_thread( struct thread *thread );
 
@@ -1472,6 +1472,8 @@ static void dump_init_first_thread_reply( const struct init_first_thread_reply *
     dump_timeout( ", server_start=", &req->server_start );
     fprintf( stderr, ", session_id=%08x", req->session_id );
     fprintf( stderr, ", info_size=%u", req->info_size );
+    fprintf( stderr, ", shm_handle=%04x", req->shm_handle );
+    fprintf( stderr, ", shm_slot=%08x", req->shm_slot );
     dump_varargs_ushorts( ", machines=", cur_size );
 }
 
@@ -1487,6 +1489,7 @@ static void dump_init_thread_request( const struct init_thread_request *req )
 static void dump_init_thread_reply( const struct init_thread_reply *req )
 {
     fprintf( stderr, " suspend=%d", req->suspend );
+    fprintf( stderr, ", shm_slot=%08x", req->shm_slot );
 }
 
 static void dump_terminate_process_request( const struct terminate_process_request *req )
@@ -1570,6 +1573,17 @@ static void dump_get_process_vm_counters_reply( const struct get_process_vm_coun
     dump_uint64( ", peak_pagefile_usage=", &req->peak_pagefile_usage );
 }
 
+static void dump_get_process_handle_count_request( const struct get_process_handle_count_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_process_handle_count_reply( const struct get_process_handle_count_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    fprintf( stderr, ", max_count=%08x", req->max_count );
+}
+
 static void dump_set_process_info_request( const struct set_process_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -2194,6 +2208,23 @@ static void dump_unmap_view_request( const struct unmap_view_request *req )
     dump_uint64( " base=", &req->base );
 }
 
+static void dump_get_image_relocs_request( const struct get_image_relocs_request *req )
+{
+    dump_uint64( " base=", &req->base );
+}
+
+static void dump_get_image_relocs_reply( const struct get_image_relocs_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", fill=%d", req->fill );
+}
+
+static void dump_set_image_relocs_request( const struct set_image_relocs_request *req )
+{
+    dump_uint64( " base=", &req->base );
+    fprintf( stderr, ", success=%d", req->success );
+}
+
 static void dump_get_mapping_committed_range_request( const struct get_mapping_committed_range_request *req )
 {
     dump_uint64( " base=", &req->base );
@@ -2405,9 +2436,20 @@ static void dump_get_key_value_reply( const struct get_key_value_reply *req )
 {
     fprintf( stderr, " type=%d", req->type );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", cache_slot=%08x", req->cache_slot );
+    fprintf( stderr, ", cache_gen=%08x", req->cache_gen );
     dump_varargs_bytes( ", data=", cur_size );
 }
 
+static void dump_get_registry_cache_request( const struct get_registry_cache_request *req )
+{
+}
+
+static void dump_get_registry_cache_reply( const struct get_registry_cache_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_enum_key_value_request( const struct enum_key_value_request *req )
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
@@ -4646,6 +4688,18 @@ static void dump_get_fsync_apc_idx_reply( const struct get_fsync_apc_idx_reply *
     fprintf( stderr, " shm_idx=%08x", req->shm_idx );
 }
 
+static void dump_batch_requests_request( const struct batch_requests_request *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_bytes( ", requests=", cur_size );
+}
+
+static void dump_batch_requests_reply( const struct batch_requests_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_bytes( ", replies=", cur_size );
+}
+
 static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_new_process_request,
     (dump_func)dump_get_new_process_info_request,
@@ -4660,6 +4714,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_process_debug_info_request,
     (dump_func)dump_get_process_image_name_request,
     (dump_func)dump_get_process_vm_counters_request,
+    (dump_func)dump_get_process_handle_count_request,
     (dump_func)dump_set_process_info_request,
     (dump_func)dump_get_thread_info_request,
     (dump_func)dump_get_thread_times_request,
@@ -4713,6 +4768,8 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_info_request,
     (dump_func)dump_map_view_request,
     (dump_func)dump_unmap_view_request,
+    (dump_func)dump_get_image_relocs_request,
+    (dump_func)dump_set_image_relocs_request,
     (dump_func)dump_get_mapping_committed_range_request,
     (dump_func)dump_add_mapping_committed_range_request,
     (dump_func)dump_is_same_mapping_request,
@@ -4734,6 +4791,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_enum_key_request,
     (dump_func)dump_set_key_value_request,
     (dump_func)dump_get_key_value_request,
+    (dump_func)dump_get_registry_cache_request,
     (dump_func)dump_enum_key_value_request,
     (dump_func)dump_delete_key_value_request,
     (dump_func)dump_load_registry_request,
@@ -4936,6 +4994,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_fsync_idx_request,
     (dump_func)dump_fsync_msgwait_request,
     (dump_func)dump_get_fsync_apc_idx_request,
+    (dump_func)dump_batch_requests_request,
 };
 
 static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
@@ -4952,6 +5011,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_process_debug_info_reply,
     (dump_func)dump_get_process_image_name_reply,
     (dump_func)dump_get_process_vm_counters_reply,
+    (dump_func)dump_get_process_handle_count_reply,
     NULL,
     (dump_func)dump_get_thread_info_reply,
     (dump_func)dump_get_thread_times_reply,
@@ -5005,6 +5065,8 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_info_reply,
     NULL,
     NULL,
+    (dump_func)dump_get_image_relocs_reply,
+    NULL,
     (dump_func)dump_get_mapping_committed_range_reply,
     NULL,
     NULL,
@@ -5026,6 +5088,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_enum_key_reply,
     NULL,
     (dump_func)dump_get_key_value_reply,
+    (dump_func)dump_get_registry_cache_reply,
     (dump_func)dump_enum_key_value_reply,
     NULL,
     NULL,
@@ -5228,6 +5291,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_fsync_idx_reply,
     NULL,
     (dump_func)dump_get_fsync_apc_idx_reply,
+    (dump_func)dump_batch_requests_reply,
 };
 
 static const char * const req_names[REQ_NB_REQUESTS] = {
@@ -5244,6 +5308,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_process_debug_info",
     "get_process_image_name",
     "get_process_vm_counters",
+    "get_process_handle_count",
     "set_process_info",
     "get_thread_info",
     "get_thread_times",
@@ -5297,6 +5362,8 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_mapping_info",
     "map_view",
     "unmap_view",
+    "get_image_relocs",
+    "set_image_relocs",
     "get_mapping_committed_range",
     "add_mapping_committed_range",
     "is_same_mapping",
@@ -5318,6 +5385,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "enum_key",
     "set_key_value",
     "get_key_value",
+    "get_registry_cache",
     "enum_key_value",
     "delete_key_value",
     "load_registry",
@@ -5520,6 +5588,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_fsync_idx",
     "fsync_msgwait",
     "get_fsync_apc_idx",
+    "batch_requests",
 };
 
 static const struct
@@ -5642,6 +5711,7 @@ static const struct
     { "PROCESS_IN_JOB",              STATUS_PROCESS_IN_JOB },
     { "PROCESS_IS_TERMINATING",      STATUS_PROCESS_IS_TERMINATING },
     { "PROCESS_NOT_IN_JOB",          STATUS_PROCESS_NOT_IN_JOB },
+    { "REGISTRY_CORRUPT",            STATUS_REGISTRY_CORRUPT },
     { "REPARSE_POINT_NOT_RESOLVED",  STATUS_REPARSE_POINT_NOT_RESOLVED },
     { "SECTION_TOO_BIG",             STATUS_SECTION_TOO_BIG },
     { "SEMAPHORE_LIMIT_EXCEEDED",    STATUS_SEMAPHORE_LIMIT_EXCEEDED },
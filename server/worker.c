@@ -0,0 +1,269 @@
+/*
+ * Server worker threads
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The server state (objects, handles, queues) is only ever touched by the
+ * main thread. A worker owns a single lock domain that is independent of
+ * that state, and runs jobs that only access data explicitly handed over
+ * to them. Once a job is done, its completion callback is invoked from the
+ * main loop, where it is again safe to access server objects.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "object.h"
+
+struct worker_job
+{
+    struct list      entry;       /* entry in worker queue or finished list */
+    worker_callback  work;        /* function to run in the worker thread */
+    worker_done      done;        /* completion function run in the main thread */
+    void            *arg;         /* argument for both functions */
+    int              status;      /* return value of the work function */
+};
+
+struct worker
+{
+    struct object    obj;         /* object header */
+    struct fd       *fd;          /* file descriptor for the notification pipe */
+    int              pipe_write;  /* unix fd for the pipe write side */
+    const char      *name;        /* name of the worker, for debugging */
+    pthread_t        thread;      /* worker thread */
+    pthread_mutex_t  mutex;       /* lock protecting the fields below */
+    pthread_cond_t   cond;        /* signaled when a job is queued */
+    pthread_cond_t   idle_cond;   /* signaled when the queue becomes empty */
+    struct list      queue;       /* jobs waiting to be run */
+    struct list      finished;    /* jobs waiting for their completion callback */
+    unsigned int     running;     /* number of queued jobs not finished yet */
+    int              notified;    /* has the main loop been notified already? */
+};
+
+static void worker_dump( struct object *obj, int verbose );
+static void worker_destroy( struct object *obj );
+
+static const struct object_ops worker_ops =
+{
+    sizeof(struct worker),    /* size */
+    &no_type,                 /* type */
+    worker_dump,              /* dump */
+    no_add_queue,             /* add_queue */
+    NULL,                     /* remove_queue */
+    NULL,                     /* signaled */
+    NULL,                     /* get_esync_fd */
+    NULL,                     /* get_fsync_idx */
+    NULL,                     /* satisfied */
+    no_signal,                /* signal */
+    no_get_fd,                /* get_fd */
+    default_map_access,       /* map_access */
+    default_get_sd,           /* get_sd */
+    default_set_sd,           /* set_sd */
+    no_get_full_name,         /* get_full_name */
+    no_lookup_name,           /* lookup_name */
+    no_link_name,             /* link_name */
+    NULL,                     /* unlink_name */
+    no_open_file,             /* open_file */
+    no_kernel_obj_list,       /* get_kernel_obj_list */
+    no_close_handle,          /* close_handle */
+    worker_destroy            /* destroy */
+};
+
+static void worker_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops worker_fd_ops =
+{
+    NULL,                     /* get_poll_events */
+    worker_poll_event,        /* poll_event */
+    NULL,                     /* flush */
+    NULL,                     /* get_fd_type */
+    NULL,                     /* ioctl */
+    NULL,                     /* queue_async */
+    NULL                      /* reselect_async */
+};
+
+/* main function of the worker threads */
+static void *worker_thread( void *arg )
+{
+    struct worker *worker = arg;
+    struct worker_job *job;
+    struct list *ptr;
+    char dummy = 0;
+
+    pthread_mutex_lock( &worker->mutex );
+    for (;;)
+    {
+        while (!(ptr = list_head( &worker->queue ))) pthread_cond_wait( &worker->cond, &worker->mutex );
+        job = LIST_ENTRY( ptr, struct worker_job, entry );
+        list_remove( &job->entry );
+        pthread_mutex_unlock( &worker->mutex );
+
+        job->status = job->work( job->arg );
+
+        pthread_mutex_lock( &worker->mutex );
+        list_add_tail( &worker->finished, &job->entry );
+        if (!--worker->running) pthread_cond_broadcast( &worker->idle_cond );
+        if (!worker->notified)
+        {
+            int ret;
+
+            while ((ret = write( worker->pipe_write, &dummy, 1 )) == -1 && errno == EINTR);
+            if (ret == -1) fprintf( stderr, "wineserver: cannot notify %s worker completion: %s\n",
+                                    worker->name, strerror( errno ));
+            else worker->notified = 1;
+        }
+    }
+    return NULL;
+}
+
+/* run the completion callbacks of the finished jobs */
+static void run_finished_jobs( struct worker *worker )
+{
+    struct list finished = LIST_INIT( finished );
+    struct worker_job *job, *next;
+
+    pthread_mutex_lock( &worker->mutex );
+    list_move_tail( &finished, &worker->finished );
+    worker->notified = 0;
+    pthread_mutex_unlock( &worker->mutex );
+
+    LIST_FOR_EACH_ENTRY_SAFE( job, next, &finished, struct worker_job, entry )
+    {
+        list_remove( &job->entry );
+        if (job->done) job->done( job->arg, job->status );
+        free( job );
+    }
+}
+
+/* create a worker thread */
+struct worker *create_worker( const char *name )
+{
+    struct worker *worker;
+    sigset_t sigset, old_sigset;
+    int fd[2], ret;
+
+    if (pipe( fd ) == -1) return NULL;
+    if (!(worker = alloc_object( &worker_ops )))
+    {
+        close( fd[0] );
+        close( fd[1] );
+        return NULL;
+    }
+    worker->pipe_write = fd[1];
+    worker->name       = name;
+    worker->running    = 0;
+    worker->notified   = 0;
+    list_init( &worker->queue );
+    list_init( &worker->finished );
+    pthread_mutex_init( &worker->mutex, NULL );
+    pthread_cond_init( &worker->cond, NULL );
+    pthread_cond_init( &worker->idle_cond, NULL );
+
+    if (!(worker->fd = create_anonymous_fd( &worker_fd_ops, fd[0], &worker->obj, 0 )))
+    {
+        release_object( worker );
+        return NULL;
+    }
+
+    /* signals must only be delivered to the main thread */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+    ret = pthread_create( &worker->thread, NULL, worker_thread, worker );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+    if (ret)
+    {
+        fprintf( stderr, "wineserver: failed to create %s worker: %s\n", name, strerror( ret ));
+        release_object( worker );
+        return NULL;
+    }
+    pthread_detach( worker->thread );
+
+    set_fd_events( worker->fd, POLLIN );
+    make_object_permanent( &worker->obj );
+    return worker;
+}
+
+/* queue a job to a worker; the done callback is invoked from the main loop once it completes */
+int queue_worker_job( struct worker *worker, worker_callback work, worker_done done, void *arg )
+{
+    struct worker_job *job;
+
+    if (!(job = mem_alloc( sizeof(*job) ))) return 0;
+    job->work   = work;
+    job->done   = done;
+    job->arg    = arg;
+    job->status = 0;
+
+    pthread_mutex_lock( &worker->mutex );
+    list_add_tail( &worker->queue, &job->entry );
+    worker->running++;
+    pthread_cond_signal( &worker->cond );
+    pthread_mutex_unlock( &worker->mutex );
+    return 1;
+}
+
+/* wait for all the queued jobs of a worker to complete and run their completion callbacks */
+void flush_worker( struct worker *worker )
+{
+    pthread_mutex_lock( &worker->mutex );
+    while (worker->running) pthread_cond_wait( &worker->idle_cond, &worker->mutex );
+    pthread_mutex_unlock( &worker->mutex );
+    run_finished_jobs( worker );
+}
+
+static void worker_dump( struct object *obj, int verbose )
+{
+    struct worker *worker = (struct worker *)obj;
+    fprintf( stderr, "Worker %s fd=%p running=%u\n", worker->name, worker->fd, worker->running );
+}
+
+static void worker_destroy( struct object *obj )
+{
+    struct worker *worker = (struct worker *)obj;
+    if (worker->fd) release_object( worker->fd );
+    close( worker->pipe_write );
+}
+
+static void worker_poll_event( struct fd *fd, int event )
+{
+    struct worker *worker = get_fd_user( fd );
+
+    if (event & (POLLERR | POLLHUP))
+    {
+        /* this is not supposed to happen */
+        fprintf( stderr, "wineserver: Error on %s worker pipe\n", worker->name );
+        set_fd_events( worker->fd, -1 );
+    }
+    else if (event & POLLIN)
+    {
+        char dummy[16];
+
+        read( get_unix_fd( worker->fd ), dummy, sizeof(dummy) );
+        run_finished_jobs( worker );
+    }
+}